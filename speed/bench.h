@@ -0,0 +1,46 @@
+/*
+*   bench.h
+*   Tiny helpers shared by the speed tests: a wall-clock timer and a
+*   deterministic random number generator, so runs are comparable.
+ */
+
+#ifndef VF_BENCH_H
+#define VF_BENCH_H
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <time.h>
+#endif
+
+// Returns a monotonic timestamp in seconds.
+static inline double bench_now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+// xorshift64* generator; the same seed gives the same keys on every platform.
+static inline uint64_t bench_rand(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 2685821657736338717ULL;
+}
+
+// Keeps the optimizer from discarding a benchmarked result.
+static volatile uint64_t bench_sink;
+
+#endif // VF_BENCH_H
@@ -0,0 +1,5 @@
+@ECHO "Building file..."
+clang speed_darray.c -Wall -Wextra -Werror -pedantic -O3 -o speed_darray.exe
+
+@ECHO "Running file..."
+speed_darray.exe
@@ -0,0 +1,9 @@
+@ECHO "Building files..."
+clang speed_hashmap.c -Wall -Wextra -Werror -pedantic -O3 -o speed_hashmap_linear.exe
+clang speed_hashmap.c -Wall -Wextra -Werror -pedantic -O3 -DVF_HASHMAP_SWISS_TABLE -o speed_hashmap_swiss.exe
+clang speed_hashmap.c -Wall -Wextra -Werror -pedantic -O3 -DVF_HASHMAP_ROBIN_HOOD -o speed_hashmap_robin.exe
+
+@ECHO "Running files..."
+speed_hashmap_linear.exe
+speed_hashmap_swiss.exe
+speed_hashmap_robin.exe
@@ -0,0 +1,5 @@
+@ECHO "Building file..."
+clang speed_memory.c -Wall -Wextra -Werror -pedantic -O3 -o speed_memory.exe
+
+@ECHO "Running file..."
+speed_memory.exe
@@ -0,0 +1,474 @@
+/*
+*   speed_darray.c
+*   Speed tests for vf_darray: the generic `void*` functions against the typed
+*   ones generated by VF_DA_DEFINE, and an array of structs against the
+*   columns of a vf_soa_t.
+*
+*       clang speed_darray.c -O3 -o speed_darray.exe
+*
+*   See run_darray.bat. Pass a test name (push, iterate, grow, batch, parallel,
+*   soa, small)
+*   to run only that one. Outside of Windows, link with -lpthread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VF_THREAD_IMPLEMENTATION
+#define VF_THREADPOOL_IMPLEMENTATION
+#define VF_DARRAY_ENABLE_PARALLEL
+#define VF_DARRAY_IMPLEMENTATION
+#include "../vf_darray.h"
+#define VF_SOA_IMPLEMENTATION
+#include "../vf_soa.h"
+
+#include "bench.h"
+
+typedef struct {
+    float x, y, z;
+    uint32_t id;
+} particle_t;
+
+VF_DA_DEFINE(da_u32, uint32_t)
+VF_DA_DEFINE(da_particle, particle_t)
+
+#define PUSH_COUNT 20000000
+
+static void print_result(const char* test, const char* type, const char* path, size_t count, double elapsed) {
+    printf("%-8s %-9s %-17s %9zu elements: %6.2f ns/element\n", test, type, path, count, elapsed * 1e9 / (double)count);
+}
+
+static double push_generic(uint32_t** da, size_t count) {
+    double start = bench_now();
+    for (uint32_t i = 0; i < count; ++i) {
+        *da = (uint32_t*)vf_da_push_back(*da, &i);
+    }
+    return bench_now() - start;
+}
+
+static double push_typed(uint32_t** da, size_t count) {
+    double start = bench_now();
+    for (uint32_t i = 0; i < count; ++i) {
+        *da = da_u32_push_back(*da, i);
+    }
+    return bench_now() - start;
+}
+
+static void bench_push(size_t count) {
+    // Growing from the default capacity
+    uint32_t* generic = (uint32_t*)vf_da_alloc(sizeof(uint32_t));
+    print_result("push", "uint32_t", "generic", count, push_generic(&generic, count));
+    uint32_t* typed = da_u32_alloc(DA_DEFAULT_CAPACITY);
+    print_result("push", "uint32_t", "typed", count, push_typed(&typed, count));
+
+    // Cleared and filled again, so only the store itself is measured
+    vf_da_clear(generic);
+    print_result("push", "uint32_t", "generic, reserved", count, push_generic(&generic, count));
+    vf_da_clear(typed);
+    print_result("push", "uint32_t", "typed, reserved", count, push_typed(&typed, count));
+    bench_sink = generic[count / 2] + typed[count / 3];
+    vf_da_free(generic);
+    vf_da_free(typed);
+
+    size_t particle_count = count / 4;
+    particle_t* particles = (particle_t*)vf_da_alloc_exact(particle_count, sizeof(particle_t));
+    memset(particles, 0, particle_count * sizeof(particle_t));
+    double start = bench_now();
+    for (uint32_t i = 0; i < particle_count; ++i) {
+        particle_t particle = {(float)i, 1.0f, 2.0f, i};
+        particles = (particle_t*)vf_da_push_back(particles, &particle);
+    }
+    print_result("push", "particle", "generic, reserved", particle_count, bench_now() - start);
+
+    vf_da_clear(particles);
+    start = bench_now();
+    for (uint32_t i = 0; i < particle_count; ++i) {
+        particle_t particle = {(float)i, 1.0f, 2.0f, i};
+        particles = da_particle_push_back(particles, particle);
+    }
+    print_result("push", "particle", "typed, reserved", particle_count, bench_now() - start);
+    bench_sink = particles[particle_count / 2].id;
+    vf_da_free(particles);
+}
+
+// Sums through the stride stored in the header, the way code that only has
+// a `void*` darray has to, against the typed element access.
+static uint64_t sum_generic(const void* da) {
+    size_t count = vf_da_count(da);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value;
+        memcpy(&value, (const uint8_t*)da + i * vf_da_stride(da), sizeof(value));
+        sum += value;
+    }
+    return sum;
+}
+
+static uint64_t sum_typed(uint32_t* da) {
+    size_t count = vf_da_count(da);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += *da_u32_at(da, i);
+    }
+    return sum;
+}
+
+static void bench_iterate(size_t count) {
+    uint32_t* da = da_u32_alloc(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        da = da_u32_push_back(da, i);
+    }
+
+    int rounds = 10;
+    double start = bench_now();
+    uint64_t sum = 0;
+    for (int round = 0; round < rounds; ++round) {
+        sum += sum_generic(da);
+    }
+    print_result("iterate", "uint32_t", "generic", count * rounds, bench_now() - start);
+
+    start = bench_now();
+    for (int round = 0; round < rounds; ++round) {
+        sum += sum_typed(da);
+    }
+    print_result("iterate", "uint32_t", "typed", count * rounds, bench_now() - start);
+
+    // Pops everything back off
+    start = bench_now();
+    while (!vf_da_is_empty(da)) {
+        sum += da_u32_pop_back(da);
+    }
+    print_result("pop", "uint32_t", "typed", count, bench_now() - start);
+    bench_sink = sum;
+
+    vf_da_free(da);
+}
+
+// What growing used to do: a new block, a copy of everything, then a free.
+static uint32_t* grow_by_copy(uint32_t* da) {
+    size_t count = vf_da_count(da);
+    uint32_t* grown = da_u32_alloc(vf_da_capacity(da) * 2);
+    memcpy(grown, da, count * sizeof(uint32_t));
+    ((size_t*)grown - DA_HEADER_LENGTH)[DA_COUNT] = count;
+    vf_da_free(da);
+    return grown;
+}
+
+enum { GROW_COPY, GROW_REALLOC, GROW_HUGE };
+
+// Pushes `count` elements and times the pushes that had to grow the array,
+// since those are the pauses a caller sees.
+static void bench_grow(size_t count, int mode) {
+    static const char* names[] = {"malloc + memcpy", "realloc", "huge"};
+    bool copy = (mode == GROW_COPY);
+    uint32_t* da = (mode == GROW_HUGE) ? (uint32_t*)vf_da_alloc_huge((size_t)1 << 32, sizeof(uint32_t))
+                                       : da_u32_alloc(DA_DEFAULT_CAPACITY);
+    double growing = 0.0;
+    double longest = 0.0;
+
+    double start = bench_now();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (vf_da_count(da) == vf_da_capacity(da)) {
+            double grow_start = bench_now();
+            da = copy ? da_u32_push_back(grow_by_copy(da), i) : da_u32_push_back(da, i);
+            double pause = bench_now() - grow_start;
+            growing += pause;
+            if (pause > longest) longest = pause;
+        } else {
+            da = da_u32_push_back(da, i);
+        }
+    }
+    double elapsed = bench_now() - start;
+
+    printf("grow     uint32_t  %-17s %9zu elements: %7.1f ms total, %7.1f ms growing, longest pause %6.1f ms\n",
+           names[mode], count, elapsed * 1e3, growing * 1e3, longest * 1e3);
+    bench_sink = da[count / 2];
+    vf_da_free(da);
+}
+
+#define BATCH_SIZE 4096
+
+// Ingests records in batches, one element at a time against one call per batch.
+static void bench_batch(size_t count) {
+    particle_t* batch = (particle_t*)malloc(BATCH_SIZE * sizeof(particle_t));
+    for (uint32_t i = 0; i < BATCH_SIZE; ++i) {
+        particle_t particle = {(float)i, 1.0f, 2.0f, i};
+        batch[i] = particle;
+    }
+
+    particle_t* da = (particle_t*)vf_da_alloc(sizeof(particle_t));
+    double start = bench_now();
+    for (size_t done = 0; done < count; done += BATCH_SIZE) {
+        for (size_t i = 0; i < BATCH_SIZE; ++i) {
+            da = (particle_t*)vf_da_push_back(da, &batch[i]);
+        }
+    }
+    print_result("batch", "particle", "push_back", count, bench_now() - start);
+    vf_da_free(da);
+
+    da = (particle_t*)vf_da_alloc(sizeof(particle_t));
+    start = bench_now();
+    for (size_t done = 0; done < count; done += BATCH_SIZE) {
+        da = (particle_t*)vf_da_push_n(da, batch, BATCH_SIZE);
+    }
+    print_result("batch", "particle", "push_n", count, bench_now() - start);
+
+    bench_sink = da[count / 2].id;
+    vf_da_free(da);
+
+    // Inserting and erasing batches at the front, where each element on its
+    // own moves the whole array
+    size_t rounds = 1000;
+    da = (particle_t*)vf_da_alloc_exact(100000 + BATCH_SIZE, sizeof(particle_t));
+    for (size_t done = 0; done < 100000; done += BATCH_SIZE) {
+        da = (particle_t*)vf_da_push_n(da, batch, BATCH_SIZE);
+    }
+    start = bench_now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < 64; ++i) {
+            da = (particle_t*)vf_da_insert(da, &batch[i], 0);
+        }
+        for (size_t i = 0; i < 64; ++i) {
+            vf_da_remove(da, 0);
+        }
+    }
+    print_result("batch", "particle", "insert, remove", rounds * 64, bench_now() - start);
+
+    start = bench_now();
+    for (size_t round = 0; round < rounds; ++round) {
+        da = (particle_t*)vf_da_insert_n(da, batch, 64, 0);
+        vf_da_erase_range(da, 0, 64);
+    }
+    print_result("batch", "particle", "insert_n, erase", rounds * 64, bench_now() - start);
+
+    bench_sink = da[rounds].id;
+    vf_da_free(da);
+    free(batch);
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static bool keep_small(const void* element, void* user) {
+    (void)user;
+    return *(const uint32_t*)element < 0x40000000u;
+}
+
+static void scale_u32(void* elements, size_t count, size_t first, void* user) {
+    (void)first;
+    (void)user;
+    uint32_t* values = (uint32_t*)elements;
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = values[i] * 3 + 1;
+    }
+}
+
+static void to_float(const void* in, void* out, size_t count, size_t first, void* user) {
+    (void)first;
+    (void)user;
+    const uint32_t* values = (const uint32_t*)in;
+    float* floats = (float*)out;
+    for (size_t i = 0; i < count; ++i) {
+        floats[i] = (float)values[i] * (1.0f / 4294967296.0f);
+    }
+}
+
+static uint32_t* random_u32(size_t count) {
+    uint32_t* da = da_u32_alloc(count);
+    uint64_t state = 7;
+    for (size_t i = 0; i < count; ++i) {
+        da = da_u32_push_back(da, (uint32_t)bench_rand(&state));
+    }
+    return da;
+}
+
+// Each algorithm from 1 to 16 workers, against the plain single-threaded loop.
+static void bench_parallel(size_t count) {
+    const int thread_counts[] = {1, 2, 4, 8, 16};
+    uint32_t* source = random_u32(count);
+    uint32_t* da = da_u32_alloc(count);
+
+    memcpy(da, source, count * sizeof(uint32_t));
+    ((size_t*)da - DA_HEADER_LENGTH)[DA_COUNT] = count;
+    double start = bench_now();
+    qsort(da, count, sizeof(uint32_t), compare_u32);
+    printf("parallel uint32_t  %9zu elements: qsort %7.1f ms\n", count, (bench_now() - start) * 1e3);
+
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); ++t) {
+        vf_threadpool_t* pool = vf_threadpool_create(thread_counts[t]);
+
+        memcpy(da, source, count * sizeof(uint32_t));
+        start = bench_now();
+        vf_da_parallel_sort(da, compare_u32, pool);
+        double sort = bench_now() - start;
+
+        start = bench_now();
+        uint32_t* small = (uint32_t*)vf_da_parallel_filter(da, keep_small, NULL, pool);
+        double filter = bench_now() - start;
+
+        start = bench_now();
+        vf_da_parallel_for_each(da, scale_u32, NULL, pool);
+        double for_each = bench_now() - start;
+
+        start = bench_now();
+        float* floats = (float*)vf_da_parallel_map(da, sizeof(float), to_float, NULL, pool);
+        double map = bench_now() - start;
+
+        printf("parallel uint32_t  %9zu elements, %2d threads: sort %7.1f ms, filter %6.1f ms, for_each %6.1f ms, map %6.1f ms\n",
+               count, thread_counts[t], sort * 1e3, filter * 1e3, for_each * 1e3, map * 1e3);
+        bench_sink = small[0] + (uint64_t)floats[count / 2];
+        vf_da_free(small);
+        vf_da_free(floats);
+        vf_threadpool_destroy(pool);
+    }
+
+    vf_da_free(source);
+    vf_da_free(da);
+}
+
+// A 64 byte record, of which the update loop only touches two fields.
+typedef struct {
+    float x, y, z;
+    float vx, vy, vz;
+    uint32_t id;
+    uint32_t flags;
+    float extra[8];
+} entity_t;
+
+// x += vx over every record, read as structs from a vf_darray and as two
+// columns of a vf_soa_t.
+static void bench_soa(size_t count) {
+    const int passes = 10;
+    entity_t* aos = (entity_t*)vf_da_alloc_exact(count, sizeof(entity_t));
+    vf_da_resize(aos, count);
+    const vf_soa_field_t fields[] = {
+        VF_SOA_FIELD(entity_t, x), VF_SOA_FIELD(entity_t, y), VF_SOA_FIELD(entity_t, z),
+        VF_SOA_FIELD(entity_t, vx), VF_SOA_FIELD(entity_t, vy), VF_SOA_FIELD(entity_t, vz),
+        VF_SOA_FIELD(entity_t, id), VF_SOA_FIELD(entity_t, flags), VF_SOA_FIELD(entity_t, extra),
+    };
+    vf_soa_t* soa = vf_soa_create(fields, sizeof(fields) / sizeof(fields[0]), count);
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; ++i) {
+        entity_t entity;
+        memset(&entity, 0, sizeof(entity));
+        entity.vx = (float)(i & 7);
+        entity.id = (uint32_t)i;
+        aos[i] = entity;
+    }
+    print_result("soa", "entity_t", "fill aos", count, bench_now() - start);
+    start = bench_now();
+    for (size_t i = 0; i < count; ++i) {
+        vf_soa_push_struct(soa, &aos[i]);
+    }
+    print_result("soa", "entity_t", "fill soa", count, bench_now() - start);
+
+    start = bench_now();
+    for (int pass = 0; pass < passes; ++pass) {
+        for (size_t i = 0; i < count; ++i) {
+            aos[i].x += aos[i].vx;
+        }
+    }
+    print_result("soa", "entity_t", "update aos", count * passes, bench_now() - start);
+
+    float* x = (float*)vf_soa_column(soa, 0);
+    const float* vx = (const float*)vf_soa_column(soa, 3);
+    start = bench_now();
+    for (int pass = 0; pass < passes; ++pass) {
+        for (size_t i = 0; i < count; ++i) {
+            x[i] += vx[i];
+        }
+    }
+    print_result("soa", "entity_t", "update soa", count * passes, bench_now() - start);
+
+    bench_sink = (uint64_t)(aos[count - 1].x + x[count - 1]);
+    vf_soa_free(soa);
+    vf_da_free(aos);
+}
+
+// Short-lived arrays of 0 to 11 elements, most of them under 8: heap arrays
+// against VF_DA_SMALL with room for 8. Counts the mallocs and reallocs each
+// one took, seen as changes of the capacity.
+static void bench_small(size_t arrays) {
+    uint64_t state = 7;
+    uint8_t* sizes = (uint8_t*)malloc(arrays);
+    for (size_t i = 0; i < arrays; ++i) {
+        uint64_t r = bench_rand(&state);
+        sizes[i] = (uint8_t)((r % 10 == 0) ? 8 + (r >> 8) % 4 : (r >> 8) % 8);
+    }
+
+    size_t allocations = 0;
+    uint64_t sum = 0;
+    double start = bench_now();
+    for (size_t i = 0; i < arrays; ++i) {
+        uint32_t* da = da_u32_alloc(DA_DEFAULT_CAPACITY);
+        allocations++;
+        for (uint32_t j = 0; j < sizes[i]; ++j) {
+            size_t capacity = vf_da_capacity(da);
+            da = da_u32_push_back(da, j);
+            allocations += vf_da_capacity(da) != capacity;
+        }
+        sum += vf_da_count(da);
+        vf_da_free(da);
+    }
+    double elapsed = bench_now() - start;
+    printf("small    uint32_t  heap     %9zu arrays: %6.2f ns/array, %.3f allocations/array\n",
+           arrays, elapsed * 1e9 / (double)arrays, (double)allocations / (double)arrays);
+
+    allocations = 0;
+    start = bench_now();
+    for (size_t i = 0; i < arrays; ++i) {
+        VF_DA_SMALL(uint32_t, 8) storage;
+        uint32_t* da = (uint32_t*)VF_DA_SMALL_INIT(storage);
+        for (uint32_t j = 0; j < sizes[i]; ++j) {
+            size_t capacity = vf_da_capacity(da);
+            da = da_u32_push_back(da, j);
+            allocations += vf_da_capacity(da) != capacity;
+        }
+        sum += vf_da_count(da);
+        vf_da_free(da);
+    }
+    elapsed = bench_now() - start;
+    printf("small    uint32_t  inline 8 %9zu arrays: %6.2f ns/array, %.3f allocations/array\n",
+           arrays, elapsed * 1e9 / (double)arrays, (double)allocations / (double)arrays);
+
+    bench_sink = sum;
+    free(sizes);
+}
+
+int main(int argc, char** argv) {
+    const char* only = (argc > 1) ? argv[1] : NULL;
+
+    if (!only || strcmp(only, "push") == 0) {
+        bench_push(PUSH_COUNT);
+    }
+    if (!only || strcmp(only, "iterate") == 0) {
+        bench_iterate(PUSH_COUNT);
+    }
+    if (!only || strcmp(only, "batch") == 0) {
+        bench_batch(PUSH_COUNT / 4);
+    }
+    if (!only || strcmp(only, "parallel") == 0) {
+        bench_parallel(PUSH_COUNT);
+    }
+    if (!only || strcmp(only, "soa") == 0) {
+        bench_soa(PUSH_COUNT / 4);
+    }
+    if (!only || strcmp(only, "small") == 0) {
+        bench_small(PUSH_COUNT / 4);
+    }
+    if (!only || strcmp(only, "grow") == 0) {
+        for (int mode = GROW_COPY; mode <= GROW_HUGE; ++mode) {
+            bench_grow(PUSH_COUNT, mode);
+        }
+        for (int mode = GROW_COPY; mode <= GROW_HUGE; ++mode) {
+            bench_grow(PUSH_COUNT * 10, mode);
+        }
+    }
+
+    return 0;
+}
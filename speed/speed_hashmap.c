@@ -0,0 +1,735 @@
+/*
+*   speed_hashmap.c
+*   Speed tests for vf_hashmap. Build once per layout and compare:
+*
+*       clang speed_hashmap.c -O3 -o speed_hashmap_linear.exe
+*       clang speed_hashmap.c -O3 -DVF_HASHMAP_SWISS_TABLE -o speed_hashmap_swiss.exe
+*       clang speed_hashmap.c -O3 -DVF_HASHMAP_ROBIN_HOOD -o speed_hashmap_robin.exe
+*
+*   See run_hashmap.bat. Pass a test name (lookup, churn, hash, ids, concurrent,
+*   latency, build, batch,
+*   mmap, frozen, probes) to run only that one. Outside of Windows, link with -lpthread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VF_THREAD_IMPLEMENTATION
+#define VF_THREADPOOL_IMPLEMENTATION
+#define VF_HASHMAP_ENABLE_CONCURRENT
+#define VF_HASHMAP_IMPLEMENTATION
+#include "../vf_hashmap.h"
+
+#include "bench.h"
+
+#if defined(VF_HASHMAP_SWISS_TABLE)
+#    define LAYOUT_NAME "swiss"
+#elif defined(VF_HASHMAP_ROBIN_HOOD)
+#    define LAYOUT_NAME "robin"
+#else
+#    define LAYOUT_NAME "linear"
+#endif
+
+#define KEY_LENGTH   64
+#define LOOKUP_COUNT 4000000
+
+// Path-like keys of a fixed length, so hashing cost is comparable between runs.
+static char (*make_keys(size_t count, uint64_t seed))[KEY_LENGTH] {
+    char (*keys)[KEY_LENGTH] = malloc(count * KEY_LENGTH);
+    uint64_t state = seed;
+    for (size_t i = 0; i < count; ++i) {
+        snprintf(keys[i], KEY_LENGTH, "/data/assets/%016llx/%08zu.bin",
+                 (unsigned long long)bench_rand(&state), i);
+    }
+    return keys;
+}
+
+static void bench_lookup(size_t count) {
+    char (*keys)[KEY_LENGTH] = make_keys(count, 0x9E3779B97F4A7C15ULL);
+    char (*missing)[KEY_LENGTH] = make_keys(count, 0xD1B54A32D192ED03ULL);
+    uint32_t* order = malloc(LOOKUP_COUNT * sizeof(uint32_t));
+    uint64_t state = 42;
+    for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+        order[i] = (uint32_t)(bench_rand(&state) % count);
+    }
+
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(uint64_t));
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t value = i;
+        vf_hashmap_set(map, keys[i], &value);
+    }
+    double insert_time = bench_now() - start;
+
+    uint64_t sum = 0;
+    start = bench_now();
+    for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+        sum += *(const uint64_t*)vf_hashmap_get(map, keys[order[i]]);
+    }
+    double hit_time = bench_now() - start;
+
+    start = bench_now();
+    for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+        sum += (uint64_t)vf_hashmap_has(map, missing[order[i]]);
+    }
+    double miss_time = bench_now() - start;
+    bench_sink = sum;
+
+    printf("[%s] %9zu keys: insert %7.1f ns/op, hit %7.1f ns/op, miss %7.1f ns/op\n",
+           LAYOUT_NAME, count,
+           insert_time * 1e9 / (double)count,
+           hit_time * 1e9 / LOOKUP_COUNT,
+           miss_time * 1e9 / LOOKUP_COUNT);
+
+    vf_hashmap_free(map);
+    free(order);
+    free(missing);
+    free(keys);
+}
+
+static void print_probe_lengths(const vf_hashmap_t* map, size_t ops, double elapsed) {
+    vf_hashmap_stats_t stats = vf_hashmap_stats(map);
+    printf("[%s] churn %8zu ops: %6.1f ns/op, avg probe %5.2f, max probe %4zu, capacity %zu\n",
+           LAYOUT_NAME, ops, elapsed * 1e9 / (double)ops,
+           stats.mean_displacement + 1.0, stats.max_displacement + 1, map->capacity);
+}
+
+// Keeps `live` keys in the map while replacing the oldest key on every step,
+// and reports how long probe chains get as the churn goes on.
+static void bench_churn(size_t live, size_t ops) {
+    char key[KEY_LENGTH];
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(uint64_t));
+
+    for (uint64_t i = 0; i < live; ++i) {
+        snprintf(key, KEY_LENGTH, "/churn/%016llx", (unsigned long long)i);
+        vf_hashmap_set(map, key, &i);
+    }
+
+    // Timings include formatting the two keys, which costs the same in both layouts
+    size_t report_every = ops / 4;
+    double elapsed = 0.0;
+    double start = bench_now();
+    for (uint64_t i = live; i < live + ops; ++i) {
+        snprintf(key, KEY_LENGTH, "/churn/%016llx", (unsigned long long)(i - live));
+        vf_hashmap_remove(map, key);
+        snprintf(key, KEY_LENGTH, "/churn/%016llx", (unsigned long long)i);
+        vf_hashmap_set(map, key, &i);
+
+        size_t done = (size_t)(i - live + 1);
+        if (done % report_every == 0) {
+            elapsed += bench_now() - start;
+            print_probe_lengths(map, done, elapsed);
+            start = bench_now();
+        }
+    }
+
+    vf_hashmap_free(map);
+}
+
+// Hash throughput for a given key length, hashing overlapping slices of a buffer.
+static void bench_hash_length(const char* name, vf_hashmap_hash_fn hash_fn, const uint8_t* buffer, size_t length) {
+    const size_t iterations = 1 << 22;
+    uint64_t sum = 0;
+
+    double start = bench_now();
+    for (size_t i = 0; i < iterations; ++i) {
+        sum += hash_fn(buffer + (i & 1023), length, 0);
+    }
+    double elapsed = bench_now() - start;
+    bench_sink = sum;
+
+    printf("[hash] %-6s %4zu bytes: %7.2f ns/hash, %6.2f GB/s\n", name, length,
+           elapsed * 1e9 / (double)iterations,
+           (double)(iterations * length) / elapsed / 1e9);
+}
+
+static void bench_hash(void) {
+    uint8_t* buffer = malloc(1024 + 256);
+    uint64_t state = 7;
+    for (size_t i = 0; i < 1024 + 256; ++i) {
+        buffer[i] = (uint8_t)bench_rand(&state);
+    }
+
+    for (size_t length = 8; length <= 256; length *= 2) {
+        bench_hash_length("fnv1a", vf_hashmap_hash_fnv1a, buffer, length);
+        bench_hash_length("bytes", vf_hashmap_hash_bytes, buffer, length);
+    }
+
+    free(buffer);
+}
+
+// Integer ids looked up through a u64-keyed map versus formatted into strings.
+static void bench_ids(size_t count) {
+    char key[32];
+    vf_hashmap_t* strings = vf_hashmap_create(sizeof(uint64_t));
+    vf_hashmap_t* ids = vf_hashmap_create_keyed(sizeof(uint64_t), sizeof(uint64_t));
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t id = i * 0x9E3779B97F4A7C15ULL;
+        snprintf(key, sizeof(key), "%llu", (unsigned long long)id);
+        vf_hashmap_set(strings, key, &i);
+        vf_hashmap_set_u64(ids, id, &i);
+    }
+
+    uint64_t sum = 0;
+    uint64_t state = 3;
+    double start = bench_now();
+    for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+        uint64_t id = (bench_rand(&state) % count) * 0x9E3779B97F4A7C15ULL;
+        snprintf(key, sizeof(key), "%llu", (unsigned long long)id);
+        sum += *(const uint64_t*)vf_hashmap_get(strings, key);
+    }
+    double string_time = bench_now() - start;
+
+    state = 3;
+    start = bench_now();
+    for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+        uint64_t id = (bench_rand(&state) % count) * 0x9E3779B97F4A7C15ULL;
+        sum += *(const uint64_t*)vf_hashmap_get_u64(ids, id);
+    }
+    double id_time = bench_now() - start;
+    bench_sink = sum;
+
+    printf("[%s] %9zu ids: snprintf + string key %7.1f ns/op, u64 key %7.1f ns/op\n",
+           LAYOUT_NAME, count, string_time * 1e9 / LOOKUP_COUNT, id_time * 1e9 / LOOKUP_COUNT);
+
+    vf_hashmap_free(strings);
+    vf_hashmap_free(ids);
+}
+
+#define CONCURRENT_KEYS      1000000
+#define CONCURRENT_OPS       4000000
+#define CONCURRENT_MAX_THREADS 16
+
+typedef struct {
+    vf_hashmap_t* map;              // Single-lock baseline, guarded by `mutex`
+    vf_mutex_t* mutex;
+    vf_hashmap_sharded_t* sharded;  // Used instead when not NULL
+    vf_hashmap_rcu_t* rcu;          // Same, read-only workloads only
+    size_t ops;
+    unsigned read_percent;
+    uint64_t seed;
+} concurrent_args_t;
+
+// Mix of lookups and writes over a fixed key range. Writes alternate between
+// inserting and removing, so the map size stays around its initial size.
+static void* concurrent_worker(void* arg) {
+    concurrent_args_t* args = (concurrent_args_t*)arg;
+    uint64_t state = args->seed;
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < args->ops; ++i) {
+        uint64_t r = bench_rand(&state);
+        uint64_t key = r % CONCURRENT_KEYS;
+        uint64_t value = key;
+        int read = (unsigned)((r >> 32) % 100) < args->read_percent;
+        int insert = (int)((r >> 48) & 1);
+
+        if (args->rcu) {
+            sum += (uint64_t)vf_hashmap_rcu_get_n(args->rcu, &key, sizeof(key), &value);
+            continue;
+        }
+        if (args->sharded) {
+            if (read) {
+                sum += (uint64_t)vf_hashmap_sharded_get_n(args->sharded, &key, sizeof(key), &value);
+            } else if (insert) {
+                vf_hashmap_sharded_set_n(args->sharded, &key, sizeof(key), &value);
+            } else {
+                vf_hashmap_sharded_remove_n(args->sharded, &key, sizeof(key));
+            }
+            continue;
+        }
+
+        vf_mutex_lock(args->mutex);
+        if (read) {
+            const uint64_t* found = (const uint64_t*)vf_hashmap_get_u64(args->map, key);
+            if (found) sum += *found;
+        } else if (insert) {
+            vf_hashmap_set_u64(args->map, key, &value);
+        } else {
+            vf_hashmap_remove_u64(args->map, key);
+        }
+        vf_mutex_unlock(args->mutex);
+    }
+
+    bench_sink = sum;
+    return NULL;
+}
+
+// Runs CONCURRENT_OPS operations split over `threads` threads, returns Mops/s.
+static double run_concurrent(concurrent_args_t* base, size_t threads) {
+    vf_thread_t handles[CONCURRENT_MAX_THREADS];
+    concurrent_args_t args[CONCURRENT_MAX_THREADS];
+
+    double start = bench_now();
+    for (size_t t = 0; t < threads; ++t) {
+        args[t] = *base;
+        args[t].ops = CONCURRENT_OPS / threads;
+        args[t].seed = 0x9E3779B97F4A7C15ULL * (t + 1);
+        vf_thread_create(&handles[t], concurrent_worker, &args[t]);
+    }
+    for (size_t t = 0; t < threads; ++t) {
+        vf_thread_join(&handles[t]);
+    }
+    double elapsed = bench_now() - start;
+
+    return (double)(CONCURRENT_OPS / threads * threads) / elapsed / 1e6;
+}
+
+// Throughput of one map behind a single mutex against the sharded map, for
+// read-mostly to write-heavy mixes and a growing number of threads. The RCU
+// map copies the table on every write, so it only runs the read-only mix.
+static void bench_concurrent(void) {
+    const unsigned read_percents[] = {100, 99, 90, 50};
+    const size_t thread_counts[] = {1, 2, 4, 8, 16};
+
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.key_size = sizeof(uint64_t);
+    config.value_size = sizeof(uint64_t);
+
+    for (size_t r = 0; r < sizeof(read_percents) / sizeof(read_percents[0]); ++r) {
+        for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); ++t) {
+            vf_mutex_t mutex;
+            vf_mutex_init(&mutex);
+            vf_hashmap_t* map = vf_hashmap_create_keyed(sizeof(uint64_t), sizeof(uint64_t));
+            vf_hashmap_sharded_t* sharded = vf_hashmap_sharded_create(&config, 0);
+            vf_hashmap_rcu_t* rcu = vf_hashmap_rcu_create(&config);
+            vf_hashmap_t* initial = vf_hashmap_rcu_write_begin(rcu);
+            for (uint64_t key = 0; key < CONCURRENT_KEYS; key += 2) {
+                vf_hashmap_set_u64(map, key, &key);
+                vf_hashmap_sharded_set_n(sharded, &key, sizeof(key), &key);
+                vf_hashmap_set_u64(initial, key, &key);
+            }
+            vf_hashmap_rcu_write_commit(rcu, initial);
+
+            concurrent_args_t args;
+            memset(&args, 0, sizeof(args));
+            args.read_percent = read_percents[r];
+            args.map = map;
+            args.mutex = &mutex;
+            double locked = run_concurrent(&args, thread_counts[t]);
+            args.sharded = sharded;
+            double striped = run_concurrent(&args, thread_counts[t]);
+            printf("[%s] %3u%% reads, %2zu threads: single mutex %6.2f Mops/s, %zu shards %6.2f Mops/s",
+                   LAYOUT_NAME, read_percents[r], thread_counts[t], locked, sharded->shard_count, striped);
+            if (read_percents[r] == 100) {
+                args.rcu = rcu;
+                printf(", rcu %6.2f Mops/s", run_concurrent(&args, thread_counts[t]));
+            }
+            printf("\n");
+
+            vf_hashmap_rcu_free(rcu);
+            vf_hashmap_sharded_free(sharded);
+            vf_hashmap_free(map);
+            vf_mutex_destroy(&mutex);
+        }
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Times every single insert while growing a map from empty to `count` keys,
+// and reports the latency distribution. A full rehash shows up in the tail.
+static void bench_latency_mode(size_t count, int incremental) {
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.key_size = sizeof(uint64_t);
+    config.value_size = sizeof(uint64_t);
+    config.incremental_resize = incremental;
+    vf_hashmap_t* map = vf_hashmap_create_with_config(&config);
+    double* samples = malloc(count * sizeof(double));
+
+    uint64_t state = 11;
+    double total = bench_now();
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = bench_rand(&state);
+        double start = bench_now();
+        vf_hashmap_set_u64(map, key, &key);
+        samples[i] = bench_now() - start;
+    }
+    total = bench_now() - total;
+
+    qsort(samples, count, sizeof(double), compare_doubles);
+    printf("[%s] %-11s %zu inserts: p50 %6.0f ns, p99 %6.0f ns, p99.9 %7.0f ns, p99.99 %9.0f ns, max %10.0f ns, total %6.1f ms\n",
+           LAYOUT_NAME, incremental ? "incremental" : "stop-world", count,
+           samples[count / 2] * 1e9,
+           samples[count - count / 100] * 1e9,
+           samples[count - count / 1000] * 1e9,
+           samples[count - count / 10000] * 1e9,
+           samples[count - 1] * 1e9,
+           total * 1e3);
+
+    free(samples);
+    vf_hashmap_free(map);
+}
+
+static void bench_latency(void) {
+    bench_latency_mode(4000000, 0);
+    bench_latency_mode(4000000, 1);
+}
+
+#define BUILD_THREADS 4
+
+// Startup cost of filling a map with `count` keys: one `_set` at a time from
+// the initial capacity, after a `_reserve`, and in bulk.
+static void bench_build(size_t count) {
+    char (*names)[KEY_LENGTH] = make_keys(count, 0x2545F4914F6CDD1DULL);
+    const char** keys = malloc(count * sizeof(const char*));
+    uint64_t* ids = malloc(count * sizeof(uint64_t));
+    uint64_t* values = malloc(count * sizeof(uint64_t));
+    uint64_t state = 5;
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = names[i];
+        ids[i] = bench_rand(&state);
+        values[i] = i;
+    }
+    vf_threadpool_t* pool = vf_threadpool_create(BUILD_THREADS);
+
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(uint64_t);
+
+    for (int keyed = 0; keyed < 2; ++keyed) {
+        config.key_size = keyed ? sizeof(uint64_t) : 0;
+        double times[4];
+
+        for (int reserve = 0; reserve < 2; ++reserve) {
+            double start = bench_now();
+            vf_hashmap_t* map = vf_hashmap_create_with_config(&config);
+            if (reserve) vf_hashmap_reserve(map, count);
+            for (size_t i = 0; i < count; ++i) {
+                if (keyed) {
+                    vf_hashmap_set_u64(map, ids[i], &values[i]);
+                } else {
+                    vf_hashmap_set(map, keys[i], &values[i]);
+                }
+            }
+            times[reserve] = bench_now() - start;
+            vf_hashmap_free(map);
+        }
+
+        for (int parallel = 0; parallel < 2; ++parallel) {
+            double start = bench_now();
+            vf_hashmap_t* map;
+            if (keyed) {
+                map = parallel ? vf_hashmap_build_keyed_parallel(&config, ids, values, count, pool)
+                               : vf_hashmap_build_keyed(&config, ids, values, count);
+            } else {
+                map = parallel ? vf_hashmap_build_parallel(&config, keys, NULL, values, count, pool)
+                               : vf_hashmap_build(&config, keys, NULL, values, count);
+            }
+            times[2 + parallel] = bench_now() - start;
+            vf_hashmap_free(map);
+        }
+
+        printf("[%s] build %8zu %s keys: set %7.1f ms, reserve + set %7.1f ms, build %7.1f ms, build on %d threads %7.1f ms\n",
+               LAYOUT_NAME, count, keyed ? "u64" : "string", times[0] * 1e3, times[1] * 1e3, times[2] * 1e3,
+               BUILD_THREADS, times[3] * 1e3);
+    }
+
+    vf_threadpool_destroy(pool);
+    free(values);
+    free(ids);
+    free(keys);
+    free(names);
+}
+
+// One `_get` after another against `_get_batch` in request-sized batches,
+// on tables much bigger than the caches.
+static void bench_batch(size_t count) {
+    const size_t batch_sizes[] = {64, 256, 512};
+    char (*names)[KEY_LENGTH] = make_keys(count, 0x9E3779B97F4A7C15ULL);
+    uint64_t* ids = malloc(count * sizeof(uint64_t));
+    uint64_t* values = malloc(count * sizeof(uint64_t));
+    const char** keys = malloc(count * sizeof(const char*));
+    uint64_t state = 17;
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = names[i];
+        ids[i] = bench_rand(&state);
+        values[i] = i;
+    }
+
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(uint64_t);
+    vf_hashmap_t* strings = vf_hashmap_build(&config, keys, NULL, values, count);
+    config.key_size = sizeof(uint64_t);
+    vf_hashmap_t* numbers = vf_hashmap_build_keyed(&config, ids, values, count);
+
+    // Lookups in random order, gathered into contiguous request arrays
+    const char** query_keys = malloc(LOOKUP_COUNT * sizeof(const char*));
+    uint64_t* query_ids = malloc(LOOKUP_COUNT * sizeof(uint64_t));
+    const void** out = malloc(LOOKUP_COUNT * sizeof(const void*));
+    for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+        size_t pick = (size_t)(bench_rand(&state) % count);
+        query_keys[i] = keys[pick];
+        query_ids[i] = ids[pick];
+    }
+
+    for (int keyed = 0; keyed < 2; ++keyed) {
+        uint64_t sum = 0;
+        double start = bench_now();
+        for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+            sum += keyed ? *(const uint64_t*)vf_hashmap_get_u64(numbers, query_ids[i])
+                         : *(const uint64_t*)vf_hashmap_get(strings, query_keys[i]);
+        }
+        double single = bench_now() - start;
+        printf("[%s] batch %8zu %-6s keys: single %6.1f ns/op", LAYOUT_NAME, count, keyed ? "u64" : "string",
+               single * 1e9 / LOOKUP_COUNT);
+
+        for (size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); ++b) {
+            size_t batch = batch_sizes[b];
+            start = bench_now();
+            for (size_t i = 0; i + batch <= LOOKUP_COUNT; i += batch) {
+                if (keyed) {
+                    vf_hashmap_get_batch_keyed(numbers, query_ids + i, batch, out + i);
+                } else {
+                    vf_hashmap_get_batch(strings, query_keys + i, NULL, batch, out + i);
+                }
+                for (size_t j = 0; j < batch; ++j) {
+                    sum += *(const uint64_t*)out[i + j];
+                }
+            }
+            double batched = bench_now() - start;
+            printf(", batch %3zu %6.1f ns/op", batch, batched * 1e9 / (double)(LOOKUP_COUNT / batch * batch));
+        }
+        printf("\n");
+        bench_sink = sum;
+    }
+
+    free(out);
+    free(query_ids);
+    free(query_keys);
+    vf_hashmap_free(numbers);
+    vf_hashmap_free(strings);
+    free(keys);
+    free(values);
+    free(ids);
+    free(names);
+}
+
+// Startup cost of a big table: building it from the source keys against
+// mapping a saved copy, then the first lookups, which fault its pages in.
+static void bench_mmap(size_t count) {
+    const char* path = "speed_hashmap.map";
+    char (*names)[KEY_LENGTH] = make_keys(count, 0x2545F4914F6CDD1DULL);
+    const char** keys = malloc(count * sizeof(const char*));
+    uint64_t* values = malloc(count * sizeof(uint64_t));
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = names[i];
+        values[i] = i;
+    }
+    uint32_t* order = malloc(LOOKUP_COUNT * sizeof(uint32_t));
+    uint64_t state = 23;
+    for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+        order[i] = (uint32_t)(bench_rand(&state) % count);
+    }
+
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(uint64_t);
+
+    double start = bench_now();
+    vf_hashmap_t* built = vf_hashmap_build(&config, keys, NULL, values, count);
+    double build_time = bench_now() - start;
+
+    start = bench_now();
+    vf_hashmap_save(built, path);
+    double save_time = bench_now() - start;
+
+    double lookup_times[2];
+    vf_hashmap_t* maps[2] = {built, NULL};
+    start = bench_now();
+    maps[1] = vf_hashmap_open_mmap(path, NULL);
+    double open_time = bench_now() - start;
+
+    for (int m = 0; m < 2; ++m) {
+        uint64_t sum = 0;
+        start = bench_now();
+        for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+            sum += *(const uint64_t*)vf_hashmap_get(maps[m], keys[order[i]]);
+        }
+        lookup_times[m] = bench_now() - start;
+        bench_sink = sum;
+    }
+
+    printf("[%s] mmap %8zu keys: build %7.1f ms, save %7.1f ms, open %7.3f ms | %d gets: built %6.1f ns/op, mapped %6.1f ns/op\n",
+           LAYOUT_NAME, count, build_time * 1e3, save_time * 1e3, open_time * 1e3, LOOKUP_COUNT,
+           lookup_times[0] / LOOKUP_COUNT * 1e9, lookup_times[1] / LOOKUP_COUNT * 1e9);
+
+    vf_hashmap_free(maps[1]);
+    vf_hashmap_free(built);
+    remove(path);
+    free(order);
+    free(values);
+    free(keys);
+    free(names);
+}
+
+// Bytes held by a live map's arrays and key arena.
+static size_t live_bytes(const vf_hashmap_t* map) {
+    size_t slot = sizeof(vf_hashmap_entry_t) + map->value_size;
+#ifdef VF_HASHMAP_SWISS_TABLE
+    slot += 1;
+#endif
+    return map->capacity * slot + map->keys_capacity;
+}
+
+static size_t frozen_bytes(const vf_hashmap_frozen_t* map) {
+    return map->slot_count * map->slot_stride + map->bucket_count * sizeof(uint32_t) + map->hasher.keys_size;
+}
+
+// Live table against its frozen, perfectly hashed copy: lookup time on hits
+// and misses, and memory per key.
+static void bench_frozen(size_t count) {
+    char (*names)[KEY_LENGTH] = make_keys(count, 0x9E3779B97F4A7C15ULL);
+    char (*missing)[KEY_LENGTH] = make_keys(count, 0xD1B54A32D192ED03ULL);
+    uint32_t* order = malloc(LOOKUP_COUNT * sizeof(uint32_t));
+    uint64_t state = 31;
+    for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+        order[i] = (uint32_t)(bench_rand(&state) % count);
+    }
+
+    for (int keyed = 0; keyed < 2; ++keyed) {
+        vf_hashmap_t* map = keyed ? vf_hashmap_create_keyed(sizeof(uint64_t), sizeof(uint64_t))
+                                  : vf_hashmap_create(sizeof(uint64_t));
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t value = i;
+            if (keyed) {
+                vf_hashmap_set_u64(map, (uint64_t)i * 0x9E3779B97F4A7C15ULL, &value);
+            } else {
+                vf_hashmap_set(map, names[i], &value);
+            }
+        }
+
+        double start = bench_now();
+        vf_hashmap_frozen_t* frozen = vf_hashmap_freeze(map);
+        double freeze_time = bench_now() - start;
+
+        double times[2][2];
+        for (int f = 0; f < 2; ++f) {
+            for (int miss = 0; miss < 2; ++miss) {
+                uint64_t sum = 0;
+                start = bench_now();
+                for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+                    size_t k = order[i];
+                    const void* value;
+                    if (keyed) {
+                        uint64_t id = (uint64_t)k * 0x9E3779B97F4A7C15ULL + miss;
+                        value = f ? vf_hashmap_frozen_get_u64(frozen, id) : vf_hashmap_get_u64(map, id);
+                    } else {
+                        const char* key = miss ? missing[k] : names[k];
+                        value = f ? vf_hashmap_frozen_get(frozen, key) : vf_hashmap_get(map, key);
+                    }
+                    sum += value ? *(const uint64_t*)value : 1;
+                }
+                times[f][miss] = (bench_now() - start) / LOOKUP_COUNT * 1e9;
+                bench_sink = sum;
+            }
+        }
+
+        printf("[%s] frozen %8zu %s keys: freeze %7.1f ms | hit %6.1f -> %6.1f ns/op, miss %6.1f -> %6.1f ns/op | %5.1f -> %5.1f bytes/key\n",
+               LAYOUT_NAME, count, keyed ? "u64" : "string", freeze_time * 1e3, times[0][0], times[1][0],
+               times[0][1], times[1][1], (double)live_bytes(map) / count, (double)frozen_bytes(frozen) / count);
+
+        vf_hashmap_frozen_free(frozen);
+        vf_hashmap_free(map);
+    }
+
+    free(order);
+    free(missing);
+    free(names);
+}
+
+// Sequential, similar keys hashed with FNV-1a, filled right up to the load
+// factor: the clustering that makes plain linear probing chains long.
+static void bench_probes(size_t capacity) {
+    size_t count = (size_t)(capacity * VF_HASH_LOAD_FACTOR);
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(uint64_t);
+    config.hash_fn = vf_hashmap_hash_fnv1a;
+    vf_hashmap_t* map = vf_hashmap_create_with_config(&config);
+    vf_hashmap_reserve(map, count);
+
+    char key[KEY_LENGTH];
+    for (uint64_t i = 0; i < count; ++i) {
+        snprintf(key, KEY_LENGTH, "metric.%llu", (unsigned long long)i);
+        vf_hashmap_set(map, key, &i);
+    }
+
+    double times[2];
+    for (int miss = 0; miss < 2; ++miss) {
+        uint64_t sum = 0;
+        uint64_t state = 11;
+        double start = bench_now();
+        for (size_t i = 0; i < LOOKUP_COUNT; ++i) {
+            uint64_t k = bench_rand(&state) % count + (miss ? count : 0);
+            snprintf(key, KEY_LENGTH, "metric.%llu", (unsigned long long)k);
+            sum += vf_hashmap_has(map, key);
+        }
+        times[miss] = (bench_now() - start) / LOOKUP_COUNT * 1e9;
+        bench_sink = sum;
+    }
+
+    vf_hashmap_stats_t stats = vf_hashmap_stats(map);
+    size_t tail = stats.histogram[VF_HASH_STATS_BUCKETS - 1];
+    printf("[%s] probes %8zu keys, load %.2f: mean displacement %5.2f, max %5zu, %zu entries >= %d | hit %6.1f ns/op, miss %6.1f ns/op\n",
+           LAYOUT_NAME, count, (double)count / map->capacity, stats.mean_displacement, stats.max_displacement,
+           tail, VF_HASH_STATS_BUCKETS - 1, times[0], times[1]);
+
+    vf_hashmap_free(map);
+}
+
+int main(int argc, char** argv) {
+    const char* only = (argc > 1) ? argv[1] : NULL;
+
+    if (!only || strcmp(only, "lookup") == 0) {
+        size_t sizes[] = {1000, 100000, 1000000};
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+            bench_lookup(sizes[i]);
+        }
+    }
+    if (!only || strcmp(only, "churn") == 0) {
+        bench_churn(100000, 2000000);
+    }
+    if (!only || strcmp(only, "hash") == 0) {
+        bench_hash();
+    }
+    if (!only || strcmp(only, "ids") == 0) {
+        bench_ids(1000000);
+    }
+    if (!only || strcmp(only, "concurrent") == 0) {
+        bench_concurrent();
+    }
+    if (!only || strcmp(only, "latency") == 0) {
+        bench_latency();
+    }
+    if (!only || strcmp(only, "build") == 0) {
+        bench_build(1000000);
+        bench_build(4000000);
+    }
+    if (!only || strcmp(only, "batch") == 0) {
+        bench_batch(100000);
+        bench_batch(4000000);
+    }
+    if (!only || strcmp(only, "mmap") == 0) {
+        bench_mmap(1000000);
+        bench_mmap(4000000);
+    }
+    if (!only || strcmp(only, "frozen") == 0) {
+        bench_frozen(100000);
+        bench_frozen(1000000);
+        bench_frozen(4000000);
+    }
+    if (!only || strcmp(only, "probes") == 0) {
+        bench_probes(1 << 16);
+        bench_probes(1 << 20);
+    }
+    return 0;
+}
@@ -4,8 +4,11 @@
 #include "test_vf_darray.h"
 #include "test_vf_queue.h"
 #include "test_vf_hashmap.h"
+#include "test_vf_intern.h"
+#include "test_vf_soa.h"
 #include "test_vf_binaryheap.h"
 #include "test_vf_sparseset.h"
+#include "test_vf_memory.h"
 // #include "test_vf_memory_pool.h"
 #include "test_vf_thread.h"
 
@@ -1,3 +1,6 @@
+#define VF_THREAD_IMPLEMENTATION
+#define VF_THREADPOOL_IMPLEMENTATION
+#define VF_DARRAY_ENABLE_PARALLEL
 #define VF_DARRAY_IMPLEMENTATION
 #include "../vf_darray.h"
 
@@ -6,6 +9,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 TEST(DynamicArray, Create) {
     int* da = (int*)vf_da_alloc(sizeof(int));
@@ -106,3 +110,545 @@ TEST(DynamicArray, PopBack) {
     vf_da_free(da);
     return true;
 }
+
+typedef struct {
+    float x, y, z;
+    int id;
+} test_da_point_t;
+
+VF_DA_DEFINE(test_da_int, int)
+VF_DA_DEFINE(test_da_point, test_da_point_t)
+
+TEST(DynamicArray, Typed) {
+    int* da = test_da_int_alloc(1);
+    for (int i = 0; i < 100; i++) {
+        da = test_da_int_push_back(da, i);
+    }
+    EXPECT_EQ(vf_da_count(da), 100);
+    EXPECT_EQ(vf_da_stride(da), sizeof(int));
+    EXPECT_EQ(*test_da_int_at(da, 42), 42);
+
+    EXPECT_EQ(test_da_int_pop_back(da), 99);
+    EXPECT_EQ(vf_da_count(da), 99);
+
+    // Insert at the front, in the middle and at the end
+    da = test_da_int_insert(da, 0, -1);
+    da = test_da_int_insert(da, 50, -2);
+    da = test_da_int_insert(da, vf_da_count(da), -3);
+    EXPECT_EQ(vf_da_count(da), 102);
+    EXPECT_EQ(da[0], -1);
+    EXPECT_EQ(da[1], 0);
+    EXPECT_EQ(da[50], -2);
+    EXPECT_EQ(da[51], 49);
+    EXPECT_EQ(da[100], 98);
+    EXPECT_EQ(da[101], -3);
+    vf_da_free(da);
+
+    // Starting from no capacity at all
+    test_da_point_t* points = test_da_point_alloc(0);
+    for (int i = 0; i < 10; i++) {
+        test_da_point_t point = {(float)i, 0.0f, 1.0f, i};
+        points = test_da_point_push_back(points, point);
+    }
+    EXPECT_EQ(vf_da_count(points), 10);
+    EXPECT_EQ(test_da_point_at(points, 7)->id, 7);
+    test_da_point_t last = test_da_point_pop_back(points);
+    EXPECT_EQ(last.id, 9);
+
+    // Generic functions work on typed arrays and the other way around
+    test_da_point_t extra = {0.0f, 0.0f, 0.0f, 100};
+    points = (test_da_point_t*)vf_da_push_back(points, &extra);
+    EXPECT_EQ(test_da_point_pop_back(points).id, 100);
+    EXPECT_EQ(vf_da_count(points), 9);
+    vf_da_free(points);
+
+    return true;
+}
+
+TEST(DynamicArray, Grow) {
+    int* da = (int*)vf_da_alloc_exact(4, sizeof(int));
+    for (int i = 0; i < 4; i++) {
+        da = (int*)vf_da_push_back(da, &i);
+    }
+
+    // Reserving keeps the elements and the count
+    da = (int*)vf_da_reserve(da, 1000);
+    EXPECT_EQ(vf_da_capacity(da), 1000);
+    EXPECT_EQ(vf_da_count(da), 4);
+    EXPECT_EQ(da[3], 3);
+    // ...and never shrinks
+    da = (int*)vf_da_reserve(da, 10);
+    EXPECT_EQ(vf_da_capacity(da), 1000);
+
+    da = (int*)vf_da_shrink_to_fit(da);
+    EXPECT_EQ(vf_da_capacity(da), 4);
+    EXPECT_EQ(da[0], 0);
+    EXPECT_EQ(da[3], 3);
+
+    // Growing by the factor, or further if asked to
+    da = (int*)vf_da_grow(da, 5);
+    EXPECT_EQ(vf_da_capacity(da), (size_t)(4 * DA_RESIZE_FACTOR));
+    da = (int*)vf_da_grow(da, 100);
+    EXPECT_EQ(vf_da_capacity(da), 100);
+
+    da = (int*)vf_da_resize(da, 200);
+    EXPECT_EQ(vf_da_capacity(da), 200);
+    EXPECT_EQ(vf_da_count(da), 4);
+
+    // An empty array can be shrunk to nothing and grown again
+    vf_da_clear(da);
+    da = (int*)vf_da_shrink_to_fit(da);
+    EXPECT_EQ(vf_da_capacity(da), 0);
+    int value = 7;
+    da = (int*)vf_da_push_back(da, &value);
+    EXPECT_EQ(vf_da_count(da), 1);
+    EXPECT_EQ(da[0], 7);
+
+    vf_da_free(da);
+    return true;
+}
+
+TEST(DynamicArray, Insert) {
+    int* da = (int*)vf_da_alloc(sizeof(int));
+    // Every insert at the front moves the whole array and some have to grow it
+    for (int i = 0; i < 50; i++) {
+        da = (int*)vf_da_insert(da, &i, 0);
+    }
+    EXPECT_EQ(vf_da_count(da), 50);
+    for (int i = 0; i < 50; i++) {
+        EXPECT_EQ(da[i], 49 - i);
+    }
+
+    int value = -1;
+    da = (int*)vf_da_insert(da, &value, 25);
+    EXPECT_EQ(da[24], 25);
+    EXPECT_EQ(da[25], -1);
+    EXPECT_EQ(da[26], 24);
+
+    vf_da_free(da);
+    return true;
+}
+
+TEST(DynamicArray, Huge) {
+    // A gigabyte of address space; only what gets pushed is backed by memory
+    size_t max_capacity = (size_t)1 << 28;
+    int* da = (int*)vf_da_alloc_huge(max_capacity, sizeof(int));
+    EXPECT_NE(da, NULL);
+    EXPECT_EQ(vf_da_count(da), 0);
+    EXPECT_EQ(vf_da_stride(da), sizeof(int));
+    EXPECT_TRUE(vf_da_capacity(da) > 0);
+
+    // Pushing never moves the data
+    int* first = da;
+    for (int i = 0; i < 1000000; i++) {
+        da = (int*)vf_da_push_back(da, &i);
+        EXPECT_EQ(da, first);
+    }
+    EXPECT_EQ(vf_da_count(da), 1000000);
+    EXPECT_EQ(da[999999], 999999);
+
+    // Neither does inserting, reserving or shrinking
+    int value = -1;
+    da = (int*)vf_da_insert(da, &value, 0);
+    EXPECT_EQ(da, first);
+    EXPECT_EQ(da[0], -1);
+    EXPECT_EQ(da[1000000], 999999);
+    EXPECT_EQ(vf_da_reserve(da, max_capacity), first);
+    EXPECT_EQ(vf_da_capacity(da), max_capacity);
+    da = (int*)vf_da_shrink_to_fit(da);
+    EXPECT_EQ(da, first);
+    EXPECT_TRUE(vf_da_capacity(da) >= vf_da_count(da));
+    EXPECT_TRUE(vf_da_capacity(da) < max_capacity);
+    EXPECT_EQ(da[500000], 499999);
+
+    // Past the reservation it fails without touching the array
+    EXPECT_EQ(vf_da_reserve(da, max_capacity + 1), NULL);
+    EXPECT_EQ(vf_da_count(da), 1000001);
+
+    vf_da_free(da);
+
+    // Filled right up to the reservation with the typed functions
+    int* small = (int*)vf_da_alloc_huge(5000, sizeof(int));
+    for (int i = 0; i < 5000; i++) {
+        small = test_da_int_push_back(small, i);
+    }
+    EXPECT_EQ(vf_da_capacity(small), 5000);
+    EXPECT_EQ(test_da_int_push_back(small, 5000), NULL);
+    EXPECT_EQ(small[4999], 4999);
+    vf_da_free(small);
+
+    return true;
+}
+
+TEST(DynamicArray, Ranges) {
+    int values[1000];
+    for (int i = 0; i < 1000; i++) {
+        values[i] = i;
+    }
+
+    int* da = (int*)vf_da_alloc(sizeof(int));
+    da = (int*)vf_da_push_n(da, values, 1000);
+    EXPECT_EQ(vf_da_count(da), 1000);
+    EXPECT_EQ(da[999], 999);
+    da = (int*)vf_da_push_n(da, values, 0);
+    EXPECT_EQ(vf_da_count(da), 1000);
+
+    // Insert a block in the middle, at the front and at the end
+    int block[3] = {-1, -2, -3};
+    da = (int*)vf_da_insert_n(da, block, 3, 500);
+    EXPECT_EQ(da[499], 499);
+    EXPECT_EQ(da[500], -1);
+    EXPECT_EQ(da[502], -3);
+    EXPECT_EQ(da[503], 500);
+    da = (int*)vf_da_insert_n(da, block, 3, 0);
+    da = (int*)vf_da_insert_n(da, block, 3, vf_da_count(da));
+    EXPECT_EQ(vf_da_count(da), 1009);
+    EXPECT_EQ(da[0], -1);
+    EXPECT_EQ(da[3], 0);
+    EXPECT_EQ(da[1008], -3);
+
+    // Erasing undoes it
+    vf_da_erase_range(da, 1006, 3);
+    vf_da_erase_range(da, 503, 3);
+    vf_da_erase_range(da, 0, 3);
+    EXPECT_EQ(vf_da_count(da), 1000);
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(da[i], i);
+    }
+    // A range running past the end stops there
+    vf_da_erase_range(da, 990, 100);
+    EXPECT_EQ(vf_da_count(da), 990);
+    vf_da_erase_range(da, 5000, 1);
+    EXPECT_EQ(vf_da_count(da), 990);
+
+    vf_da_remove(da, 0);
+    EXPECT_EQ(da[0], 1);
+    vf_da_remove_swap(da, 0);
+    EXPECT_EQ(da[0], 989);
+    EXPECT_EQ(vf_da_count(da), 988);
+    vf_da_remove_swap(da, 987);
+    EXPECT_EQ(vf_da_count(da), 987);
+    EXPECT_EQ(da[986], 987);
+
+    vf_da_free(da);
+    return true;
+}
+
+TEST(DynamicArray, Append) {
+    int* a = (int*)vf_da_alloc(sizeof(int));
+    int* b = (int*)vf_da_alloc(sizeof(int));
+    for (int i = 0; i < 10; i++) {
+        a = (int*)vf_da_push_back(a, &i);
+        int value = 100 + i;
+        b = (int*)vf_da_push_back(b, &value);
+    }
+
+    // B is freed by the append
+    a = (int*)vf_da_append(a, b);
+    EXPECT_EQ(vf_da_count(a), 20);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(a[i], i);
+        EXPECT_EQ(a[10 + i], 100 + i);
+    }
+
+    // Different strides don't mix, and B is left alone
+    double* c = (double*)vf_da_alloc(sizeof(double));
+    EXPECT_EQ(vf_da_append(a, c), a);
+    EXPECT_EQ(vf_da_count(a), 20);
+    vf_da_free(c);
+
+    vf_da_free(a);
+    return true;
+}
+
+// A bump allocator over a fixed buffer, reset as a whole.
+typedef struct {
+    uint8_t buffer[16384];
+    size_t used;
+    int allocs;
+    int reallocs;
+    int frees;
+} test_da_arena_t;
+
+static void* test_da_arena_alloc(size_t size, void* user) {
+    test_da_arena_t* arena = (test_da_arena_t*)user;
+    size = (size + 15) & ~(size_t)15;
+    if (arena->used + size > sizeof(arena->buffer)) {
+        return NULL;
+    }
+    void* ptr = arena->buffer + arena->used;
+    arena->used += size;
+    arena->allocs++;
+    return ptr;
+}
+
+static void* test_da_arena_realloc(void* ptr, size_t old_size, size_t new_size, void* user) {
+    test_da_arena_t* arena = (test_da_arena_t*)user;
+    arena->reallocs++;
+    void* grown = test_da_arena_alloc(new_size, user);
+    if (grown != NULL) {
+        memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return grown;
+}
+
+static void test_da_arena_free(void* ptr, size_t size, void* user) {
+    (void)ptr;
+    (void)size;
+    ((test_da_arena_t*)user)->frees++;
+}
+
+TEST(DynamicArray, Allocator) {
+    int* plain = (int*)vf_da_alloc(sizeof(int));
+    EXPECT_EQ(vf_da_get_allocator(plain), NULL);
+    vf_da_free(plain);
+
+    static test_da_arena_t arena;
+    memset(&arena, 0, sizeof(arena));
+    vf_da_allocator_t allocator = {test_da_arena_alloc, test_da_arena_realloc, test_da_arena_free, &arena};
+
+    int* da = (int*)vf_da_alloc_with_allocator(4, sizeof(int), &allocator);
+    EXPECT_NE(da, NULL);
+    EXPECT_TRUE((uint8_t*)da > arena.buffer && (uint8_t*)da < arena.buffer + sizeof(arena.buffer));
+    EXPECT_EQ((uintptr_t)da % 16, 0);
+    EXPECT_EQ(vf_da_get_allocator(da)->user, &arena);
+
+    // Growing goes through the arena and keeps the elements
+    for (int i = 0; i < 100; i++) {
+        da = (int*)vf_da_push_back(da, &i);
+    }
+    EXPECT_EQ(vf_da_count(da), 100);
+    EXPECT_EQ(da[0], 0);
+    EXPECT_EQ(da[99], 99);
+    EXPECT_EQ(arena.allocs, 1 + arena.reallocs);
+    EXPECT_TRUE(arena.reallocs > 0);
+    EXPECT_TRUE((uint8_t*)da > arena.buffer && (uint8_t*)da < arena.buffer + sizeof(arena.buffer));
+
+    // The arena running out fails the push and leaves the array as it was
+    int* big = (int*)vf_da_alloc_with_allocator(0, sizeof(int), &allocator);
+    int values[4096] = {0};
+    EXPECT_EQ(vf_da_push_n(big, values, 4096), NULL);
+    EXPECT_EQ(vf_da_count(big), 0);
+
+    vf_da_free(big);
+    vf_da_free(da);
+    EXPECT_EQ(arena.frees, 2);
+
+    return true;
+}
+
+static int test_da_compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static bool test_da_keep_even(const void* element, void* user) {
+    (void)user;
+    return (*(const uint32_t*)element % 2) == 0;
+}
+
+static void test_da_add_index(void* elements, size_t count, size_t first, void* user) {
+    (void)user;
+    uint32_t* values = (uint32_t*)elements;
+    for (size_t i = 0; i < count; i++) {
+        values[i] += (uint32_t)(first + i);
+    }
+}
+
+static void test_da_halve(const void* in, void* out, size_t count, size_t first, void* user) {
+    (void)first;
+    (void)user;
+    const uint32_t* values = (const uint32_t*)in;
+    double* halves = (double*)out;
+    for (size_t i = 0; i < count; i++) {
+        halves[i] = values[i] / 2.0;
+    }
+}
+
+TEST(DynamicArray, Aligned) {
+    const size_t alignments[] = {32, 64, 4096};
+    for (size_t a = 0; a < sizeof(alignments) / sizeof(alignments[0]); a++) {
+        size_t alignment = alignments[a];
+        double* da = (double*)vf_da_alloc_aligned(sizeof(double), alignment);
+        EXPECT_NE(da, NULL);
+        EXPECT_EQ((uintptr_t)da % alignment, 0);
+
+        // Every reallocation keeps the alignment, and the elements
+        for (int i = 0; i < 10000; i++) {
+            double value = (double)i;
+            da = (double*)vf_da_push_back(da, &value);
+            EXPECT_EQ((uintptr_t)da % alignment, 0);
+        }
+        for (int i = 0; i < 10000; i++) {
+            EXPECT_EQ(da[i], (double)i);
+        }
+
+        vf_da_erase_range(da, 100, 9900);
+        da = (double*)vf_da_shrink_to_fit(da);
+        EXPECT_EQ((uintptr_t)da % alignment, 0);
+        EXPECT_EQ(vf_da_capacity(da), 100);
+        EXPECT_EQ(da[99], 99.0);
+
+        da = (double*)vf_da_resize(da, 50000);
+        EXPECT_EQ((uintptr_t)da % alignment, 0);
+        EXPECT_EQ(vf_da_count(da), 100);
+        EXPECT_EQ(da[42], 42.0);
+        vf_da_free(da);
+    }
+
+    // Up to 16 bytes is what every darray gets
+    int* small = (int*)vf_da_alloc_aligned_exact(10, sizeof(int), 8);
+    EXPECT_NE(small, NULL);
+    EXPECT_EQ((uintptr_t)small % 16, 0);
+    vf_da_free(small);
+
+    EXPECT_EQ(vf_da_alloc_aligned(sizeof(int), 48), NULL);
+    return true;
+}
+
+typedef struct {
+    int id;
+    VF_DA_SMALL(int, 4) children;
+} test_da_node_t;
+
+TEST(DynamicArray, Small) {
+    VF_DA_SMALL(int, 8) storage;
+    int* da = (int*)VF_DA_SMALL_INIT(storage);
+    EXPECT_EQ((void*)da, (void*)storage.items);
+    EXPECT_EQ(vf_da_capacity(da), 8);
+    EXPECT_EQ(vf_da_stride(da), sizeof(int));
+
+    for (int i = 0; i < 8; i++) {
+        da = (int*)vf_da_push_back(da, &i);
+    }
+    // Still in the buffer, and shrinking keeps it there
+    EXPECT_EQ((void*)da, (void*)storage.items);
+    EXPECT_TRUE(vf_da_is_small(da));
+    vf_da_pop_back(da);
+    EXPECT_EQ(vf_da_shrink_to_fit(da), (void*)storage.items);
+    EXPECT_EQ(vf_da_capacity(da), 8);
+
+    // The ninth element spills to the heap
+    for (int i = 7; i < 20; i++) {
+        da = (int*)vf_da_push_back(da, &i);
+    }
+    EXPECT_NE((void*)da, (void*)storage.items);
+    EXPECT_FALSE(vf_da_is_small(da));
+    EXPECT_EQ(vf_da_count(da), 20);
+    EXPECT_TRUE(vf_da_capacity(da) >= 20);
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(da[i], i);
+    }
+    vf_da_free(da);
+
+    // Embedded in a struct, and used through the typed functions
+    test_da_node_t node;
+    node.id = 1;
+    int* children = (int*)VF_DA_SMALL_INIT(node.children);
+    children = test_da_int_push_back(children, 10);
+    children = test_da_int_insert(children, 0, 5);
+    EXPECT_TRUE(vf_da_is_small(children));
+    EXPECT_EQ(children[0], 5);
+    EXPECT_EQ(test_da_int_pop_back(children), 10);
+    // Freeing an array still in its buffer does nothing
+    vf_da_free(children);
+
+    int* heap = (int*)vf_da_alloc(sizeof(int));
+    EXPECT_FALSE(vf_da_is_small(heap));
+    vf_da_free(heap);
+    return true;
+}
+
+TEST(DynamicArray, Swap) {
+    // Strides that hit the chunk, word and byte paths
+    const size_t strides[] = {1, 4, 12, 40, 100};
+    for (size_t s = 0; s < sizeof(strides) / sizeof(strides[0]); s++) {
+        size_t stride = strides[s];
+        unsigned char* elements = (unsigned char*)vf_da_alloc_exact(3, stride);
+        for (size_t e = 0; e < 3; e++) {
+            unsigned char element[100];
+            for (size_t i = 0; i < stride; i++) {
+                element[i] = (unsigned char)(e * 100 + i);
+            }
+            elements = (unsigned char*)vf_da_push_back(elements, element);
+        }
+        vf_da_swap(elements, 0, 2);
+        for (size_t i = 0; i < stride; i++) {
+            EXPECT_EQ(elements[i], (unsigned char)(200 + i));
+            EXPECT_EQ(elements[stride + i], (unsigned char)(100 + i));
+            EXPECT_EQ(elements[2 * stride + i], (unsigned char)i);
+        }
+        // An element swapped with itself stays as it was
+        vf_da_swap(elements, 1, 1);
+        for (size_t i = 0; i < stride; i++) {
+            EXPECT_EQ(elements[stride + i], (unsigned char)(100 + i));
+        }
+        vf_da_free(elements);
+    }
+    return true;
+}
+
+TEST(DynamicArray, Parallel) {
+    vf_threadpool_t* pool = vf_threadpool_create(3);
+    EXPECT_NE(pool, NULL);
+
+    // Sizes that give a single chunk, a few, and every chunk a worker can get,
+    // sorted on the pool and without one
+    size_t sizes[] = {0, 1, 1000, 20000, 300001};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int use_pool = 0; use_pool < 2; use_pool++) {
+            uint32_t* da = (uint32_t*)vf_da_alloc_exact(sizes[s], sizeof(uint32_t));
+            uint32_t* expected = (uint32_t*)malloc((sizes[s] + 1) * sizeof(uint32_t));
+            uint32_t state = 12345;
+            for (size_t i = 0; i < sizes[s]; i++) {
+                state = state * 1664525u + 1013904223u;
+                uint32_t value = state >> 12;
+                da = (uint32_t*)vf_da_push_back(da, &value);
+                expected[i] = value;
+            }
+            qsort(expected, sizes[s], sizeof(uint32_t), test_da_compare_u32);
+
+            vf_da_parallel_sort(da, test_da_compare_u32, use_pool ? pool : NULL);
+            EXPECT_EQ(vf_da_count(da), sizes[s]);
+            EXPECT_EQ(memcmp(da, expected, sizes[s] * sizeof(uint32_t)), 0);
+
+            free(expected);
+            vf_da_free(da);
+        }
+    }
+
+    size_t count = 100000;
+    uint32_t* da = (uint32_t*)vf_da_alloc_exact(count, sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        da = (uint32_t*)vf_da_push_back(da, &i);
+    }
+
+    // Filtering keeps the order
+    uint32_t* even = (uint32_t*)vf_da_parallel_filter(da, test_da_keep_even, NULL, pool);
+    EXPECT_EQ(vf_da_count(even), count / 2);
+    bool ordered = true;
+    for (size_t i = 0; i < count / 2; i++) {
+        ordered = ordered && (even[i] == 2 * i);
+    }
+    EXPECT_TRUE(ordered);
+    vf_da_free(even);
+
+    // Every element is visited exactly once, with its own index
+    vf_da_parallel_for_each(da, test_da_add_index, NULL, pool);
+    bool visited = true;
+    for (size_t i = 0; i < count; i++) {
+        visited = visited && (da[i] == 2 * i);
+    }
+    EXPECT_TRUE(visited);
+
+    double* halves = (double*)vf_da_parallel_map(da, sizeof(double), test_da_halve, NULL, pool);
+    EXPECT_EQ(vf_da_count(halves), count);
+    EXPECT_EQ(vf_da_stride(halves), sizeof(double));
+    EXPECT_TRUE(halves[12345] == 12345.0);
+    vf_da_free(halves);
+
+    vf_da_free(da);
+    vf_threadpool_destroy(pool);
+    return true;
+}
@@ -1,10 +1,14 @@
 #include "../vf_test.h"
 
+#define VF_THREAD_IMPLEMENTATION
+#define VF_THREADPOOL_IMPLEMENTATION
+#define VF_HASHMAP_ENABLE_CONCURRENT
 #define VF_HASHMAP_IMPLEMENTATION
 #include "../vf_hashmap.h"
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 TEST(Hashmap, Create) {
@@ -204,3 +208,923 @@ TEST(Hashmap, DifferentTypes) {
 
     return true;
 }
+
+TEST(Hashmap, ManyKeys) {
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(int));
+
+    // Enough keys to span many probe groups and several expansions
+    for (int i = 0; i < 5000; i++) {
+        char key[32];
+        sprintf(key, "entity/%d", i);
+        EXPECT_EQ(vf_hashmap_set(map, key, &i), 0);
+    }
+    EXPECT_EQ(vf_hashmap_size(map), 5000);
+
+    for (int i = 0; i < 5000; i++) {
+        char key[32];
+        sprintf(key, "entity/%d", i);
+        EXPECT_EQ(*(const int*)vf_hashmap_get(map, key), i);
+    }
+    EXPECT_EQ(vf_hashmap_has(map, "entity/5000"), 0);
+
+    vf_hashmap_free(map);
+    return true;
+}
+
+TEST(Hashmap, LongKeys) {
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(int));
+
+    // Mix of keys that fit inline and keys that go to the key arena
+    const char* keys[] = {
+        "short",
+        "exactly_16_bytes",
+        "a_key_that_is_longer_than_the_inline_buffer",
+        "/usr/local/share/some/fairly/long/path/to/an/asset.bin",
+    };
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(vf_hashmap_set(map, keys[i], &i), 0);
+    }
+
+    // Grow the map so the arena offsets have to survive an expansion
+    for (int i = 0; i < 100; i++) {
+        char key[64];
+        sprintf(key, "/filler/key/that/does/not/fit/inline/%d", i);
+        EXPECT_EQ(vf_hashmap_set(map, key, &i), 0);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(*(const int*)vf_hashmap_get(map, keys[i]), i);
+    }
+
+    // A prefix of a stored key is a different key
+    EXPECT_EQ(vf_hashmap_has(map, "a_key_that_is_longer"), 0);
+
+    vf_hashmap_free(map);
+    return true;
+}
+
+TEST(Hashmap, RemoveKeepsProbeChains) {
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(int));
+
+    for (int i = 0; i < 5000; i++) {
+        char key[32];
+        sprintf(key, "entity/%d", i);
+        EXPECT_EQ(vf_hashmap_set(map, key, &i), 0);
+    }
+
+    // Remove every other key
+    for (int i = 0; i < 5000; i += 2) {
+        char key[32];
+        sprintf(key, "entity/%d", i);
+        vf_hashmap_remove(map, key);
+    }
+    EXPECT_EQ(vf_hashmap_size(map), 2500);
+
+    // Survivors must still be reachable past the removed slots
+    for (int i = 0; i < 5000; i++) {
+        char key[32];
+        sprintf(key, "entity/%d", i);
+        if (i % 2 == 0) {
+            EXPECT_EQ(vf_hashmap_has(map, key), 0);
+        } else {
+            const int* value = (const int*)vf_hashmap_get(map, key);
+            EXPECT_NE(value, NULL);
+            if (value) EXPECT_EQ(*value, i);
+        }
+    }
+
+    vf_hashmap_free(map);
+    return true;
+}
+
+TEST(Hashmap, Churn) {
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(int));
+    char key[32];
+
+    // Keep 1000 live keys while inserting and removing 100k in total
+    for (int i = 0; i < 100000; i++) {
+        sprintf(key, "churn/%d", i);
+        EXPECT_EQ(vf_hashmap_set(map, key, &i), 0);
+        if (i >= 1000) {
+            sprintf(key, "churn/%d", i - 1000);
+            vf_hashmap_remove(map, key);
+        }
+    }
+    EXPECT_EQ(vf_hashmap_size(map), 1000);
+
+    // Churn must not grow the table without bound
+    EXPECT_LE(vf_hashmap_capacity(map), 4096);
+
+    for (int i = 99000; i < 100000; i++) {
+        sprintf(key, "churn/%d", i);
+        const int* value = (const int*)vf_hashmap_get(map, key);
+        EXPECT_NE(value, NULL);
+        if (value) EXPECT_EQ(*value, i);
+    }
+
+    vf_hashmap_free(map);
+    return true;
+}
+
+TEST(Hashmap, KeysWithLength) {
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(int));
+
+    // Slices of one buffer, none of them zero-terminated
+    const char* path = "/assets/textures/stone.png";
+    int value1 = 1;
+    int value2 = 2;
+    EXPECT_EQ(vf_hashmap_set_n(map, path, 7, &value1), 0);       // "/assets"
+    EXPECT_EQ(vf_hashmap_set_n(map, path + 8, 8, &value2), 0);   // "textures"
+
+    EXPECT_EQ(*(const int*)vf_hashmap_get(map, "/assets"), value1);
+    EXPECT_EQ(*(const int*)vf_hashmap_get_n(map, "textures/", 8), value2);
+    EXPECT_EQ(vf_hashmap_has_n(map, path, 8), 0);
+
+    vf_hashmap_remove_n(map, path, 7);
+    EXPECT_EQ(vf_hashmap_has(map, "/assets"), 0);
+    EXPECT_EQ(vf_hashmap_size(map), 1);
+
+    vf_hashmap_free(map);
+    return true;
+}
+
+// Worst possible hash: every key collides
+static uint64_t constant_hash(const void* key, size_t length, uint64_t seed) {
+    (void)key;
+    (void)length;
+    return seed;
+}
+
+TEST(Hashmap, CustomHash) {
+    vf_hashmap_config_t config = {0};
+    config.value_size = sizeof(int);
+    config.hash_fn = constant_hash;
+    config.seed = 7;
+    vf_hashmap_t* map = vf_hashmap_create_with_config(&config);
+    EXPECT_NE(map, NULL);
+
+    for (int i = 0; i < 100; i++) {
+        char key[16];
+        sprintf(key, "key%d", i);
+        EXPECT_EQ(vf_hashmap_set(map, key, &i), 0);
+    }
+    for (int i = 0; i < 100; i += 3) {
+        char key[16];
+        sprintf(key, "key%d", i);
+        vf_hashmap_remove(map, key);
+    }
+    for (int i = 0; i < 100; i++) {
+        char key[16];
+        sprintf(key, "key%d", i);
+        EXPECT_EQ(vf_hashmap_has(map, key), i % 3 != 0);
+    }
+    vf_hashmap_free(map);
+
+    // The built-in hashes can be selected too
+    config.hash_fn = vf_hashmap_hash_fnv1a;
+    map = vf_hashmap_create_with_config(&config);
+    int value = 5;
+    vf_hashmap_set(map, "fnv", &value);
+    EXPECT_EQ(*(const int*)vf_hashmap_get(map, "fnv"), value);
+    vf_hashmap_free(map);
+
+    return true;
+}
+
+TEST(Hashmap, IntegerKeys) {
+    vf_hashmap_t* map = vf_hashmap_create_keyed(sizeof(uint64_t), sizeof(int));
+    EXPECT_NE(map, NULL);
+
+    for (int i = 0; i < 1000; i++) {
+        uint64_t id = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+        EXPECT_EQ(vf_hashmap_set_u64(map, id, &i), 0);
+    }
+    EXPECT_EQ(vf_hashmap_size(map), 1000);
+
+    for (int i = 0; i < 1000; i++) {
+        uint64_t id = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+        EXPECT_EQ(*(const int*)vf_hashmap_get_u64(map, id), i);
+        // The generic key API sees the same entries
+        EXPECT_EQ(vf_hashmap_has_key(map, &id), 1);
+    }
+    EXPECT_EQ(vf_hashmap_has_u64(map, 1), 0);
+
+    vf_hashmap_remove_u64(map, 0);
+    EXPECT_EQ(vf_hashmap_has_u64(map, 0), 0);
+    EXPECT_EQ(vf_hashmap_size(map), 999);
+
+    // Keys of the wrong size are rejected
+    int value = 1;
+    EXPECT_EQ(vf_hashmap_set(map, "string", &value), -1);
+
+    vf_hashmap_free(map);
+    return true;
+}
+
+TEST(Hashmap, BinaryKeys) {
+    typedef struct {
+        uint8_t bytes[16];
+    } guid_t;
+    typedef struct {
+        uint64_t parts[3];
+    } wide_key_t;
+
+    // 16 byte keys are stored inline
+    vf_hashmap_t* guids = vf_hashmap_create_keyed(sizeof(guid_t), sizeof(int));
+    // 24 byte keys go to the key arena
+    vf_hashmap_t* wide = vf_hashmap_create_keyed(sizeof(wide_key_t), sizeof(int));
+
+    for (int i = 0; i < 200; i++) {
+        guid_t guid;
+        memset(&guid, 0, sizeof(guid));
+        guid.bytes[0] = (uint8_t)i;
+        guid.bytes[15] = (uint8_t)(i >> 4);
+        EXPECT_EQ(vf_hashmap_set_key(guids, &guid, &i), 0);
+
+        wide_key_t key = {{(uint64_t)i, 0, (uint64_t)i * 3}};
+        EXPECT_EQ(vf_hashmap_set_key(wide, &key, &i), 0);
+    }
+
+    for (int i = 0; i < 200; i++) {
+        guid_t guid;
+        memset(&guid, 0, sizeof(guid));
+        guid.bytes[0] = (uint8_t)i;
+        guid.bytes[15] = (uint8_t)(i >> 4);
+        EXPECT_EQ(*(const int*)vf_hashmap_get_key(guids, &guid), i);
+
+        wide_key_t key = {{(uint64_t)i, 0, (uint64_t)i * 3}};
+        EXPECT_EQ(*(const int*)vf_hashmap_get_key(wide, &key), i);
+        key.parts[1] = 1;
+        EXPECT_EQ(vf_hashmap_has_key(wide, &key), 0);
+    }
+
+    vf_hashmap_free(guids);
+    vf_hashmap_free(wide);
+    return true;
+}
+
+#define SHARDED_TEST_THREADS 4
+#define SHARDED_TEST_KEYS 2000
+
+typedef struct {
+    vf_hashmap_sharded_t* map;
+    uint64_t first;
+    int failed;
+} sharded_test_args_t;
+
+// Each thread inserts its own key range, reads it back and removes every other key.
+static void* sharded_test_worker(void* arg) {
+    sharded_test_args_t* args = (sharded_test_args_t*)arg;
+    for (uint64_t k = args->first; k < args->first + SHARDED_TEST_KEYS; k++) {
+        uint64_t value = k * 7;
+        vf_hashmap_sharded_set_n(args->map, &k, sizeof(k), &value);
+    }
+    for (uint64_t k = args->first; k < args->first + SHARDED_TEST_KEYS; k++) {
+        uint64_t value = 0;
+        if (!vf_hashmap_sharded_get_n(args->map, &k, sizeof(k), &value) || value != k * 7) args->failed = 1;
+        if (k & 1) vf_hashmap_sharded_remove_n(args->map, &k, sizeof(k));
+    }
+    return NULL;
+}
+
+TEST(Hashmap, Sharded) {
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.key_size = sizeof(uint64_t);
+    config.value_size = sizeof(uint64_t);
+
+    // Rounded up to a power of two
+    vf_hashmap_sharded_t* map = vf_hashmap_sharded_create(&config, 5);
+    EXPECT_NE(map, NULL);
+    EXPECT_EQ(map->shard_count, 8);
+
+    vf_thread_t threads[SHARDED_TEST_THREADS];
+    sharded_test_args_t args[SHARDED_TEST_THREADS];
+    for (int t = 0; t < SHARDED_TEST_THREADS; t++) {
+        args[t].map = map;
+        args[t].first = (uint64_t)t * SHARDED_TEST_KEYS;
+        args[t].failed = 0;
+        EXPECT_EQ(vf_thread_create(&threads[t], sharded_test_worker, &args[t]), VF_THREAD_SUCCESS);
+    }
+    for (int t = 0; t < SHARDED_TEST_THREADS; t++) {
+        vf_thread_join(&threads[t]);
+        EXPECT_EQ(args[t].failed, 0);
+    }
+
+    EXPECT_EQ(vf_hashmap_sharded_size(map), SHARDED_TEST_THREADS * SHARDED_TEST_KEYS / 2);
+    for (uint64_t k = 0; k < SHARDED_TEST_THREADS * SHARDED_TEST_KEYS; k++) {
+        uint64_t value = 0;
+        EXPECT_EQ(vf_hashmap_sharded_get_n(map, &k, sizeof(k), &value), (int)!(k & 1));
+        if (!(k & 1)) {
+            EXPECT_EQ(value, k * 7);
+        }
+    }
+
+    // Wrong-sized keys are rejected rather than read past
+    uint32_t narrow = 1;
+    uint64_t value = 0;
+    EXPECT_EQ(vf_hashmap_sharded_set_n(map, &narrow, sizeof(narrow), &value), -1);
+
+    vf_hashmap_sharded_free(map);
+    return true;
+}
+
+typedef struct {
+    vf_hashmap_rcu_t* rcu;
+    volatile uint64_t* done;
+    int failed;
+} rcu_test_args_t;
+
+// Every published snapshot holds keys 0..n-1 with values key * 3, for a growing n.
+static void* rcu_test_reader(void* arg) {
+    rcu_test_args_t* args = (rcu_test_args_t*)arg;
+    size_t seen = 0;
+    while (!vf_atomic_load_u64(args->done)) {
+        vf_hashmap_rcu_reader_t reader;
+        vf_hashmap_t* snapshot = vf_hashmap_rcu_read_begin(args->rcu, &reader);
+        size_t size = vf_hashmap_size(snapshot);
+        if (size < seen) args->failed = 1;
+        seen = size;
+        for (uint64_t k = 0; k < size; k++) {
+            const uint64_t* value = (const uint64_t*)vf_hashmap_get_u64(snapshot, k);
+            if (!value || *value != k * 3) args->failed = 1;
+        }
+        vf_hashmap_rcu_read_end(args->rcu, &reader);
+    }
+    return NULL;
+}
+
+TEST(Hashmap, Rcu) {
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.key_size = sizeof(uint64_t);
+    config.value_size = sizeof(uint64_t);
+    vf_hashmap_rcu_t* rcu = vf_hashmap_rcu_create(&config);
+    EXPECT_NE(rcu, NULL);
+
+    volatile uint64_t done = 0;
+    vf_thread_t threads[3];
+    rcu_test_args_t args[3];
+    for (int t = 0; t < 3; t++) {
+        args[t].rcu = rcu;
+        args[t].done = &done;
+        args[t].failed = 0;
+        EXPECT_EQ(vf_thread_create(&threads[t], rcu_test_reader, &args[t]), VF_THREAD_SUCCESS);
+    }
+
+    // Single writes, then batches published in one go
+    for (uint64_t k = 0; k < 100; k++) {
+        uint64_t value = k * 3;
+        EXPECT_EQ(vf_hashmap_rcu_set_n(rcu, &k, sizeof(k), &value), 0);
+    }
+    for (uint64_t k = 100; k < 1000; k += 100) {
+        vf_hashmap_t* map = vf_hashmap_rcu_write_begin(rcu);
+        for (uint64_t i = k; i < k + 100; i++) {
+            uint64_t value = i * 3;
+            vf_hashmap_set_u64(map, i, &value);
+        }
+        vf_hashmap_rcu_write_commit(rcu, map);
+    }
+
+    vf_atomic_store_u64(&done, 1);
+    for (int t = 0; t < 3; t++) {
+        vf_thread_join(&threads[t]);
+        EXPECT_EQ(args[t].failed, 0);
+    }
+
+    uint64_t key = 999, value = 0;
+    EXPECT_EQ(vf_hashmap_rcu_get_n(rcu, &key, sizeof(key), &value), 1);
+    EXPECT_EQ(value, 999 * 3);
+    vf_hashmap_rcu_remove_n(rcu, &key, sizeof(key));
+    EXPECT_EQ(vf_hashmap_rcu_has_n(rcu, &key, sizeof(key)), 0);
+
+    // An aborted batch leaves the published table untouched
+    vf_hashmap_t* map = vf_hashmap_rcu_write_begin(rcu);
+    vf_hashmap_remove_u64(map, 0);
+    vf_hashmap_rcu_write_abort(rcu, map);
+    key = 0;
+    EXPECT_EQ(vf_hashmap_rcu_has_n(rcu, &key, sizeof(key)), 1);
+
+    vf_hashmap_rcu_free(rcu);
+    return true;
+}
+
+TEST(Hashmap, IncrementalResize) {
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(int);
+    config.incremental_resize = 1;
+    vf_hashmap_t* map = vf_hashmap_create_with_config(&config);
+
+    // Every other key is long enough to live in the key arena
+    char key[64];
+    int resizing_seen = 0;
+    for (int i = 0; i < 5000; i++) {
+        snprintf(key, sizeof(key), (i & 1) ? "incremental/long/key/%d" : "k%d", i);
+        EXPECT_EQ(vf_hashmap_set(map, key, &i), 0);
+        if (map->old_capacity) resizing_seen = 1;
+
+        // Keys stay reachable whichever table they are in right now
+        if (i / 2 > i / 3) {
+            snprintf(key, sizeof(key), (i / 2 & 1) ? "incremental/long/key/%d" : "k%d", i / 2);
+            EXPECT_EQ(*(const int*)vf_hashmap_get(map, key), i / 2);
+        }
+
+        // Removing and updating keys that may still sit in the old table
+        if (i % 3 == 0) {
+            snprintf(key, sizeof(key), (i / 3 & 1) ? "incremental/long/key/%d" : "k%d", i / 3);
+            vf_hashmap_remove(map, key);
+            EXPECT_EQ(vf_hashmap_has(map, key), 0);
+        }
+    }
+    EXPECT_NE(resizing_seen, 0);
+
+    vf_hashmap_t* copy = vf_hashmap_clone(map);
+    for (int i = 0; i < 5000; i++) {
+        snprintf(key, sizeof(key), (i & 1) ? "incremental/long/key/%d" : "k%d", i);
+        int removed = i <= 4999 / 3;
+        EXPECT_EQ(vf_hashmap_has(map, key), !removed);
+        EXPECT_EQ(vf_hashmap_has(copy, key), !removed);
+        if (!removed) {
+            EXPECT_EQ(*(const int*)vf_hashmap_get(copy, key), i);
+        }
+    }
+    EXPECT_EQ(vf_hashmap_size(map), 5000 - (4999 / 3 + 1));
+    EXPECT_EQ(vf_hashmap_size(copy), vf_hashmap_size(map));
+
+    vf_hashmap_free(copy);
+    vf_hashmap_free(map);
+    return true;
+}
+
+TEST(Hashmap, Reserve) {
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(int));
+    EXPECT_EQ(vf_hashmap_reserve(map, 1000), 0);
+    size_t capacity = vf_hashmap_capacity(map);
+    EXPECT_GT(capacity * VF_HASH_LOAD_FACTOR, 999);
+
+    // No resize happens while filling up to the reserved count
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "reserved%d", i);
+        vf_hashmap_set(map, key, &i);
+    }
+    EXPECT_EQ(vf_hashmap_capacity(map), capacity);
+
+    // Reserving less than what is there is a no-op
+    EXPECT_EQ(vf_hashmap_reserve(map, 10), 0);
+    EXPECT_EQ(vf_hashmap_capacity(map), capacity);
+
+    vf_hashmap_free(map);
+    return true;
+}
+
+#define BUILD_TEST_COUNT 3000
+
+TEST(Hashmap, Build) {
+    static char names[BUILD_TEST_COUNT][40];
+    const char* keys[BUILD_TEST_COUNT];
+    int values[BUILD_TEST_COUNT];
+    for (int i = 0; i < BUILD_TEST_COUNT; i++) {
+        // Short keys stay inline, long ones go to the arena
+        snprintf(names[i], sizeof(names[i]), (i & 1) ? "a/rather/long/built/key/%d" : "b%d", i);
+        keys[i] = names[i];
+        values[i] = i;
+    }
+    // A duplicate at the end overwrites the first value
+    keys[BUILD_TEST_COUNT - 1] = names[0];
+    values[BUILD_TEST_COUNT - 1] = -1;
+
+    vf_hashmap_t* expected = vf_hashmap_create(sizeof(int));
+    for (int i = 0; i < BUILD_TEST_COUNT; i++) {
+        vf_hashmap_set(expected, keys[i], &values[i]);
+    }
+
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(int);
+    vf_hashmap_t* built = vf_hashmap_build(&config, keys, NULL, values, BUILD_TEST_COUNT);
+
+    vf_threadpool_t* pool = vf_threadpool_create(3);
+    EXPECT_NE(pool, NULL);
+    vf_hashmap_t* parallel = vf_hashmap_build_parallel(&config, keys, NULL, values, BUILD_TEST_COUNT, pool);
+
+    EXPECT_NE(built, NULL);
+    EXPECT_NE(parallel, NULL);
+    EXPECT_EQ(vf_hashmap_size(built), vf_hashmap_size(expected));
+    EXPECT_EQ(vf_hashmap_size(parallel), vf_hashmap_size(expected));
+    for (int i = 0; i < BUILD_TEST_COUNT; i++) {
+        int value = *(const int*)vf_hashmap_get(expected, keys[i]);
+        EXPECT_EQ(*(const int*)vf_hashmap_get(built, keys[i]), value);
+        EXPECT_EQ(*(const int*)vf_hashmap_get(parallel, keys[i]), value);
+    }
+    EXPECT_EQ(*(const int*)vf_hashmap_get(built, names[0]), -1);
+
+    // Fixed-size keys, packed
+    uint64_t ids[BUILD_TEST_COUNT];
+    for (int i = 0; i < BUILD_TEST_COUNT; i++) {
+        ids[i] = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+    }
+    config.key_size = sizeof(uint64_t);
+    vf_hashmap_t* keyed = vf_hashmap_build_keyed_parallel(&config, ids, values, BUILD_TEST_COUNT, pool);
+    EXPECT_NE(keyed, NULL);
+    EXPECT_EQ(vf_hashmap_size(keyed), BUILD_TEST_COUNT);
+    for (int i = 0; i < BUILD_TEST_COUNT; i++) {
+        EXPECT_EQ(*(const int*)vf_hashmap_get_u64(keyed, ids[i]), values[i]);
+    }
+
+    // Keys of the wrong size fail the whole build, without being read past their end
+    EXPECT_EQ(vf_hashmap_build(&config, keys, NULL, values, BUILD_TEST_COUNT), NULL);
+    char* short_key = (char*)malloc(3);
+    memcpy(short_key, "ab", 3);
+    const char* short_keys[1] = { short_key };
+    EXPECT_EQ(vf_hashmap_build(&config, short_keys, NULL, values, 1), NULL);
+    free(short_key);
+
+    vf_threadpool_destroy(pool);
+    vf_hashmap_free(keyed);
+    vf_hashmap_free(parallel);
+    vf_hashmap_free(built);
+    vf_hashmap_free(expected);
+    return true;
+}
+
+TEST(Hashmap, Iterator) {
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(int);
+
+    // Walks the old table as well while an incremental resize is in progress
+    for (int incremental = 0; incremental < 2; incremental++) {
+        config.incremental_resize = incremental;
+        vf_hashmap_t* map = vf_hashmap_create_with_config(&config);
+
+        char key[48];
+        int expected_sum = 0;
+        for (int i = 0; i < 100; i++) {
+            snprintf(key, sizeof(key), (i & 1) ? "iterated/long/key/number/%d" : "it%d", i);
+            vf_hashmap_set(map, key, &i);
+            expected_sum += i;
+        }
+
+        int count = 0, sum = 0;
+        vf_hashmap_iter_t it = vf_hashmap_iter(map);
+        while (vf_hashmap_next(&it)) {
+            EXPECT_EQ(strlen((const char*)it.key), it.key_length);
+            EXPECT_EQ(*(const int*)vf_hashmap_get_n(map, (const char*)it.key, it.key_length), *(int*)it.value);
+            sum += *(int*)it.value;
+            // Values can be changed in place
+            *(int*)it.value = -1;
+            count++;
+        }
+        EXPECT_EQ(count, 100);
+        EXPECT_EQ(sum, expected_sum);
+        EXPECT_EQ(*(const int*)vf_hashmap_get(map, "it42"), -1);
+        EXPECT_EQ(vf_hashmap_next(&it), 0);
+
+        vf_hashmap_free(map);
+    }
+
+    vf_hashmap_t* empty = vf_hashmap_create(sizeof(int));
+    vf_hashmap_iter_t it = vf_hashmap_iter(empty);
+    EXPECT_EQ(vf_hashmap_next(&it), 0);
+    vf_hashmap_free(empty);
+    return true;
+}
+
+TEST(Hashmap, GetBatch) {
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(int));
+    static char names[200][40];
+    const char* keys[200];
+    for (int i = 0; i < 200; i++) {
+        snprintf(names[i], sizeof(names[i]), (i & 1) ? "batched/long/key/number/%d" : "batch%d", i);
+        keys[i] = names[i];
+        // Only the first half is inserted
+        if (i < 100) vf_hashmap_set(map, names[i], &i);
+    }
+
+    const void* out[200];
+    EXPECT_EQ(vf_hashmap_get_batch(map, keys, NULL, 200, out), 100);
+    for (int i = 0; i < 200; i++) {
+        if (i < 100) {
+            EXPECT_EQ(*(const int*)out[i], i);
+        } else {
+            EXPECT_EQ(out[i], NULL);
+        }
+    }
+
+    vf_hashmap_t* ids = vf_hashmap_create_keyed(sizeof(uint64_t), sizeof(int));
+    uint64_t packed[100];
+    for (int i = 0; i < 100; i++) {
+        packed[i] = (uint64_t)i * 977;
+        if (i % 3) vf_hashmap_set_u64(ids, packed[i], &i);
+    }
+    EXPECT_EQ(vf_hashmap_get_batch_keyed(ids, packed, 100, out), 66);
+    for (int i = 0; i < 100; i++) {
+        if (i % 3) {
+            EXPECT_EQ(*(const int*)out[i], i);
+        } else {
+            EXPECT_EQ(out[i], NULL);
+        }
+    }
+
+    // Keys of the wrong size are misses, and aren't read past their end
+    char* short_key = (char*)malloc(3);
+    memcpy(short_key, "ab", 3);
+    const char* mixed[2] = { short_key, (const char*)&packed[1] };
+    size_t mixed_lengths[2] = { 2, sizeof(uint64_t) };
+    EXPECT_EQ(vf_hashmap_get_batch(ids, mixed, mixed_lengths, 2, out), 1);
+    EXPECT_EQ(out[0], NULL);
+    EXPECT_EQ(*(const int*)out[1], 1);
+    free(short_key);
+
+    vf_hashmap_free(ids);
+    vf_hashmap_free(map);
+    return true;
+}
+
+// Whether the file at `path` contains the zero terminated `text`.
+static int file_contains(const char* path, const char* text) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+    fseek(file, 0, SEEK_END);
+    size_t size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* bytes = (char*)malloc(size ? size : 1);
+    size_t read = fread(bytes, 1, size, file);
+    fclose(file);
+
+    size_t length = strlen(text);
+    int found = 0;
+    for (size_t i = 0; !found && i + length <= read; i++) found = memcmp(bytes + i, text, length) == 0;
+    free(bytes);
+    return found;
+}
+
+TEST(Hashmap, SaveAndMap) {
+    const char* path = "test_vf_hashmap.map";
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(int);
+    config.seed = 1234;
+    config.incremental_resize = 1;
+    vf_hashmap_t* map = vf_hashmap_create_with_config(&config);
+
+    char key[64];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), (i & 1) ? "saved/long/key/number/%d" : "saved%d", i);
+        vf_hashmap_set(map, key, &i);
+    }
+    // Leaves garbage in the key arena and, most likely, a resize in progress
+    for (int i = 1; i < 1000; i += 4) {
+        snprintf(key, sizeof(key), "saved/long/key/number/%d", i);
+        vf_hashmap_remove(map, key);
+    }
+    // A removed short key, kept inline in its entry, must not reach the file
+    int secret = 7;
+    vf_hashmap_set(map, "SECRETPW", &secret);
+    vf_hashmap_remove(map, "SECRETPW");
+    EXPECT_EQ(vf_hashmap_save(map, path), 0);
+    vf_hashmap_free(map);
+
+    vf_hashmap_t* mapped = vf_hashmap_open_mmap(path, NULL);
+    EXPECT_NE(mapped, NULL);
+    EXPECT_EQ(vf_hashmap_size(mapped), 750);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), (i & 1) ? "saved/long/key/number/%d" : "saved%d", i);
+        if (i % 4 == 1) {
+            EXPECT_EQ(vf_hashmap_has(mapped, key), 0);
+        } else {
+            EXPECT_EQ(*(const int*)vf_hashmap_get(mapped, key), i);
+        }
+    }
+    size_t count = 0;
+    vf_hashmap_iter_t it = vf_hashmap_iter(mapped);
+    while (vf_hashmap_next(&it)) {
+        EXPECT_EQ(it.value, NULL);
+        EXPECT_NE(vf_hashmap_get_n(mapped, (const char*)it.key, it.key_length), NULL);
+        count++;
+    }
+    EXPECT_EQ(count, 750);
+
+    // Empty slots are saved as zeros, not whatever the heap held
+    for (size_t i = 0; i < mapped->capacity; i++) {
+        if (!mapped->entries[i].used) EXPECT_EQ(*(const int*)(mapped->values + i * sizeof(int)), 0);
+    }
+
+    // ... and so are the entries of removed keys
+    EXPECT_EQ(file_contains(path, "SECRETPW"), 0);
+
+    // Mapped maps are read-only
+    int value = -1;
+    EXPECT_EQ(vf_hashmap_set(mapped, "saved0", &value), -1);
+    EXPECT_EQ(vf_hashmap_get_mutable(mapped, "saved0"), NULL);
+    vf_hashmap_remove(mapped, "saved0");
+    EXPECT_EQ(vf_hashmap_size(mapped), 750);
+
+    // ... but their clones are not
+    vf_hashmap_t* copy = vf_hashmap_clone(mapped);
+    EXPECT_EQ(vf_hashmap_set(copy, "saved/long/key/number/1", &value), 0);
+    EXPECT_EQ(*(const int*)vf_hashmap_get(copy, "saved/long/key/number/1"), -1);
+    EXPECT_EQ(*(const int*)vf_hashmap_get(mapped, "saved2"), 2);
+    vf_hashmap_free(copy);
+    vf_hashmap_free(mapped);
+
+    // A different hash function is caught by the header check
+    EXPECT_EQ(vf_hashmap_open_mmap(path, constant_hash), NULL);
+
+    // So is a truncated file
+    FILE* file = fopen(path, "r+b");
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fclose(file);
+    char* bytes = (char*)malloc((size_t)length);
+    file = fopen(path, "rb");
+    EXPECT_EQ(fread(bytes, 1, (size_t)length, file), (size_t)length);
+    fclose(file);
+    file = fopen(path, "wb");
+    fwrite(bytes, 1, (size_t)length - 1, file);
+    fclose(file);
+    free(bytes);
+    EXPECT_EQ(vf_hashmap_open_mmap(path, NULL), NULL);
+
+    // Arena keys taking over the slots of removed inline keys only set an
+    // offset, which must not leave the rest of the old key in the file
+    vf_hashmap_t* reused = vf_hashmap_create(sizeof(int));
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "ZZSECRET%08d", i);
+        vf_hashmap_set(reused, key, &i);
+    }
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "ZZSECRET%08d", i);
+        vf_hashmap_remove(reused, key);
+    }
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "saved/long/key/number/%d", i);
+        vf_hashmap_set(reused, key, &i);
+    }
+    EXPECT_EQ(vf_hashmap_save(reused, path), 0);
+    vf_hashmap_free(reused);
+    int leaked = 0;
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "%08d", i);
+        leaked |= file_contains(path, key);
+    }
+    EXPECT_EQ(leaked, 0);
+
+    // Fixed-size keys
+    vf_hashmap_t* ids = vf_hashmap_create_keyed(sizeof(uint64_t), sizeof(int));
+    for (int i = 0; i < 500; i++) {
+        vf_hashmap_set_u64(ids, (uint64_t)i * 7919, &i);
+    }
+    EXPECT_EQ(vf_hashmap_save(ids, path), 0);
+    vf_hashmap_free(ids);
+    ids = vf_hashmap_open_mmap(path, NULL);
+    EXPECT_NE(ids, NULL);
+    for (int i = 0; i < 500; i++) {
+        EXPECT_EQ(*(const int*)vf_hashmap_get_u64(ids, (uint64_t)i * 7919), i);
+    }
+    EXPECT_EQ(vf_hashmap_has_u64(ids, 1), 0);
+    vf_hashmap_free(ids);
+
+    EXPECT_EQ(vf_hashmap_open_mmap("test_vf_hashmap.missing", NULL), NULL);
+    remove(path);
+    return true;
+}
+
+TEST(Hashmap, Freeze) {
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(int));
+    char key[64];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, sizeof(key), (i & 1) ? "frozen/long/key/number/%d" : "frozen%d", i);
+        vf_hashmap_set(map, key, &i);
+    }
+    for (int i = 0; i < 2000; i += 3) {
+        snprintf(key, sizeof(key), (i & 1) ? "frozen/long/key/number/%d" : "frozen%d", i);
+        vf_hashmap_remove(map, key);
+    }
+
+    vf_hashmap_frozen_t* frozen = vf_hashmap_freeze(map);
+    EXPECT_NE(frozen, NULL);
+    EXPECT_EQ(vf_hashmap_frozen_size(frozen), vf_hashmap_size(map));
+    // Minimal up to the ~1% of slots left free
+    EXPECT_TRUE(frozen->slot_count <= vf_hashmap_size(map) / VF_HASH_FROZEN_LOAD + 1);
+    // The source map can go away
+    vf_hashmap_free(map);
+
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, sizeof(key), (i & 1) ? "frozen/long/key/number/%d" : "frozen%d", i);
+        if (i % 3 == 0) {
+            EXPECT_EQ(vf_hashmap_frozen_get(frozen, key), NULL);
+            EXPECT_EQ(vf_hashmap_frozen_has(frozen, key), 0);
+        } else {
+            EXPECT_EQ(*(const int*)vf_hashmap_frozen_get(frozen, key), i);
+            EXPECT_EQ(vf_hashmap_frozen_has_n(frozen, key, strlen(key)), 1);
+        }
+    }
+    EXPECT_EQ(vf_hashmap_frozen_has(frozen, "missing"), 0);
+    vf_hashmap_frozen_free(frozen);
+
+    vf_hashmap_t* ids = vf_hashmap_create_keyed(sizeof(uint64_t), sizeof(uint64_t));
+    for (uint64_t i = 0; i < 5000; i++) {
+        uint64_t value = i * 3;
+        vf_hashmap_set_u64(ids, i * 0x9E3779B97F4A7C15ULL, &value);
+    }
+    frozen = vf_hashmap_freeze(ids);
+    for (uint64_t i = 0; i < 5000; i++) {
+        EXPECT_EQ(*(const uint64_t*)vf_hashmap_frozen_get_u64(frozen, i * 0x9E3779B97F4A7C15ULL), i * 3);
+    }
+    EXPECT_EQ(vf_hashmap_frozen_has_u64(frozen, 1), 0);
+    vf_hashmap_frozen_free(frozen);
+    vf_hashmap_free(ids);
+
+    vf_hashmap_t* empty = vf_hashmap_create(sizeof(int));
+    frozen = vf_hashmap_freeze(empty);
+    EXPECT_EQ(vf_hashmap_frozen_size(frozen), 0);
+    EXPECT_EQ(vf_hashmap_frozen_get(frozen, "anything"), NULL);
+    vf_hashmap_frozen_free(frozen);
+    vf_hashmap_free(empty);
+
+    // FNV-1a mixes its high bits poorly; sequential keys still get placed
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(int);
+    config.hash_fn = vf_hashmap_hash_fnv1a;
+    vf_hashmap_t* fnv = vf_hashmap_create_with_config(&config);
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        vf_hashmap_set(fnv, key, &i);
+    }
+    frozen = vf_hashmap_freeze(fnv);
+    EXPECT_NE(frozen, NULL);
+    for (int i = 0; frozen && i < 2000; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        EXPECT_EQ(*(const int*)vf_hashmap_frozen_get(frozen, key), i);
+    }
+    if (frozen) vf_hashmap_frozen_free(frozen);
+    vf_hashmap_free(fnv);
+
+    // Keys with the same full hash can't be given slots of their own
+    config.hash_fn = constant_hash;
+    vf_hashmap_t* colliding = vf_hashmap_create_with_config(&config);
+    int value = 1;
+    vf_hashmap_set(colliding, "a", &value);
+    vf_hashmap_set(colliding, "b", &value);
+    EXPECT_EQ(vf_hashmap_freeze(colliding), NULL);
+    vf_hashmap_free(colliding);
+    return true;
+}
+
+TEST(Hashmap, Stats) {
+    vf_hashmap_t* map = vf_hashmap_create(sizeof(int));
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "stats%d", i);
+        vf_hashmap_set(map, key, &i);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        snprintf(key, sizeof(key), "stats%d", i);
+        vf_hashmap_remove(map, key);
+    }
+
+    vf_hashmap_stats_t stats = vf_hashmap_stats(map);
+    EXPECT_EQ(stats.size, 500);
+    EXPECT_EQ(stats.capacity, vf_hashmap_capacity(map));
+    size_t counted = 0;
+    for (int i = 0; i < VF_HASH_STATS_BUCKETS; i++) counted += stats.histogram[i];
+    EXPECT_EQ(counted, 500);
+    size_t last = (stats.max_displacement < VF_HASH_STATS_BUCKETS) ? stats.max_displacement : VF_HASH_STATS_BUCKETS - 1;
+    EXPECT_NE(stats.histogram[last], 0);
+    EXPECT_TRUE(stats.mean_displacement <= (double)stats.max_displacement);
+
+#ifdef VF_HASHMAP_ROBIN_HOOD
+    // Along each chain, no entry is more than one slot further from home than the one before
+    size_t mask = map->capacity - 1;
+    for (size_t i = 0; i < map->capacity; i++) {
+        size_t next = (i + 1) & mask;
+        if (!map->entries[i].used || !map->entries[next].used) continue;
+        size_t here = (i - (size_t)(map->entries[i].hash & mask)) & mask;
+        size_t there = (next - (size_t)(map->entries[next].hash & mask)) & mask;
+        EXPECT_TRUE(there <= here + 1);
+    }
+#endif
+    vf_hashmap_free(map);
+
+#ifndef VF_HASHMAP_SWISS_TABLE
+    // With every key on the same home slot, the chain holds them all
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = sizeof(int);
+    config.hash_fn = constant_hash;
+    vf_hashmap_t* chained = vf_hashmap_create_with_config(&config);
+    for (int i = 0; i < 10; i++) {
+        snprintf(key, sizeof(key), "chained%d", i);
+        vf_hashmap_set(chained, key, &i);
+    }
+    stats = vf_hashmap_stats(chained);
+    EXPECT_EQ(stats.max_displacement, 9);
+    EXPECT_TRUE(stats.mean_displacement == 4.5);
+    vf_hashmap_free(chained);
+#endif
+    return true;
+}
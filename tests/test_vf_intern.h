@@ -0,0 +1,156 @@
+#include "../vf_test.h"
+
+#define VF_THREAD_IMPLEMENTATION
+#define VF_HASHMAP_IMPLEMENTATION
+#define VF_INTERN_ENABLE_CONCURRENT
+#define VF_INTERN_IMPLEMENTATION
+#include "../vf_intern.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+TEST(Intern, Basic) {
+    vf_intern_t* table = vf_intern_create(0);
+    EXPECT_NE(table, NULL);
+    EXPECT_EQ(vf_intern_count(table), 0);
+
+    // Ids are dense and handed out in order
+    EXPECT_EQ(vf_intern(table, "apple"), 0);
+    EXPECT_EQ(vf_intern(table, "banana"), 1);
+    EXPECT_EQ(vf_intern(table, "apple"), 0);
+    EXPECT_EQ(vf_intern_count(table), 2);
+
+    EXPECT_EQ(strcmp(vf_intern_string(table, 0), "apple"), 0);
+    EXPECT_EQ(vf_intern_length(table, 1), 6);
+    EXPECT_EQ(vf_intern_string(table, 2), NULL);
+
+    // Find never adds
+    EXPECT_EQ(vf_intern_find(table, "banana"), 1);
+    EXPECT_EQ(vf_intern_find(table, "cherry"), VF_INTERN_INVALID);
+    EXPECT_EQ(vf_intern_count(table), 2);
+
+    // Strings with a length don't need to be terminated, but their copies are
+    const char* path = "metrics/cpu/load";
+    uint32_t prefix = vf_intern_n(table, path, 7);
+    EXPECT_EQ(strcmp(vf_intern_string(table, prefix), "metrics"), 0);
+    EXPECT_EQ(vf_intern_find_n(table, "metrics/", 7), prefix);
+    EXPECT_NE(vf_intern(table, path), prefix);
+
+    // The empty string is a string like any other
+    uint32_t empty = vf_intern(table, "");
+    EXPECT_EQ(vf_intern(table, ""), empty);
+    EXPECT_EQ(vf_intern_length(table, empty), 0);
+
+    vf_intern_free(table);
+    return true;
+}
+
+TEST(Intern, ManyStrings) {
+    vf_intern_t* table = vf_intern_create(0);
+    const char* first = vf_intern_string(table, vf_intern(table, "first"));
+
+    char buffer[64];
+    for (int i = 0; i < 100000; i++) {
+        snprintf(buffer, sizeof(buffer), "/data/assets/%d.bin", i);
+        EXPECT_EQ(vf_intern(table, buffer), (uint32_t)i + 1);
+    }
+    // A string longer than an arena block
+    size_t long_length = VF_INTERN_BLOCK_SIZE * 2;
+    char* long_string = (char*)malloc(long_length + 1);
+    memset(long_string, 'x', long_length);
+    long_string[long_length] = '\0';
+    uint32_t long_id = vf_intern(table, long_string);
+    EXPECT_EQ(long_id, 100001);
+
+    for (int i = 0; i < 100000; i++) {
+        snprintf(buffer, sizeof(buffer), "/data/assets/%d.bin", i);
+        EXPECT_EQ(vf_intern_find(table, buffer), (uint32_t)i + 1);
+        EXPECT_EQ(strcmp(vf_intern_string(table, (uint32_t)i + 1), buffer), 0);
+    }
+    EXPECT_EQ(strcmp(vf_intern_string(table, long_id), long_string), 0);
+    // Interned strings never move
+    EXPECT_EQ(vf_intern_string(table, 0), first);
+
+    vf_intern_memory_t memory = vf_intern_memory(table);
+    EXPECT_EQ(memory.count, 100002);
+    EXPECT_TRUE(memory.string_bytes > long_length);
+    EXPECT_TRUE(memory.arena_bytes >= memory.string_bytes);
+    EXPECT_TRUE(memory.index_bytes >= memory.count * sizeof(vf_intern_slot_t));
+    EXPECT_TRUE(memory.id_table_bytes >= memory.count * sizeof(const char*));
+    EXPECT_EQ(memory.total_bytes, sizeof(vf_intern_t) + memory.arena_bytes + memory.index_bytes + memory.id_table_bytes);
+
+    free(long_string);
+    vf_intern_free(table);
+    return true;
+}
+
+TEST(Intern, Full) {
+    vf_intern_t* table = vf_intern_create(3);
+    EXPECT_EQ(vf_intern(table, "a"), 0);
+    EXPECT_EQ(vf_intern(table, "b"), 1);
+    EXPECT_EQ(vf_intern(table, "c"), 2);
+    EXPECT_EQ(vf_intern(table, "d"), VF_INTERN_INVALID);
+    // Strings already in still resolve
+    EXPECT_EQ(vf_intern(table, "b"), 1);
+    EXPECT_EQ(vf_intern_count(table), 3);
+    vf_intern_free(table);
+    return true;
+}
+
+#define INTERN_TEST_THREADS 4
+#define INTERN_TEST_STRINGS 20000
+
+typedef struct {
+    vf_intern_t* table;
+    int thread;
+    uint32_t ids[INTERN_TEST_STRINGS];
+} intern_test_args_t;
+
+// Every thread interns the same strings, starting at a different point.
+static void* intern_test_worker(void* arg) {
+    intern_test_args_t* args = (intern_test_args_t*)arg;
+    char buffer[64];
+    for (int n = 0; n < INTERN_TEST_STRINGS; n++) {
+        int i = (n + args->thread * INTERN_TEST_STRINGS / INTERN_TEST_THREADS) % INTERN_TEST_STRINGS;
+        snprintf(buffer, sizeof(buffer), "service.%d.latency_ms", i);
+        args->ids[i] = vf_intern(args->table, buffer);
+    }
+    return NULL;
+}
+
+TEST(Intern, Concurrent) {
+    vf_intern_t* table = vf_intern_create(0);
+    intern_test_args_t* args = (intern_test_args_t*)malloc(INTERN_TEST_THREADS * sizeof(intern_test_args_t));
+    vf_thread_t threads[INTERN_TEST_THREADS];
+    for (int t = 0; t < INTERN_TEST_THREADS; t++) {
+        args[t].table = table;
+        args[t].thread = t;
+        EXPECT_EQ(vf_thread_create(&threads[t], intern_test_worker, &args[t]), VF_THREAD_SUCCESS);
+    }
+    for (int t = 0; t < INTERN_TEST_THREADS; t++) {
+        vf_thread_join(&threads[t]);
+    }
+
+    // Each string got exactly one id, and the ids are 0..n-1
+    EXPECT_EQ(vf_intern_count(table), INTERN_TEST_STRINGS);
+    char* seen = (char*)calloc(INTERN_TEST_STRINGS, 1);
+    char buffer[64];
+    for (int i = 0; i < INTERN_TEST_STRINGS; i++) {
+        uint32_t id = args[0].ids[i];
+        for (int t = 1; t < INTERN_TEST_THREADS; t++) {
+            EXPECT_EQ(args[t].ids[i], id);
+        }
+        EXPECT_TRUE(id < INTERN_TEST_STRINGS);
+        EXPECT_EQ(seen[id], 0);
+        seen[id] = 1;
+        snprintf(buffer, sizeof(buffer), "service.%d.latency_ms", i);
+        EXPECT_EQ(strcmp(vf_intern_string(table, id), buffer), 0);
+    }
+
+    free(seen);
+    free(args);
+    vf_intern_free(table);
+    return true;
+}
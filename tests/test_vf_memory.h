@@ -0,0 +1,150 @@
+#include "../vf_test.h"
+
+#define VF_MEM_IMPLEMENTATION
+#include "../vf_memory.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEM_TEST_SIZE 1024
+
+static const vf_mem_kernel_t mem_test_kernels[] = {VF_MEM_KERNEL_WORD, VF_MEM_KERNEL_SSE2, VF_MEM_KERNEL_AVX2};
+
+static void mem_test_fill(uint8_t* buffer, size_t size, uint8_t seed) {
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = (uint8_t)(seed + i * 31);
+    }
+}
+
+TEST(Memory, Kernels) {
+    EXPECT_TRUE(vf_mem_kernel_supported(VF_MEM_KERNEL_WORD));
+    // The first call picks the widest supported kernel
+    vf_mem_kernel_t best = vf_mem_get_kernel();
+    EXPECT_TRUE(vf_mem_kernel_supported(best));
+    if (best < VF_MEM_KERNEL_AVX2) {
+        EXPECT_FALSE(vf_mem_kernel_supported((vf_mem_kernel_t)(best + 1)));
+        EXPECT_FALSE(vf_mem_set_kernel((vf_mem_kernel_t)(best + 1)));
+        EXPECT_EQ(vf_mem_get_kernel(), best);
+    }
+    EXPECT_TRUE(vf_mem_set_kernel(VF_MEM_KERNEL_WORD));
+    EXPECT_EQ(vf_mem_get_kernel(), VF_MEM_KERNEL_WORD);
+    vf_mem_set_kernel(best);
+    return true;
+}
+
+// Every size up to a few vectors, at every alignment of both sides, with
+// guard bytes around the destination.
+TEST(Memory, Copy) {
+    uint8_t* src = (uint8_t*)malloc(MEM_TEST_SIZE);
+    uint8_t* dst = (uint8_t*)malloc(MEM_TEST_SIZE);
+    uint8_t* expected = (uint8_t*)malloc(MEM_TEST_SIZE);
+    vf_mem_kernel_t best = vf_mem_get_kernel();
+
+    for (size_t k = 0; k < sizeof(mem_test_kernels) / sizeof(mem_test_kernels[0]); k++) {
+        if (!vf_mem_set_kernel(mem_test_kernels[k])) continue;
+        for (size_t size = 0; size <= 300; size++) {
+            for (size_t dst_offset = 0; dst_offset < 32; dst_offset += 3) {
+                size_t src_offset = (size * 7) % 32;
+                mem_test_fill(src, MEM_TEST_SIZE, (uint8_t)size);
+                memset(dst, 0xEE, MEM_TEST_SIZE);
+                memcpy(expected, dst, MEM_TEST_SIZE);
+                memcpy(expected + dst_offset, src + src_offset, size);
+
+                EXPECT_EQ(vf_memcpy(dst + dst_offset, src + src_offset, size), dst + dst_offset);
+                EXPECT_EQ(memcmp(dst, expected, MEM_TEST_SIZE), 0);
+            }
+        }
+    }
+
+    vf_mem_set_kernel(best);
+    free(src);
+    free(dst);
+    free(expected);
+    return true;
+}
+
+TEST(Memory, Set) {
+    uint8_t* dst = (uint8_t*)malloc(MEM_TEST_SIZE);
+    uint8_t* expected = (uint8_t*)malloc(MEM_TEST_SIZE);
+    vf_mem_kernel_t best = vf_mem_get_kernel();
+
+    for (size_t k = 0; k < sizeof(mem_test_kernels) / sizeof(mem_test_kernels[0]); k++) {
+        if (!vf_mem_set_kernel(mem_test_kernels[k])) continue;
+        for (size_t size = 0; size <= 300; size++) {
+            for (size_t offset = 0; offset < 32; offset += 3) {
+                // Only the low byte of the value counts
+                int value = 0x100 | (int)(size & 0xFF);
+                memset(dst, 0xEE, MEM_TEST_SIZE);
+                memcpy(expected, dst, MEM_TEST_SIZE);
+                memset(expected + offset, value, size);
+
+                EXPECT_EQ(vf_memset(dst + offset, value, size), dst + offset);
+                EXPECT_EQ(memcmp(dst, expected, MEM_TEST_SIZE), 0);
+            }
+        }
+    }
+
+    vf_mem_set_kernel(best);
+    free(dst);
+    free(expected);
+    return true;
+}
+
+TEST(Memory, Swap) {
+    uint8_t* buffer = (uint8_t*)malloc(MEM_TEST_SIZE);
+    uint8_t* expected = (uint8_t*)malloc(MEM_TEST_SIZE);
+    vf_mem_kernel_t best = vf_mem_get_kernel();
+
+    for (size_t k = 0; k < sizeof(mem_test_kernels) / sizeof(mem_test_kernels[0]); k++) {
+        if (!vf_mem_set_kernel(mem_test_kernels[k])) continue;
+        for (size_t size = 0; size <= 300; size++) {
+            for (size_t a_offset = 0; a_offset < 32; a_offset += 5) {
+                uint8_t* a = buffer + a_offset;
+                uint8_t* b = buffer + 512 + (size * 3) % 32;
+                mem_test_fill(buffer, MEM_TEST_SIZE, (uint8_t)(size + a_offset));
+                memcpy(expected, buffer, MEM_TEST_SIZE);
+                memcpy(expected + (a - buffer), b, size);
+                memcpy(expected + (b - buffer), a, size);
+
+                vf_memswap(a, b, size);
+                EXPECT_EQ(memcmp(buffer, expected, MEM_TEST_SIZE), 0);
+            }
+        }
+    }
+
+    vf_mem_set_kernel(best);
+    free(buffer);
+    free(expected);
+    return true;
+}
+
+// Big enough to take the non-temporal store path.
+TEST(Memory, Large) {
+    size_t size = VF_MEM_STREAM_THRESHOLD + 4099;
+    uint8_t* src = (uint8_t*)malloc(size + 64);
+    uint8_t* dst = (uint8_t*)malloc(size + 64);
+    vf_mem_kernel_t best = vf_mem_get_kernel();
+
+    for (size_t k = 0; k < sizeof(mem_test_kernels) / sizeof(mem_test_kernels[0]); k++) {
+        if (!vf_mem_set_kernel(mem_test_kernels[k])) continue;
+        mem_test_fill(src, size + 64, (uint8_t)k);
+        vf_memcpy(dst + 5, src + 17, size);
+        EXPECT_EQ(memcmp(dst + 5, src + 17, size), 0);
+
+        vf_memset(dst + 3, 0x5A, size);
+        EXPECT_EQ(dst[3], 0x5A);
+        EXPECT_EQ(dst[3 + size - 1], 0x5A);
+        EXPECT_EQ(dst[3 + size / 2], 0x5A);
+
+        vf_memswap(dst + 3, src + 9, size);
+        EXPECT_EQ(src[9 + size / 3], 0x5A);
+        EXPECT_EQ(dst[3 + size - 1], (uint8_t)(k + (size + 8) * 31));
+    }
+
+    vf_mem_set_kernel(best);
+    free(src);
+    free(dst);
+    return true;
+}
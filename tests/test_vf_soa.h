@@ -0,0 +1,141 @@
+#include "../vf_test.h"
+
+#define VF_SOA_IMPLEMENTATION
+#include "../vf_soa.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+    float x;
+    double mass;
+    uint8_t flags;
+    uint32_t id;
+} test_soa_body_t;
+
+static const vf_soa_field_t test_soa_fields[] = {
+    VF_SOA_FIELD(test_soa_body_t, x),
+    VF_SOA_FIELD(test_soa_body_t, mass),
+    VF_SOA_FIELD(test_soa_body_t, flags),
+    VF_SOA_FIELD(test_soa_body_t, id),
+};
+
+static bool test_soa_aligned(const vf_soa_t* soa) {
+    for (size_t c = 0; c < soa->column_count; ++c) {
+        if ((uintptr_t)vf_soa_column(soa, c) % VF_SOA_ALIGNMENT != 0) return false;
+    }
+    return true;
+}
+
+TEST(StructOfArrays, Push) {
+    vf_soa_t* soa = vf_soa_create(test_soa_fields, 4, 0);
+    EXPECT_NE(soa, NULL);
+    EXPECT_EQ(vf_soa_count(soa), 0);
+    EXPECT_EQ(vf_soa_stride(soa, 1), sizeof(double));
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        test_soa_body_t body = { (float)i, i * 0.5, (uint8_t)(i & 0xFF), i + 7 };
+        EXPECT_TRUE(vf_soa_push_struct(soa, &body));
+        EXPECT_TRUE(test_soa_aligned(soa));
+    }
+    EXPECT_EQ(vf_soa_count(soa), 1000);
+    EXPECT_TRUE(vf_soa_capacity(soa) >= 1000);
+
+    // Columns are plain arrays
+    float* x = (float*)vf_soa_column(soa, 0);
+    double* mass = (double*)vf_soa_column(soa, 1);
+    uint32_t* id = (uint32_t*)vf_soa_column(soa, 3);
+    for (uint32_t i = 0; i < 1000; i++) {
+        EXPECT_EQ(x[i], (float)i);
+        EXPECT_EQ(mass[i], i * 0.5);
+        EXPECT_EQ(id[i], i + 7);
+    }
+
+    test_soa_body_t body;
+    vf_soa_get_struct(soa, 300, &body);
+    EXPECT_EQ(body.x, 300.0f);
+    EXPECT_EQ(body.flags, 300 & 0xFF);
+    EXPECT_EQ(body.id, 307);
+
+    // One pointer per column; NULL zeroes the field
+    float nx = 1.5f;
+    uint32_t nid = 42;
+    const void* values[] = { &nx, NULL, NULL, &nid };
+    EXPECT_TRUE(vf_soa_push(soa, values));
+    vf_soa_get_struct(soa, 1000, &body);
+    EXPECT_EQ(body.x, 1.5f);
+    EXPECT_EQ(body.mass, 0.0);
+    EXPECT_EQ(body.id, 42);
+
+    vf_soa_free(soa);
+    return true;
+}
+
+TEST(StructOfArrays, RemoveSwap) {
+    vf_soa_t* soa = vf_soa_create(test_soa_fields, 4, 8);
+    EXPECT_EQ(vf_soa_capacity(soa), 8);
+    for (uint32_t i = 0; i < 5; i++) {
+        test_soa_body_t body = { (float)i, (double)i, (uint8_t)i, i };
+        vf_soa_push_struct(soa, &body);
+    }
+
+    // The last row moves into the hole, in every column
+    vf_soa_remove_swap(soa, 1);
+    EXPECT_EQ(vf_soa_count(soa), 4);
+    test_soa_body_t body;
+    vf_soa_get_struct(soa, 1, &body);
+    EXPECT_EQ(body.x, 4.0f);
+    EXPECT_EQ(body.mass, 4.0);
+    EXPECT_EQ(body.flags, 4);
+    EXPECT_EQ(body.id, 4);
+
+    vf_soa_remove_swap(soa, 3);
+    vf_soa_remove_swap(soa, 10);
+    EXPECT_EQ(vf_soa_count(soa), 3);
+    // Rows past the count read as zero
+    EXPECT_EQ(((uint32_t*)vf_soa_column(soa, 3))[3], 0);
+    EXPECT_EQ(((uint32_t*)vf_soa_column(soa, 3))[4], 0);
+
+    vf_soa_free(soa);
+    return true;
+}
+
+TEST(StructOfArrays, Resize) {
+    vf_soa_t* soa = vf_soa_create(test_soa_fields, 4, 0);
+    EXPECT_TRUE(vf_soa_resize(soa, 100));
+    EXPECT_EQ(vf_soa_count(soa), 100);
+    EXPECT_TRUE(test_soa_aligned(soa));
+
+    double* mass = (double*)vf_soa_column(soa, 1);
+    for (size_t i = 0; i < 100; i++) {
+        EXPECT_EQ(mass[i], 0.0);
+        mass[i] = (double)i;
+    }
+
+    // Shrinking and growing again brings back zeroed rows
+    EXPECT_TRUE(vf_soa_resize(soa, 10));
+    EXPECT_TRUE(vf_soa_resize(soa, 50));
+    mass = (double*)vf_soa_column(soa, 1);
+    EXPECT_EQ(mass[9], 9.0);
+    EXPECT_EQ(mass[10], 0.0);
+    EXPECT_EQ(mass[49], 0.0);
+
+    // Growing keeps the rows and the alignment
+    EXPECT_TRUE(vf_soa_reserve(soa, 5000));
+    EXPECT_EQ(vf_soa_capacity(soa), 5000);
+    EXPECT_TRUE(test_soa_aligned(soa));
+    EXPECT_EQ(((double*)vf_soa_column(soa, 1))[9], 9.0);
+
+    // Columns are padded, so a whole vector past the count stays in bounds
+    uint8_t* flags = (uint8_t*)vf_soa_column(soa, 2);
+    size_t padded = (vf_soa_capacity(soa) + VF_SOA_ALIGNMENT - 1) / VF_SOA_ALIGNMENT * VF_SOA_ALIGNMENT;
+    EXPECT_EQ(flags[padded - 1], 0);
+
+    vf_soa_clear(soa);
+    EXPECT_EQ(vf_soa_count(soa), 0);
+    EXPECT_EQ(vf_soa_capacity(soa), 5000);
+
+    vf_soa_free(soa);
+    return true;
+}
@@ -6,6 +6,7 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 // Helper function for thread creation test
 void* test_thread_func(void* arg) {
@@ -196,6 +197,8 @@ void* tls_thread(void* arg) {
     int* retrieved = (int*)vf_tls_get(key);
     EXPECT_EQ_INT(*retrieved, 42);
     
+    // Cleared first, or the key's destructor frees it again at thread exit
+    vf_tls_set(key, NULL);
     free(value);
     return NULL;
 }
@@ -1,8 +1,66 @@
 /*
-*   vf_darray - v0.21
+*   vf_darray - v0.30
 *   Header-only tiny dynamic array implementation.
 *
+*   The functions work on any element type through `void*` and the stride
+*   stored in the header. For a hot loop over a known type, VF_DA_DEFINE(name, T)
+*   generates typed `static inline` versions of the common operations
+*   (name_alloc, name_push_back, name_pop_back, name_insert, name_at) with the
+*   element size known at compile time. They use the same header, so a
+*   typed array can be passed to every other vf_da_* function as well.
+*
+*   Growing goes through `realloc`, so a block can be extended in place, and
+*   large blocks (which the C library maps on its own) can be remapped
+*   without copying. The capacity grows by DA_RESIZE_FACTOR, which may be
+*   defined before including this file and doesn't have to be an integer
+*   (e.g. 1.5 trades more reallocations for less unused memory).
+*
+*   Arrays created with `vf_da_alloc_huge` never move instead: they reserve
+*   address space for their maximum capacity up front and only commit memory
+*   as they grow, so pointers into them stay valid. This needs virtual memory
+*   (mmap or VirtualAlloc); elsewhere the whole block is allocated at once.
+*
+*   Memory comes from malloc/realloc/free unless the darray is created with
+*   `vf_da_alloc_with_allocator`. A copy of the allocator is kept in front of
+*   the header, so arrays from an arena or a pool grow and free through it,
+*   and only those arrays pay for the extra bytes.
+*
+*   The data of a darray is 16-byte aligned. `vf_da_alloc_aligned` pads the
+*   block in front of the header to align the data to 32 or 64 bytes for
+*   SIMD element types, or to a page; growing keeps the alignment.
+*
+*   Short-lived arrays that usually stay small can skip malloc altogether:
+*   `VF_DA_SMALL(T, N)` declares room for a header and N elements on the
+*   stack or in a struct, and `VF_DA_SMALL_INIT` makes a darray in it that
+*   only moves to the heap once it outgrows N elements.
+*
+*   Define VF_DARRAY_ENABLE_PARALLEL to also get sort, filter, for-each and
+*   map functions that split the array into chunks and run them on a
+*   vf_threadpool. It pulls in vf_thread.h and vf_threadpool.h, whose
+*   implementations must be compiled somewhere (VF_THREAD_IMPLEMENTATION,
+*   VF_THREADPOOL_IMPLEMENTATION), and needs -lpthread outside of Windows.
+*
 *   RECENT CHANGES:
+*       0.30    (2026-10-16)    `_vf_memswap` swaps in chunks and words instead of bytes;
+*       0.29    (2026-10-16)    Added small arrays with inline storage: VF_DA_SMALL,
+*                               VF_DA_SMALL_INIT, `vf_da_alloc_small` and `vf_da_is_small`;
+*       0.28    (2026-10-16)    Added `vf_da_alloc_aligned` and `vf_da_alloc_aligned_exact`;
+*       0.27    (2026-10-16)    Added VF_DARRAY_ENABLE_PARALLEL: `vf_da_parallel_sort`,
+*                               `vf_da_parallel_filter`, `vf_da_parallel_for_each` and
+*                               `vf_da_parallel_map` on a vf_threadpool;
+*       0.26    (2026-10-16)    Added `vf_da_allocator_t` and `vf_da_alloc_with_allocator`;
+*       0.25    (2026-10-16)    Added `vf_da_push_n`, `vf_da_insert_n` and `vf_da_erase_range`;
+*                               Implemented `vf_da_remove` and `vf_da_remove_swap`;
+*                               Fixed `vf_da_append` copying a single element of B;
+*       0.24    (2026-10-16)    Added `vf_da_alloc_huge` for arrays backed by reserved address space;
+*                               Added DA_RESERVED and DA_FLAGS header fields;
+*       0.23    (2026-10-16)    Growing reallocates instead of copying into a new block;
+*                               Fixed `vf_da_reserve` leaking the old block;
+*                               Fixed `vf_da_resize` dropping the count;
+*                               Fixed `vf_da_insert` and `vf_da_append` not growing;
+*                               DA_RESIZE_FACTOR can be overridden;
+*                               Added `vf_da_grow` and `vf_da_shrink_to_fit`;
+*       0.22    (2026-10-16)    Added VF_DA_DEFINE for typed, inlinable functions;
 *       0.21    (2024-06-19)    Removed unnecessary `#pragma once`;
 *       0.2     (2024-06-19)    Added `vf_` prefix to function names;
 *                               Improved header-only implementation;
@@ -33,19 +91,20 @@
 *       SOFTWARE.
 *
 *   TODOs:
-*       - [ ] Add macros for easy type casting.
 *       - [ ] Add prefix to enums to avoid collisions.
-*       - [ ] Provide macro for malloc for easy user-side swap.
-*       - [ ] Revisit resize/reserve...
 *
  */
 
 #ifndef VF_DARRAY_H
 #define VF_DARRAY_H
 
+#ifdef VF_DARRAY_ENABLE_PARALLEL
+#    include "vf_thread.h"
+#    include "vf_threadpool.h"
+#endif
+
 #include <stdint.h>
 #include <stdbool.h>
-// TODO: provide macro for malloc...
 #include <stdlib.h>
 #include <string.h>
 
@@ -58,11 +117,49 @@ extern "C" {
 // the dynamic array has ever reached. Currently, I believe this will
 // help with freeing the right amount of memory in case we shrink
 // the darray at one point. This keeps track of that.
-enum { DA_STRIDE, DA_COUNT, DA_CAPACITY, DA_MAX_CAPACITY, DA_HEADER_LENGTH };
+// DA_RESERVED is the capacity a huge array can reach without moving
+// (0 for every other darray), DA_FLAGS holds the DA_FLAG_* bits (and, for
+// aligned arrays, the alignment and padding above them). Keep the header
+// length even so the data stays 16-byte aligned.
+enum { DA_STRIDE, DA_COUNT, DA_CAPACITY, DA_MAX_CAPACITY, DA_RESERVED, DA_FLAGS, DA_HEADER_LENGTH };
+
+enum { DA_FLAG_HUGE = 1, DA_FLAG_ALLOCATOR = 2, DA_FLAG_ALIGNED = 4, DA_FLAG_INLINE = 8 };
+
+/**
+ * @brief Where a darray gets its memory from. `size` and `old_size` are the
+ * whole block (header included), so allocators that don't track sizes on
+ * their own, like arenas, can still copy on realloc. `realloc` may return
+ * NULL when the block can't grow, which fails the operation like any other
+ * allocation failure. `free` may do nothing, e.g. when the arena is reset
+ * as a whole.
+ */
+typedef struct {
+    void* (*alloc)(size_t size, void* user);
+    void* (*realloc)(void* ptr, size_t old_size, size_t new_size, void* user);
+    void (*free)(void* ptr, size_t size, void* user);
+    void* user;
+} vf_da_allocator_t;
+
+/**
+ * @brief Storage for a small darray of up to `N` elements of `T`: a header
+ * followed by the elements, to be declared on the stack or inside another
+ * struct and handed to `VF_DA_SMALL_INIT`.
+ */
+#define VF_DA_SMALL(T, N)                  \
+    struct {                               \
+        size_t header[DA_HEADER_LENGTH];   \
+        T items[N];                        \
+    }
+
+// Turns a VF_DA_SMALL(T, N) variable into a darray of T with capacity N.
+#define VF_DA_SMALL_INIT(small) \
+    vf_da_alloc_small((small).header, sizeof((small).items) / sizeof((small).items[0]), sizeof((small).items[0]))
 
 // Important defines
 #define DA_DEFAULT_CAPACITY 2
-#define DA_RESIZE_FACTOR    2
+#ifndef DA_RESIZE_FACTOR
+#    define DA_RESIZE_FACTOR 2
+#endif
 
 /**
  * @brief Function that creates a new Dynamic Array with specified capacity.
@@ -73,6 +170,90 @@ enum { DA_STRIDE, DA_COUNT, DA_CAPACITY, DA_MAX_CAPACITY, DA_HEADER_LENGTH };
  */
 extern void* vf_da_alloc_exact(size_t capacity, size_t stride);
 
+/**
+ * @brief Creates a Dynamic Array that never moves. Address space for
+ * `max_capacity` elements is reserved up front, but memory is only
+ * committed page by page as the capacity grows, so reserving far more than
+ * will be used is cheap. Growing past `max_capacity` fails (NULL), and
+ * shrinking gives the pages back.
+ *
+ * @param max_capacity The most elements the darray will ever hold.
+ * @param stride Size of the element the darray will hold.
+ * @return Pointer to the data (right after header), or NULL if the address
+ * space couldn't be reserved.
+ */
+extern void* vf_da_alloc_huge(size_t max_capacity, size_t stride);
+
+/**
+ * @brief Like `vf_da_alloc_exact`, but every allocation of the darray goes
+ * through `allocator`, which is copied, so it doesn't have to outlive the
+ * call. A NULL allocator means malloc.
+ *
+ * @param capacity The number of elements that can be held in currently allocated storage.
+ * @param stride Size of the element the darray will hold.
+ * @param allocator The callbacks and user pointer to allocate with.
+ * @return Pointer to the data (right after header), or NULL if the allocation failed.
+ */
+extern void* vf_da_alloc_with_allocator(size_t capacity, size_t stride, const vf_da_allocator_t* allocator);
+
+/**
+ * @brief Returns the allocator a darray was created with, or NULL if it
+ * uses malloc.
+ *
+ * @param da_data Pointer to the darray data.
+ */
+extern const vf_da_allocator_t* vf_da_get_allocator(const void* da_data);
+
+/**
+ * @brief Like `vf_da_alloc_exact`, but the data starts on an `alignment`
+ * boundary, and stays on one when the darray grows or shrinks, e.g. 32 or
+ * 64 for AVX element types, or the page size for large arrays. The block is
+ * padded in front of the header to get there, which costs up to
+ * `alignment` extra bytes; 16 or less is what every darray gets anyway.
+ *
+ * @param capacity The number of elements that can be held in currently allocated storage.
+ * @param stride Size of the element the darray will hold.
+ * @param alignment Alignment of the data, a power of two.
+ * @return Pointer to the data (right after header), or NULL if the
+ * allocation failed or `alignment` is not a power of two.
+ */
+extern void* vf_da_alloc_aligned_exact(size_t capacity, size_t stride, size_t alignment);
+
+/**
+ * @brief `vf_da_alloc_aligned_exact` at default capacity.
+ *
+ * @param stride Size of the element the darray will hold.
+ * @param alignment Alignment of the data, a power of two.
+ * @return Pointer to the data (right after header), or NULL.
+ */
+extern void* vf_da_alloc_aligned(size_t stride, size_t alignment);
+
+/**
+ * @brief Creates a Dynamic Array inside `buffer` instead of allocating one.
+ * The buffer holds the header and the first `capacity` elements; the darray
+ * only moves to the heap when it outgrows them, and from then on behaves
+ * like any other. Everything else, `vf_da_free` included, works the same;
+ * freeing an array that never left its buffer does nothing. The buffer must
+ * outlive the array while it is still inside it. The data is aligned like
+ * the buffer, not to 16 bytes.
+ *
+ * @param buffer At least `sizeof(size_t) * DA_HEADER_LENGTH + capacity * stride`
+ * bytes, aligned for `size_t`; usually a VF_DA_SMALL(T, N) (see VF_DA_SMALL_INIT).
+ * @param capacity The number of elements that fit in the buffer.
+ * @param stride Size of the element the darray will hold.
+ * @return Pointer to the data, inside `buffer`.
+ */
+extern void* vf_da_alloc_small(void* buffer, size_t capacity, size_t stride);
+
+/**
+ * @brief Checks whether a darray created by `vf_da_alloc_small` is still in
+ * its buffer.
+ *
+ * @param da_data Pointer to the darray data.
+ * @return bool `true` until the darray has moved to the heap.
+ */
+extern bool vf_da_is_small(const void* da_data);
+
 /**
  * @brief Function to create Dynamic Array at default capacity
  *
@@ -127,24 +308,42 @@ extern bool vf_da_is_empty(const void* da_data);
  *
  * @param da_data Pointer to the darray data
  * @param new_capacity The new number of elements the darray should hold.
- * @return void* Returns pointer to the data of the newly allocated chunk.
+ * @return void* Returns pointer to the data, which may have moved.
  * If the new desired capacity is less than or equal to old capacity,
- * no allocation/movement takes place.
+ * no allocation/movement takes place. Returns NULL if the allocation
+ * fails, in which case the darray is left as it was.
  */
 extern void* vf_da_reserve(void* da_data, size_t new_capacity);
 
 /**
- * @todo Make sure it does NOTHING if new_capacity == old_capacity
+ * @brief Makes room for at least `min_capacity` elements, growing the
+ * capacity by DA_RESIZE_FACTOR (or straight to `min_capacity` if that is
+ * more). Amortizes the reallocations of repeated pushes.
  *
- * @brief Resizes the Dynamic Array to hold `new_capacity` elements.
- * If the current capacity is greater than `new_capacity`, the container
- * will be marked as shrunked in its header, but won't reallocate.
- * If the current capacity is less than `new_capacity`, a new appropriate
- * block will be allocated and the darray will be moved.
+ * @param da_data Pointer to the darray data.
+ * @param min_capacity The number of elements that must fit.
+ * @return void* Returns pointer to the data, or NULL like `vf_da_reserve`.
+ */
+extern void* vf_da_grow(void* da_data, size_t min_capacity);
+
+/**
+ * @brief Reduces the capacity to the current count, giving the unused
+ * memory back.
  *
  * @param da_data Pointer to the darray data.
- * @param new_capacity New capacity of the container.
- * @return void* Returns darray data.
+ * @return void* Returns pointer to the data, which may have moved.
+ */
+extern void* vf_da_shrink_to_fit(void* da_data);
+
+/**
+ * @brief Makes room for `new_capacity` elements; the same as `vf_da_reserve`.
+ * It never shrinks: if `new_capacity` is not more than the current
+ * capacity nothing happens (see `vf_da_shrink_to_fit` to give memory back).
+ * The count and the elements are kept.
+ *
+ * @param da_data Pointer to the darray data.
+ * @param new_capacity The number of elements the darray should hold.
+ * @return void* Returns pointer to the data, or NULL like `vf_da_reserve`.
  */
 extern void* vf_da_resize(void* da_data, size_t new_capacity);
 
@@ -177,17 +376,60 @@ extern void* vf_da_pop_back(void* da_data);
  */
 extern void* vf_da_insert(void* da_data, void* data, size_t index);
 
+/**
+ * @brief Adds `count` elements to the end of the array, growing it at most
+ * once.
+ *
+ * @param da_data Pointer to the darray data.
+ * @param data Pointer to the elements; must not point into the darray itself.
+ * @param count Number of elements to add.
+ * @return void* The pointer to the darray data, or NULL if growing failed.
+ */
+extern void* vf_da_push_n(void* da_data, const void* data, size_t count);
+
+/**
+ * @brief Inserts `count` elements before `index`, moving the rest of the
+ * array once.
+ *
+ * @param da_data Pointer to the darray data.
+ * @param data Pointer to the elements; must not point into the darray itself.
+ * @param count Number of elements to insert.
+ * @param index Index of insertion, at most the count of the darray.
+ * @return void* The pointer to the darray data, or NULL if growing failed.
+ */
+extern void* vf_da_insert_n(void* da_data, const void* data, size_t count, size_t index);
+
+/**
+ * @brief Removes `count` elements starting at `index`, keeping the order of
+ * the rest. The capacity doesn't change.
+ *
+ * @param da_data Pointer to the darray data.
+ * @param index First element to remove.
+ * @param count Number of elements to remove; clamped to the end of the array.
+ */
+extern void vf_da_erase_range(void* da_data, size_t index, size_t count);
+
+/**
+ * @brief Removes the element at `index`, keeping the order of the rest.
+ */
 extern void vf_da_remove(void* da_data, size_t index);
+
+/**
+ * @brief Removes the element at `index` by moving the last element into its
+ * place. Constant time, but doesn't keep the order.
+ */
 extern void vf_da_remove_swap(void* da_data, size_t index);
 
 /**
  * @brief Append darray B at the end of darray A.
  * 
- * @warning darray B gets freed at the end of this method!
+ * @warning darray B gets freed at the end of this method, unless the strides
+ * don't match (A is returned unchanged) or A couldn't grow (NULL is returned,
+ * A is left as it was). B is not freed in either case.
  * 
  * @param da_data_a Pointer to darray A data.
  * @param da_data_b Pointer to darray B data.
- * @return void* The pointer to darray A data.
+ * @return void* The pointer to darray A data, or NULL if A couldn't grow.
  */
 extern void* vf_da_append(void* da_data_a, void* da_data_b);
 
@@ -209,6 +451,113 @@ extern void vf_da_swap(void* da_data, size_t index_a, size_t index_b);
 
 #define da_foreach()
 
+/**
+ * @brief Generates typed functions for a darray of `T` named `name_*`:
+ *
+ *   T*   name_alloc(size_t capacity)
+ *   T*   name_push_back(T* da, T value)
+ *   T    name_pop_back(T* da)                  Removes and returns the last element; the darray must not be empty.
+ *   T*   name_insert(T* da, size_t index, T value)
+ *   T*   name_at(T* da, size_t index)
+ *
+ * The fast paths only touch the header's count and capacity and store the
+ * element directly, so the compiler can inline them; growing still goes
+ * through vf_da_grow, and returns NULL if that fails. Use it once per type
+ * at file scope, e.g. `VF_DA_DEFINE(da_int, int)`.
+ */
+#define VF_DA_DEFINE(name, T)                                                           \
+    static inline T* name##_alloc(size_t capacity) {                                    \
+        return (T*)vf_da_alloc_exact(capacity, sizeof(T));                              \
+    }                                                                                   \
+    static inline T* name##_push_back(T* da, T value) {                                 \
+        size_t* header = (size_t*)da - DA_HEADER_LENGTH;                                \
+        size_t count = header[DA_COUNT];                                                \
+        if (count >= header[DA_CAPACITY]) {                                             \
+            da = (T*)vf_da_grow(da, count + 1);                                         \
+            if (da == NULL) return NULL;                                                \
+            header = (size_t*)da - DA_HEADER_LENGTH;                                    \
+        }                                                                               \
+        da[count] = value;                                                              \
+        header[DA_COUNT] = count + 1;                                                   \
+        return da;                                                                      \
+    }                                                                                   \
+    static inline T name##_pop_back(T* da) {                                            \
+        size_t* header = (size_t*)da - DA_HEADER_LENGTH;                                \
+        return da[--header[DA_COUNT]];                                                  \
+    }                                                                                   \
+    static inline T* name##_insert(T* da, size_t index, T value) {                      \
+        size_t* header = (size_t*)da - DA_HEADER_LENGTH;                                \
+        size_t count = header[DA_COUNT];                                                \
+        if (count >= header[DA_CAPACITY]) {                                             \
+            da = (T*)vf_da_grow(da, count + 1);                                         \
+            if (da == NULL) return NULL;                                                \
+            header = (size_t*)da - DA_HEADER_LENGTH;                                    \
+        }                                                                               \
+        memmove(da + index + 1, da + index, (count - index) * sizeof(T));               \
+        da[index] = value;                                                              \
+        header[DA_COUNT] = count + 1;                                                   \
+        return da;                                                                      \
+    }                                                                                   \
+    static inline T* name##_at(T* da, size_t index) {                                   \
+        return da + index;                                                              \
+    }
+
+#ifdef VF_DARRAY_ENABLE_PARALLEL
+// The parallel functions split the array into a few chunks per worker and
+// wait for all of them; small arrays (or a NULL pool) run on the calling
+// thread. vf_threadpool_wait waits for the whole pool, so other work queued
+// on it at the same time is waited for as well.
+
+/**
+ * @brief Sorts the darray in place: the chunks are sorted with qsort, then
+ * merged pairwise, each merge split evenly across the pool. Not stable.
+ * Needs a scratch copy of the array; if that can't be allocated, the array
+ * is sorted with qsort alone.
+ *
+ * @param da_data Pointer to the darray data.
+ * @param compare qsort-style comparison of two elements.
+ * @param pool The pool to run on, or NULL.
+ */
+extern void vf_da_parallel_sort(void* da_data, int (*compare)(const void*, const void*), vf_threadpool_t* pool);
+
+/**
+ * @brief Returns a new darray (same stride, allocated with malloc) of the
+ * elements for which `keep` returns true, in their original order. Each
+ * chunk marks and counts its elements, a prefix sum of the counts gives
+ * every chunk its place in the result, and the chunks then copy in parallel.
+ *
+ * @param da_data Pointer to the darray data.
+ * @param keep Called once per element with `user`; must be thread-safe.
+ * @return void* The new darray, or NULL if an allocation failed.
+ */
+extern void* vf_da_parallel_filter(const void* da_data, bool (*keep)(const void* element, void* user), void* user,
+                                   vf_threadpool_t* pool);
+
+/**
+ * @brief Calls `fn` on consecutive runs of elements that together cover the
+ * darray, in parallel. `first` is the index of `elements[0]`, so a kernel can
+ * loop over plain memory.
+ *
+ * @param da_data Pointer to the darray data.
+ * @param fn Called with a run of elements, its length, its first index and `user`.
+ */
+extern void vf_da_parallel_for_each(void* da_data, void (*fn)(void* elements, size_t count, size_t first, void* user),
+                                    void* user, vf_threadpool_t* pool);
+
+/**
+ * @brief Returns a new darray of the same count with elements of `stride`
+ * bytes, filled by `fn` from runs of the input, in parallel.
+ *
+ * @param da_data Pointer to the darray data.
+ * @param stride Size of the elements of the new darray.
+ * @param fn Writes `count` output elements to `out` from the input run `in`.
+ * @return void* The new darray, or NULL if it couldn't be allocated.
+ */
+extern void* vf_da_parallel_map(const void* da_data, size_t stride,
+                                void (*fn)(const void* in, void* out, size_t count, size_t first, void* user),
+                                void* user, vf_threadpool_t* pool);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -216,16 +565,52 @@ extern void vf_da_swap(void* da_data, size_t index_a, size_t index_b);
 // End of header file.
 #ifdef VF_DARRAY_IMPLEMENTATION
 
-// Memswap implementation...
+#if defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#    undef WIN32_LEAN_AND_MEAN
+#    define VF_DA_VIRTUAL_MEMORY
+#elif defined(__unix__) || defined(__APPLE__)
+#    include <sys/mman.h>
+#    include <unistd.h>
+#    if defined(MAP_ANONYMOUS) || defined(MAP_ANON)
+#        define VF_DA_VIRTUAL_MEMORY
+#    endif
+#endif
+
+// Swaps in fixed size chunks, which compilers turn into a few wide loads
+// and stores, then in words and bytes for the tail.
 static void _vf_memswap(void* ptr_a, void* ptr_b, size_t size) {
+    // Swapping an element with itself; memcpy must not get the same range twice
+    if (ptr_a == ptr_b) {
+        return;
+    }
     unsigned char* a = (unsigned char*)ptr_a;
     unsigned char* b = (unsigned char*)ptr_b;
-    unsigned char temp;
-
+    unsigned char temp[32];
+
+    while (size >= sizeof(temp)) {
+        memcpy(temp, a, sizeof(temp));
+        memcpy(a, b, sizeof(temp));
+        memcpy(b, temp, sizeof(temp));
+        a += sizeof(temp);
+        b += sizeof(temp);
+        size -= sizeof(temp);
+    }
+    while (size >= sizeof(uint64_t)) {
+        uint64_t word_a, word_b;
+        memcpy(&word_a, a, sizeof(uint64_t));
+        memcpy(&word_b, b, sizeof(uint64_t));
+        memcpy(a, &word_b, sizeof(uint64_t));
+        memcpy(b, &word_a, sizeof(uint64_t));
+        a += sizeof(uint64_t);
+        b += sizeof(uint64_t);
+        size -= sizeof(uint64_t);
+    }
     while (size--) {
-        temp = *a;
+        unsigned char byte = *a;
         *a++ = *b;
-        *b++ = temp;
+        *b++ = byte;
     }
 }
 
@@ -248,30 +633,309 @@ static void _vf_da_header_set(void* array, size_t field, size_t value) {
     header[field] = value;
 }
 
+// Space for the allocator copy in front of the header, rounded so the
+// header and data keep their alignment.
+#define _VF_DA_ALLOCATOR_SIZE ((sizeof(vf_da_allocator_t) + 15) & ~(size_t)15)
+
+// Aligned arrays keep log2 of their alignment in bits 8-15 of DA_FLAGS, and
+// the padding in front of everything else in the block from bit 16 up.
+#define _VF_DA_ALIGN_SHIFT 8
+#define _VF_DA_PAD_SHIFT 16
+
+static size_t _vf_da_alignment(const size_t* header) {
+    if (!(header[DA_FLAGS] & DA_FLAG_ALIGNED)) {
+        return 0;
+    }
+    return (size_t)1 << ((header[DA_FLAGS] >> _VF_DA_ALIGN_SHIFT) & 0xFF);
+}
+
+// Bytes of the block in front of the header: the padding, then the allocator copy.
+static size_t _vf_da_prefix(const size_t* header) {
+    size_t prefix = (header[DA_FLAGS] & DA_FLAG_ALLOCATOR) ? _VF_DA_ALLOCATOR_SIZE : 0;
+    if (header[DA_FLAGS] & DA_FLAG_ALIGNED) {
+        prefix += header[DA_FLAGS] >> _VF_DA_PAD_SHIFT;
+    }
+    return prefix;
+}
+
+// Size of the whole block for `capacity` elements. Aligned arrays always ask
+// for `alignment` bytes of slack, so the size doesn't depend on where the
+// block landed.
+static size_t _vf_da_block_size(size_t flags, size_t alignment, size_t stride, size_t capacity) {
+    size_t size = sizeof(size_t) * DA_HEADER_LENGTH + stride * capacity;
+    if (flags & DA_FLAG_ALLOCATOR) {
+        size += _VF_DA_ALLOCATOR_SIZE;
+    }
+    if (flags & DA_FLAG_ALIGNED) {
+        size += alignment;
+    }
+    return size;
+}
+
+// Padding that puts the data of a block at `block` on an `alignment` boundary.
+static size_t _vf_da_pad(const uint8_t* block, size_t flags, size_t alignment) {
+    if (!(flags & DA_FLAG_ALIGNED)) {
+        return 0;
+    }
+    size_t in_front = sizeof(size_t) * DA_HEADER_LENGTH + ((flags & DA_FLAG_ALLOCATOR) ? _VF_DA_ALLOCATOR_SIZE : 0);
+    uintptr_t data = (uintptr_t)block + in_front;
+    return (size_t)(((data + alignment - 1) & ~(uintptr_t)(alignment - 1)) - data);
+}
+
+static void* _vf_da_alloc(size_t capacity, size_t stride, size_t alignment, const vf_da_allocator_t* allocator) {
+    size_t flags = allocator ? DA_FLAG_ALLOCATOR : 0;
+    // malloc already gives 16 bytes, and so does the header
+    if (alignment > 16) {
+        if ((alignment & (alignment - 1)) != 0) {
+            return NULL;
+        }
+        size_t shift = 0;
+        while (((size_t)1 << shift) < alignment) {
+            shift++;
+        }
+        flags |= DA_FLAG_ALIGNED | (shift << _VF_DA_ALIGN_SHIFT);
+    }
+
+    size_t size = _vf_da_block_size(flags, alignment, stride, capacity);
+    uint8_t* block = allocator ? (uint8_t*)allocator->alloc(size, allocator->user) : (uint8_t*)malloc(size);
+    if (block == NULL) {
+        return NULL;
+    }
+    size_t pad = _vf_da_pad(block, flags, alignment);
+    flags |= pad << _VF_DA_PAD_SHIFT;
+    if (allocator != NULL) {
+        memcpy(block + pad, allocator, sizeof(vf_da_allocator_t));
+    }
+
+    size_t* darray = (size_t*)(block + pad + ((flags & DA_FLAG_ALLOCATOR) ? _VF_DA_ALLOCATOR_SIZE : 0));
+    darray[DA_STRIDE] = stride;
+    darray[DA_COUNT] = 0;
+    darray[DA_CAPACITY] = capacity;
+    darray[DA_MAX_CAPACITY] = capacity;
+    darray[DA_RESERVED] = 0;
+    darray[DA_FLAGS] = flags;
+
+    return (void*)(darray + DA_HEADER_LENGTH);
+}
+
+void* vf_da_alloc_with_allocator(size_t capacity, size_t stride, const vf_da_allocator_t* allocator) {
+    return _vf_da_alloc(capacity, stride, 0, allocator);
+}
+
 void* vf_da_alloc_exact(size_t capacity, size_t stride) {
-    size_t header_size = sizeof(size_t) * DA_HEADER_LENGTH;
-    size_t* darray = (size_t*)malloc(header_size + (stride * capacity));
+    return _vf_da_alloc(capacity, stride, 0, NULL);
+}
 
+void* vf_da_alloc_aligned_exact(size_t capacity, size_t stride, size_t alignment) {
+    return _vf_da_alloc(capacity, stride, alignment, NULL);
+}
+
+void* vf_da_alloc_aligned(size_t stride, size_t alignment) {
+    return _vf_da_alloc(DA_DEFAULT_CAPACITY, stride, alignment, NULL);
+}
+
+void* vf_da_alloc_small(void* buffer, size_t capacity, size_t stride) {
+    size_t* darray = (size_t*)buffer;
     darray[DA_STRIDE] = stride;
     darray[DA_COUNT] = 0;
     darray[DA_CAPACITY] = capacity;
     darray[DA_MAX_CAPACITY] = capacity;
+    darray[DA_RESERVED] = 0;
+    darray[DA_FLAGS] = DA_FLAG_INLINE;
 
     return (void*)(darray + DA_HEADER_LENGTH);
 }
 
+bool vf_da_is_small(const void* da_data) {
+    return (_vf_da_header_get(da_data, DA_FLAGS) & DA_FLAG_INLINE) != 0;
+}
+
+const vf_da_allocator_t* vf_da_get_allocator(const void* da_data) {
+    const size_t* header = (const size_t*)da_data - DA_HEADER_LENGTH;
+    if (!(header[DA_FLAGS] & DA_FLAG_ALLOCATOR)) {
+        return NULL;
+    }
+    return (const vf_da_allocator_t*)((const uint8_t*)header - _VF_DA_ALLOCATOR_SIZE);
+}
+
+// Address space for huge arrays: reserve a range, then commit and decommit
+// pages inside it. Committed pages read as zero.
+#if defined(VF_DA_VIRTUAL_MEMORY) && defined(_WIN32)
+static size_t _vf_da_page_size(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+}
+
+static void* _vf_da_vm_reserve(size_t size) {
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+static bool _vf_da_vm_commit(void* address, size_t size) {
+    return VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+static void _vf_da_vm_decommit(void* address, size_t size) {
+    VirtualFree(address, size, MEM_DECOMMIT);
+}
+
+static void _vf_da_vm_release(void* address, size_t size) {
+    (void)size;
+    VirtualFree(address, 0, MEM_RELEASE);
+}
+#elif defined(VF_DA_VIRTUAL_MEMORY)
+#    ifndef MAP_ANONYMOUS
+#        define MAP_ANONYMOUS MAP_ANON
+#    endif
+#    ifdef MAP_NORESERVE
+#        define _VF_DA_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE)
+#    else
+#        define _VF_DA_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS)
+#    endif
+
+static size_t _vf_da_page_size(void) {
+    return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void* _vf_da_vm_reserve(size_t size) {
+    void* address = mmap(NULL, size, PROT_NONE, _VF_DA_MAP_FLAGS, -1, 0);
+    return (address == MAP_FAILED) ? NULL : address;
+}
+
+static bool _vf_da_vm_commit(void* address, size_t size) {
+    return mprotect(address, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+// Mapping fresh inaccessible pages over the range drops the old ones on
+// every platform, where madvise flags differ in what they actually free.
+static void _vf_da_vm_decommit(void* address, size_t size) {
+    mmap(address, size, PROT_NONE, _VF_DA_MAP_FLAGS | MAP_FIXED, -1, 0);
+}
+
+static void _vf_da_vm_release(void* address, size_t size) {
+    munmap(address, size);
+}
+#else
+// Without virtual memory the whole range is allocated up front; the array
+// still never moves, it just doesn't save any memory.
+static size_t _vf_da_page_size(void) {
+    return 4096;
+}
+
+static void* _vf_da_vm_reserve(size_t size) {
+    return calloc(1, size);
+}
+
+static bool _vf_da_vm_commit(void* address, size_t size) {
+    (void)address;
+    (void)size;
+    return true;
+}
+
+static void _vf_da_vm_decommit(void* address, size_t size) {
+    (void)address;
+    (void)size;
+}
+
+static void _vf_da_vm_release(void* address, size_t size) {
+    (void)size;
+    free(address);
+}
+#endif
+
+// Bytes of a huge array's range that hold its header and `capacity` elements.
+static size_t _vf_da_huge_bytes(size_t capacity, size_t stride) {
+    size_t page = _vf_da_page_size();
+    size_t bytes = sizeof(size_t) * DA_HEADER_LENGTH + stride * capacity;
+    return (bytes + page - 1) / page * page;
+}
+
+// Commits or decommits pages so `capacity` elements fit. The capacity is
+// rounded up to what the committed pages hold. The data never moves.
+static void* _vf_da_huge_commit(void* da_data, size_t capacity) {
+    size_t* header = (size_t*)da_data - DA_HEADER_LENGTH;
+    size_t stride = header[DA_STRIDE];
+    if (capacity > header[DA_RESERVED]) {
+        return NULL;
+    }
+
+    size_t committed = _vf_da_huge_bytes(header[DA_CAPACITY], stride);
+    size_t needed = _vf_da_huge_bytes(capacity, stride);
+    if (needed > committed) {
+        if (!_vf_da_vm_commit((uint8_t*)header + committed, needed - committed)) {
+            return NULL;
+        }
+    } else if (needed < committed) {
+        _vf_da_vm_decommit((uint8_t*)header + needed, committed - needed);
+    }
+
+    size_t fits = stride ? (needed - sizeof(size_t) * DA_HEADER_LENGTH) / stride : header[DA_RESERVED];
+    header[DA_CAPACITY] = (fits < header[DA_RESERVED]) ? fits : header[DA_RESERVED];
+    if (header[DA_MAX_CAPACITY] < header[DA_CAPACITY]) {
+        header[DA_MAX_CAPACITY] = header[DA_CAPACITY];
+    }
+
+    return da_data;
+}
+
+void* vf_da_alloc_huge(size_t max_capacity, size_t stride) {
+    if (max_capacity == 0 || (stride && max_capacity > (SIZE_MAX - 2 * _vf_da_page_size()) / stride)) {
+        return NULL;
+    }
+
+    size_t bytes = _vf_da_huge_bytes(max_capacity, stride);
+    size_t* darray = (size_t*)_vf_da_vm_reserve(bytes);
+    if (darray == NULL) {
+        return NULL;
+    }
+    // The header's page
+    if (!_vf_da_vm_commit(darray, _vf_da_page_size())) {
+        _vf_da_vm_release(darray, bytes);
+        return NULL;
+    }
+
+    darray[DA_STRIDE] = stride;
+    darray[DA_COUNT] = 0;
+    darray[DA_CAPACITY] = 0;
+    darray[DA_MAX_CAPACITY] = 0;
+    darray[DA_RESERVED] = max_capacity;
+    darray[DA_FLAGS] = DA_FLAG_HUGE;
+
+    // Whatever fits next to the header is usable right away
+    return _vf_da_huge_commit(darray + DA_HEADER_LENGTH, 0);
+}
+
 void* vf_da_alloc(size_t stride) {
     return vf_da_alloc_exact(DA_DEFAULT_CAPACITY, stride);
 }
 
 void vf_da_free(void* da_data) {
     size_t* header = (size_t*)da_data - DA_HEADER_LENGTH;
+    if (header[DA_FLAGS] & DA_FLAG_HUGE) {
+        _vf_da_vm_release(header, _vf_da_huge_bytes(header[DA_RESERVED], header[DA_STRIDE]));
+        return;
+    }
+    // The buffer belongs to the caller
+    if (header[DA_FLAGS] & DA_FLAG_INLINE) {
+        return;
+    }
+
+    size_t size = _vf_da_block_size(header[DA_FLAGS], _vf_da_alignment(header), header[DA_STRIDE], header[DA_CAPACITY]);
+    uint8_t* block = (uint8_t*)header - _vf_da_prefix(header);
+    const vf_da_allocator_t* allocator = vf_da_get_allocator(da_data);
+
     header[DA_STRIDE] = 0;
     header[DA_CAPACITY] = 0;
     header[DA_COUNT] = 0;
     header[DA_MAX_CAPACITY] = 0;
 
-    free(header);
+    if (allocator != NULL) {
+        // The callbacks are read before the block (and the copy in it) is gone
+        vf_da_allocator_t callbacks = *allocator;
+        callbacks.free(block, size, callbacks.user);
+    } else {
+        free(block);
+    }
 }
 
 size_t vf_da_count(const void* da_data) {
@@ -292,45 +956,124 @@ bool vf_da_is_empty(const void* da_data) {
     return (vf_da_count(da_data) == 0) ? true : false;
 }
 
-void* vf_da_reserve(void* da_data, size_t new_capacity) {
+/**
+ * @brief Moves the darray into a block of `capacity` elements with realloc
+ * (or the darray's own allocator). The C library extends the block in place
+ * when it can, and remaps large blocks instead of copying them.
+ *
+ * @private
+ */
+static void* _vf_da_realloc(void* da_data, size_t capacity) {
     size_t* header = (size_t*)da_data - DA_HEADER_LENGTH;
+    if (header[DA_FLAGS] & DA_FLAG_HUGE) {
+        return _vf_da_huge_commit(da_data, capacity);
+    }
+    // A small array leaves its buffer for a heap block the first time it
+    // outgrows it; it never shrinks back in
+    if (header[DA_FLAGS] & DA_FLAG_INLINE) {
+        if (capacity <= header[DA_CAPACITY]) {
+            return da_data;
+        }
+        void* heap = _vf_da_alloc(capacity, header[DA_STRIDE], 0, NULL);
+        if (heap == NULL) {
+            return NULL;
+        }
+        memcpy(heap, da_data, header[DA_STRIDE] * header[DA_COUNT]);
+        _vf_da_header_set(heap, DA_COUNT, header[DA_COUNT]);
+        return heap;
+    }
 
-    if (header[DA_CAPACITY] >= new_capacity) {
-        return da_data;
+    // Everything needed from the header is read before the block may move
+    size_t flags = header[DA_FLAGS];
+    size_t stride = header[DA_STRIDE];
+    size_t old_capacity = header[DA_CAPACITY];
+    size_t alignment = _vf_da_alignment(header);
+    size_t in_front = (flags & DA_FLAG_ALLOCATOR) ? _VF_DA_ALLOCATOR_SIZE : 0;
+    size_t old_pad = _vf_da_prefix(header) - in_front;
+    size_t old_size = _vf_da_block_size(flags, alignment, stride, old_capacity);
+    size_t new_size = _vf_da_block_size(flags, alignment, stride, capacity);
+    uint8_t* old_block = (uint8_t*)header - old_pad - in_front;
+
+    uint8_t* block;
+    const vf_da_allocator_t* allocator = vf_da_get_allocator(da_data);
+    if (allocator != NULL) {
+        vf_da_allocator_t callbacks = *allocator;
+        block = (uint8_t*)callbacks.realloc(old_block, old_size, new_size, callbacks.user);
+    } else {
+        block = (uint8_t*)realloc(old_block, new_size);
+    }
+    if (block == NULL) {
+        return NULL;
     }
 
-    size_t header_size = sizeof(size_t) * DA_HEADER_LENGTH;
-    size_t* new_darray = (size_t*)malloc(header_size + (header[DA_STRIDE] * new_capacity));
+    // A block that moved may need a different padding to keep the data aligned
+    size_t pad = _vf_da_pad(block, flags, alignment);
+    if (pad != old_pad) {
+        size_t kept = (capacity < old_capacity) ? capacity : old_capacity;
+        memmove(block + pad, block + old_pad, in_front + sizeof(size_t) * DA_HEADER_LENGTH + stride * kept);
+    }
+    size_t* new_header = (size_t*)(block + pad + in_front);
+    if (flags & DA_FLAG_ALIGNED) {
+        new_header[DA_FLAGS] = (flags & (((size_t)1 << _VF_DA_PAD_SHIFT) - 1)) | (pad << _VF_DA_PAD_SHIFT);
+    }
 
-    new_darray[DA_STRIDE] = header[DA_STRIDE];
-    new_darray[DA_COUNT] = header[DA_COUNT];
-    new_darray[DA_CAPACITY] = new_capacity;
-    new_darray[DA_MAX_CAPACITY] = new_capacity;
+    new_header[DA_CAPACITY] = capacity;
+    if (new_header[DA_MAX_CAPACITY] < capacity) {
+        new_header[DA_MAX_CAPACITY] = capacity;
+    }
 
-    void* new_da_data = (void*)(new_darray + DA_HEADER_LENGTH);
+    return (void*)(new_header + DA_HEADER_LENGTH);
+}
 
-    memcpy(new_da_data, da_data, header[DA_STRIDE] * header[DA_CAPACITY]);
+void* vf_da_reserve(void* da_data, size_t new_capacity) {
+    if (vf_da_capacity(da_data) >= new_capacity) {
+        return da_data;
+    }
 
-    return new_da_data;
+    return _vf_da_realloc(da_data, new_capacity);
 }
 
-void* vf_da_resize(void* da_data, size_t new_capacity) {
-    size_t len = vf_da_count(da_data);
-    size_t stride = vf_da_stride(da_data);
+void* vf_da_grow(void* da_data, size_t min_capacity) {
     size_t capacity = vf_da_capacity(da_data);
+    if (capacity >= min_capacity) {
+        return da_data;
+    }
 
-    // If the new capacity is less than the current capacity,
-    // the capacity field of the header simply gets changed.
-    if (capacity >= new_capacity) {
-        capacity = new_capacity;
+    // The factor may be fractional; small arrays still grow by at least one
+    size_t new_capacity = (size_t)((double)capacity * DA_RESIZE_FACTOR);
+    if (new_capacity <= capacity) {
+        new_capacity = capacity + 1;
+    }
+    if (new_capacity < DA_DEFAULT_CAPACITY) {
+        new_capacity = DA_DEFAULT_CAPACITY;
+    }
+    // Huge arrays can't outgrow their reservation
+    size_t reserved = _vf_da_header_get(da_data, DA_RESERVED);
+    if (reserved && new_capacity > reserved) {
+        new_capacity = reserved;
+    }
+    if (new_capacity < min_capacity) {
+        new_capacity = min_capacity;
+    }
+
+    return _vf_da_realloc(da_data, new_capacity);
+}
+
+void* vf_da_shrink_to_fit(void* da_data) {
+    size_t count = vf_da_count(da_data);
+    if (vf_da_capacity(da_data) == count) {
         return da_data;
     }
 
-    void* new_da = vf_da_alloc_exact(new_capacity, stride);
-    memcpy(new_da, da_data, len * stride);
-    vf_da_free(da_data);
+    void* new_da_data = _vf_da_realloc(da_data, count);
+    // Shrinking in place can't really fail, but if it does the old block is still good
+    return new_da_data ? new_da_data : da_data;
+}
 
-    return new_da;
+void* vf_da_resize(void* da_data, size_t new_capacity) {
+    // If the new capacity is less than the current capacity,
+    // nothing happens; see `vf_da_shrink_to_fit` to give memory back.
+    return vf_da_reserve(da_data, new_capacity);
 }
 
 void* vf_da_push_back(void* da_data, const void* data) {
@@ -340,7 +1083,10 @@ void* vf_da_push_back(void* da_data, const void* data) {
 
     // Check if we need to resize the darray
     if (len >= capacity) {
-        da_data = vf_da_reserve(da_data, capacity * DA_RESIZE_FACTOR);
+        da_data = vf_da_grow(da_data, len + 1);
+        if (da_data == NULL) {
+            return NULL;
+        }
     }
 
     size_t addr = (size_t)da_data;
@@ -364,66 +1110,101 @@ void* vf_da_pop_back(void* da_data) {
 }
 
 void* vf_da_insert(void* da_data, void* data, size_t index) {
-    size_t* header = (size_t*)da_data - DA_HEADER_LENGTH;
-    size_t capacity = vf_da_capacity(da_data);
+    return vf_da_insert_n(da_data, data, 1, index);
+}
+
+void* vf_da_push_n(void* da_data, const void* data, size_t count) {
+    if (count == 0) {
+        return da_data;
+    }
+    size_t len = vf_da_count(da_data);
+    size_t stride = vf_da_stride(da_data);
+
+    da_data = vf_da_grow(da_data, len + count);
+    if (da_data == NULL) {
+        return NULL;
+    }
+
+    memcpy((uint8_t*)da_data + len * stride, data, count * stride);
+    _vf_da_header_set(da_data, DA_COUNT, len + count);
+
+    return da_data;
+}
+
+void* vf_da_insert_n(void* da_data, const void* data, size_t count, size_t index) {
+    if (count == 0) {
+        return da_data;
+    }
+    size_t len = vf_da_count(da_data);
     size_t stride = vf_da_stride(da_data);
-    size_t count = vf_da_count(da_data);
 
-    // Check if we have enough space to insert an element
+    // Check if we have enough space to insert the elements
     // If not, we reserve more
-    if (count >= capacity) {
-        header[DA_CAPACITY] = capacity * DA_RESIZE_FACTOR;
-        da_data = vf_da_reserve(da_data, header[DA_CAPACITY]);
+    da_data = vf_da_grow(da_data, len + count);
+    if (da_data == NULL) {
+        return NULL;
     }
 
-    // Move everything by one
+    // Move everything after the index by `count` in one go
     uint8_t* start = (uint8_t*)da_data + (index * stride);
-    size_t length = (count - index) * stride;
-    memcpy((void*)(start + stride), start, length);
+    memmove(start + count * stride, start, (len - index) * stride);
 
-    // Insert the new element
-    memcpy(start, data, stride);
-
-    // Increment the count
-    header[DA_COUNT]++;
+    // Insert the new elements
+    memcpy(start, data, count * stride);
+    _vf_da_header_set(da_data, DA_COUNT, len + count);
 
     return da_data;
 }
 
-// void da_remove(void* da_data, size_t index) {}
-// void da_remove_swap(void* da_data, size_t index) {}
+void vf_da_erase_range(void* da_data, size_t index, size_t count) {
+    size_t len = vf_da_count(da_data);
+    size_t stride = vf_da_stride(da_data);
+    if (index >= len) {
+        return;
+    }
+    if (count > len - index) {
+        count = len - index;
+    }
 
-void* vf_da_append(void* da_data_a, void* da_data_b) {
-    size_t* header_a = (size_t*)da_data_a - DA_HEADER_LENGTH;
-    size_t* header_b = (size_t*)da_data_b - DA_HEADER_LENGTH;
+    uint8_t* start = (uint8_t*)da_data + (index * stride);
+    memmove(start, start + count * stride, (len - index - count) * stride);
+    _vf_da_header_set(da_data, DA_COUNT, len - count);
+}
+
+void vf_da_remove(void* da_data, size_t index) {
+    vf_da_erase_range(da_data, index, 1);
+}
+
+void vf_da_remove_swap(void* da_data, size_t index) {
+    size_t len = vf_da_count(da_data);
+    size_t stride = vf_da_stride(da_data);
+    if (index >= len) {
+        return;
+    }
+
+    if (index != len - 1) {
+        memcpy((uint8_t*)da_data + index * stride, (uint8_t*)da_data + (len - 1) * stride, stride);
+    }
+    _vf_da_header_set(da_data, DA_COUNT, len - 1);
+}
 
+void* vf_da_append(void* da_data_a, void* da_data_b) {
     // Let's make sure they are both the same stride,
     // otherwise we can't merge them!
-    if (header_a[DA_STRIDE] != header_b[DA_STRIDE]) {
+    if (vf_da_stride(da_data_a) != vf_da_stride(da_data_b)) {
         return da_data_a;
     }
 
-    // Check if both arrays can fit into A
-    // if not, reserve more space
-    // TODO: It might be worth it to reserver slightly more space,
-    // otherwise the next push or insert will trigger a reallocation.
-    if (header_a[DA_CAPACITY] < (header_a[DA_CAPACITY] + header_b[DA_CAPACITY])) {
-        header_a[DA_CAPACITY] = header_a[DA_CAPACITY] + header_b[DA_CAPACITY];
-        da_data_a = vf_da_reserve(da_data_a, header_a[DA_CAPACITY]);
+    // Copy all of B into A, growing A once if needed
+    void* appended = vf_da_push_n(da_data_a, da_data_b, vf_da_count(da_data_b));
+    if (appended == NULL) {
+        return NULL;
     }
 
-    // Copy B into A
-    memcpy((void*)((uint8_t*)da_data_a + (header_a[DA_COUNT] * header_a[DA_STRIDE])),
-             da_data_b,
-             header_a[DA_STRIDE]);
-
-    // Add B's count to A's count
-    header_a[DA_COUNT] = header_a[DA_COUNT] + header_b[DA_COUNT];
-
     // Free B
     vf_da_free(da_data_b);
 
-    return da_data_a;
+    return appended;
 }
 
 void vf_da_clear(void* da_data) {
@@ -431,6 +1212,350 @@ void vf_da_clear(void* da_data) {
     header[DA_COUNT] = 0;
 }
 
+#ifdef VF_DARRAY_ENABLE_PARALLEL
+// Below this many elements per chunk, handing work to the pool costs more
+// than it saves.
+#define _VF_DA_PARALLEL_MIN_CHUNK 4096
+
+typedef struct {
+    size_t stride;
+    size_t out_stride;
+    int (*compare)(const void*, const void*);
+    bool (*keep)(const void*, void*);
+    void (*for_each)(void*, size_t, size_t, void*);
+    void (*map)(const void*, void*, size_t, size_t, void*);
+    void* user;
+} _vf_da_parallel_t;
+
+typedef struct {
+    const _vf_da_parallel_t* context;
+    uint8_t* data;          // The chunk's first element
+    uint8_t* out;
+    uint8_t* flags;         // Filter: one byte per element of the chunk
+    size_t first;
+    size_t count;
+    size_t kept;            // Filter: kept elements, then the chunk's offset in the result
+    // Merges: runs A and B are merged into `out`, this job writing [out_first, out_last)
+    const uint8_t* a;
+    const uint8_t* b;
+    size_t a_count;
+    size_t b_count;
+    size_t out_first;
+    size_t out_last;
+} _vf_da_job_t;
+
+// A few chunks per worker even out chunks that happen to run slower.
+static size_t _vf_da_job_count(const vf_threadpool_t* pool, size_t count) {
+    if (pool == NULL) {
+        return 1;
+    }
+    size_t jobs = (size_t)pool->thread_count * 4;
+    return (count / _VF_DA_PARALLEL_MIN_CHUNK < jobs) ? (count / _VF_DA_PARALLEL_MIN_CHUNK + 1) : jobs;
+}
+
+static void _vf_da_run_jobs(void (*task)(void*), _vf_da_job_t* jobs, size_t job_count, vf_threadpool_t* pool) {
+    if (pool == NULL || job_count == 1) {
+        for (size_t j = 0; j < job_count; ++j) {
+            task(&jobs[j]);
+        }
+        return;
+    }
+    for (size_t j = 0; j < job_count; ++j) {
+        if (vf_threadpool_add_task(pool, task, &jobs[j]) != VF_THREAD_SUCCESS) {
+            task(&jobs[j]);
+        }
+    }
+    vf_threadpool_wait(pool);
+}
+
+// Splits [0, count) into `job_count` chunks of nearly equal size.
+static void _vf_da_split(_vf_da_job_t* jobs, size_t job_count, const _vf_da_parallel_t* context,
+                         uint8_t* data, size_t count) {
+    for (size_t j = 0; j < job_count; ++j) {
+        size_t first = count * j / job_count;
+        memset(&jobs[j], 0, sizeof(_vf_da_job_t));
+        jobs[j].context = context;
+        jobs[j].first = first;
+        jobs[j].count = count * (j + 1) / job_count - first;
+        jobs[j].data = data + first * context->stride;
+    }
+}
+
+static void _vf_da_sort_task(void* arg) {
+    _vf_da_job_t* job = (_vf_da_job_t*)arg;
+    qsort(job->data, job->count, job->context->stride, job->context->compare);
+}
+
+// How many of the first `k` merged elements come from A. Ties go to A.
+static size_t _vf_da_merge_split(const _vf_da_job_t* job, size_t k) {
+    size_t stride = job->context->stride;
+    size_t low = (k > job->b_count) ? k - job->b_count : 0;
+    size_t high = (k < job->a_count) ? k : job->a_count;
+    while (low < high) {
+        size_t i = low + (high - low) / 2;
+        // A[i] is merged before B[k - i - 1], so more than i come from A
+        if (job->context->compare(job->a + i * stride, job->b + (k - i - 1) * stride) <= 0) {
+            low = i + 1;
+        } else {
+            high = i;
+        }
+    }
+    return low;
+}
+
+static void _vf_da_merge_task(void* arg) {
+    _vf_da_job_t* job = (_vf_da_job_t*)arg;
+    size_t stride = job->context->stride;
+    int (*compare)(const void*, const void*) = job->context->compare;
+
+    size_t i = _vf_da_merge_split(job, job->out_first);
+    size_t i_end = _vf_da_merge_split(job, job->out_last);
+    size_t j = job->out_first - i;
+    size_t j_end = job->out_last - i_end;
+    uint8_t* out = job->out + job->out_first * stride;
+
+    while (i < i_end && j < j_end) {
+        if (compare(job->b + j * stride, job->a + i * stride) < 0) {
+            memcpy(out, job->b + j++ * stride, stride);
+        } else {
+            memcpy(out, job->a + i++ * stride, stride);
+        }
+        out += stride;
+    }
+    memcpy(out, job->a + i * stride, (i_end - i) * stride);
+    out += (i_end - i) * stride;
+    memcpy(out, job->b + j * stride, (j_end - j) * stride);
+}
+
+void vf_da_parallel_sort(void* da_data, int (*compare)(const void*, const void*), vf_threadpool_t* pool) {
+    size_t count = vf_da_count(da_data);
+    size_t stride = vf_da_stride(da_data);
+    size_t runs = _vf_da_job_count(pool, count);
+    if (runs == 1) {
+        qsort(da_data, count, stride, compare);
+        return;
+    }
+
+    // A merge round has at most one job per chunk-sized piece, plus one per pair
+    uint8_t* scratch = (uint8_t*)malloc(count * stride);
+    _vf_da_job_t* jobs = (_vf_da_job_t*)malloc((2 * runs + 1) * sizeof(_vf_da_job_t));
+    size_t* bounds = (size_t*)malloc((runs + 1) * sizeof(size_t));
+    if (scratch == NULL || jobs == NULL || bounds == NULL) {
+        free(scratch);
+        free(jobs);
+        free(bounds);
+        qsort(da_data, count, stride, compare);
+        return;
+    }
+
+    _vf_da_parallel_t context;
+    memset(&context, 0, sizeof(context));
+    context.stride = stride;
+    context.compare = compare;
+
+    _vf_da_split(jobs, runs, &context, (uint8_t*)da_data, count);
+    for (size_t r = 0; r < runs; ++r) {
+        bounds[r] = jobs[r].first;
+    }
+    bounds[runs] = count;
+    _vf_da_run_jobs(_vf_da_sort_task, jobs, runs, pool);
+
+    // Merging pairs of runs until one is left; each output is cut into
+    // pieces of about a chunk, so the last rounds still use the whole pool.
+    size_t piece = count / runs + 1;
+    uint8_t* source = (uint8_t*)da_data;
+    uint8_t* target = scratch;
+    while (runs > 1) {
+        size_t job_count = 0;
+        for (size_t r = 0; r < runs; r += 2) {
+            size_t start = bounds[r];
+            size_t middle = bounds[r + 1];
+            size_t end = (r + 2 <= runs) ? bounds[r + 2] : middle;
+            for (size_t k = 0; k < end - start; k += piece) {
+                _vf_da_job_t* job = &jobs[job_count++];
+                memset(job, 0, sizeof(_vf_da_job_t));
+                job->context = &context;
+                job->a = source + start * stride;
+                job->a_count = middle - start;
+                job->b = source + middle * stride;
+                job->b_count = end - middle;
+                job->out = target + start * stride;
+                job->out_first = k;
+                job->out_last = (end - start - k < piece) ? end - start : k + piece;
+            }
+        }
+        _vf_da_run_jobs(_vf_da_merge_task, jobs, job_count, pool);
+
+        for (size_t r = 0; 2 * r < runs; ++r) {
+            bounds[r] = bounds[2 * r];
+        }
+        runs = (runs + 1) / 2;
+        bounds[runs] = count;
+
+        uint8_t* swap = source;
+        source = target;
+        target = swap;
+    }
+    if (source != da_data) {
+        memcpy(da_data, source, count * stride);
+    }
+
+    free(scratch);
+    free(jobs);
+    free(bounds);
+}
+
+static void _vf_da_filter_mark_task(void* arg) {
+    _vf_da_job_t* job = (_vf_da_job_t*)arg;
+    const _vf_da_parallel_t* context = job->context;
+    size_t kept = 0;
+    for (size_t i = 0; i < job->count; ++i) {
+        bool keep = context->keep(job->data + i * context->stride, context->user);
+        job->flags[i] = keep;
+        kept += keep;
+    }
+    job->kept = kept;
+}
+
+static void _vf_da_filter_copy_task(void* arg) {
+    _vf_da_job_t* job = (_vf_da_job_t*)arg;
+    size_t stride = job->context->stride;
+    uint8_t* out = job->out + job->kept * stride;
+    // Kept elements next to each other are copied in one go
+    size_t i = 0;
+    while (i < job->count) {
+        if (!job->flags[i]) {
+            i++;
+            continue;
+        }
+        size_t run = i;
+        while (run < job->count && job->flags[run]) {
+            run++;
+        }
+        memcpy(out, job->data + i * stride, (run - i) * stride);
+        out += (run - i) * stride;
+        i = run;
+    }
+}
+
+void* vf_da_parallel_filter(const void* da_data, bool (*keep)(const void* element, void* user), void* user,
+                            vf_threadpool_t* pool) {
+    size_t count = vf_da_count(da_data);
+    size_t stride = vf_da_stride(da_data);
+    size_t job_count = _vf_da_job_count(pool, count);
+
+    _vf_da_job_t* jobs = (_vf_da_job_t*)malloc(job_count * sizeof(_vf_da_job_t));
+    uint8_t* flags = (uint8_t*)malloc(count ? count : 1);
+    if (jobs == NULL || flags == NULL) {
+        free(jobs);
+        free(flags);
+        return NULL;
+    }
+
+    _vf_da_parallel_t context;
+    memset(&context, 0, sizeof(context));
+    context.stride = stride;
+    context.keep = keep;
+    context.user = user;
+
+    _vf_da_split(jobs, job_count, &context, (uint8_t*)da_data, count);
+    for (size_t j = 0; j < job_count; ++j) {
+        jobs[j].flags = flags + jobs[j].first;
+    }
+    _vf_da_run_jobs(_vf_da_filter_mark_task, jobs, job_count, pool);
+
+    // Exclusive prefix sum: where each chunk's kept elements start
+    size_t total = 0;
+    for (size_t j = 0; j < job_count; ++j) {
+        size_t kept = jobs[j].kept;
+        jobs[j].kept = total;
+        total += kept;
+    }
+
+    uint8_t* result = (uint8_t*)vf_da_alloc_exact(total, stride);
+    if (result != NULL) {
+        for (size_t j = 0; j < job_count; ++j) {
+            jobs[j].out = result;
+        }
+        _vf_da_run_jobs(_vf_da_filter_copy_task, jobs, job_count, pool);
+        _vf_da_header_set(result, DA_COUNT, total);
+    }
+
+    free(jobs);
+    free(flags);
+    return result;
+}
+
+static void _vf_da_for_each_task(void* arg) {
+    _vf_da_job_t* job = (_vf_da_job_t*)arg;
+    job->context->for_each(job->data, job->count, job->first, job->context->user);
+}
+
+void vf_da_parallel_for_each(void* da_data, void (*fn)(void* elements, size_t count, size_t first, void* user),
+                             void* user, vf_threadpool_t* pool) {
+    size_t count = vf_da_count(da_data);
+    _vf_da_parallel_t context;
+    memset(&context, 0, sizeof(context));
+    context.stride = vf_da_stride(da_data);
+    context.for_each = fn;
+    context.user = user;
+
+    _vf_da_job_t single;
+    size_t job_count = _vf_da_job_count(pool, count);
+    _vf_da_job_t* jobs = (job_count > 1) ? (_vf_da_job_t*)malloc(job_count * sizeof(_vf_da_job_t)) : NULL;
+    if (jobs == NULL) {
+        jobs = &single;
+        job_count = 1;
+    }
+
+    _vf_da_split(jobs, job_count, &context, (uint8_t*)da_data, count);
+    _vf_da_run_jobs(_vf_da_for_each_task, jobs, job_count, pool);
+
+    if (jobs != &single) {
+        free(jobs);
+    }
+}
+
+static void _vf_da_map_task(void* arg) {
+    _vf_da_job_t* job = (_vf_da_job_t*)arg;
+    const _vf_da_parallel_t* context = job->context;
+    context->map(job->data, job->out + job->first * context->out_stride, job->count, job->first, context->user);
+}
+
+void* vf_da_parallel_map(const void* da_data, size_t stride,
+                         void (*fn)(const void* in, void* out, size_t count, size_t first, void* user),
+                         void* user, vf_threadpool_t* pool) {
+    size_t count = vf_da_count(da_data);
+    uint8_t* result = (uint8_t*)vf_da_alloc_exact(count, stride);
+    size_t job_count = _vf_da_job_count(pool, count);
+    _vf_da_job_t* jobs = (_vf_da_job_t*)malloc(job_count * sizeof(_vf_da_job_t));
+    if (result == NULL || jobs == NULL) {
+        if (result != NULL) {
+            vf_da_free(result);
+        }
+        free(jobs);
+        return NULL;
+    }
+
+    _vf_da_parallel_t context;
+    memset(&context, 0, sizeof(context));
+    context.stride = vf_da_stride(da_data);
+    context.out_stride = stride;
+    context.map = fn;
+    context.user = user;
+
+    _vf_da_split(jobs, job_count, &context, (uint8_t*)da_data, count);
+    for (size_t j = 0; j < job_count; ++j) {
+        jobs[j].out = result;
+    }
+    _vf_da_run_jobs(_vf_da_map_task, jobs, job_count, pool);
+    _vf_da_header_set(result, DA_COUNT, count);
+
+    free(jobs);
+    return result;
+}
+#endif // VF_DARRAY_ENABLE_PARALLEL
+
 void vf_da_swap(void* da_data, size_t index_a, size_t index_b) {
     size_t* header = (size_t*)da_data - DA_HEADER_LENGTH;
     _vf_memswap((uint8_t*)da_data + (header[DA_STRIDE] * index_a),
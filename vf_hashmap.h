@@ -1,9 +1,70 @@
 /*
-*   vf_hashmap - v0.2
-*   Header-only tiny hashmap library using 64-bit FNV-1a hash
+*   vf_hashmap - v0.43
+*   Header-only tiny hashmap library using a word-at-a-time 64-bit hash
 *   and open addressing with linear probing to handle collisions.
 *
+*   The hash can be swapped per map through `vf_hashmap_config_t`, or the
+*   built-in one switched back to byte-wise FNV-1a with VF_HASHMAP_HASH_FNV1A.
+*
+*   Define VF_HASHMAP_SWISS_TABLE before including (in every translation
+*   unit) to switch to a swiss-table style layout: a control byte per slot
+*   holding a 7-bit fragment of the hash, probed 16 slots at a time with
+*   SSE2/NEON compares. The public API stays the same in both modes.
+*
+*   Define VF_HASHMAP_ROBIN_HOOD instead to keep linear probing but insert
+*   Robin Hood style: a new key takes the slot of any entry that sits closer
+*   to its home slot, so probe lengths even out, and lookups of missing keys
+*   stop as soon as they pass where the key would have been.
+*   `vf_hashmap_stats` reports the probe lengths in any mode.
+*
+*   Define VF_HASHMAP_ENABLE_CONCURRENT to also get `vf_hashmap_sharded_t`, a
+*   thread-safe map split into shards, each behind its own read-write lock.
+*   For tables that are read far more often than written it also provides
+*   `vf_hashmap_rcu_t`, where readers never lock and writers publish copies.
+*   It pulls in vf_thread.h and vf_threadpool.h, whose implementations must be
+*   compiled somewhere (VF_THREAD_IMPLEMENTATION, VF_THREADPOOL_IMPLEMENTATION),
+*   and needs -lpthread outside of Windows.
+*
 *   RECENT CHANGES:
+*       0.43    (2026-10-16)    Added VF_HASHMAP_ROBIN_HOOD compile-time mode;
+*                               Added `vf_hashmap_stats`: probe-length histogram, mean and
+*                               max displacement, tombstones;
+*       0.42    (2026-10-16)    Added `vf_hashmap_freeze`: a read-only copy of a map laid out with a
+*                               minimal perfect hash (PTHash-style pilots per bucket), so every
+*                               lookup goes to exactly one slot and ~1% of the slots are empty;
+*       0.41    (2026-10-16)    Added `vf_hashmap_save`/`vf_hashmap_open_mmap`: the table is written
+*                               as it sits in memory and mapped back read-only, so loading
+*                               is an mmap and a header check;
+*       0.4     (2026-10-16)    Added `vf_hashmap_iter_t` to walk the entries in slot order;
+*                               Added `vf_hashmap_get_batch`/`_get_batch_keyed`, which hash a
+*                               batch of keys first and prefetch their slots before probing;
+*       0.39    (2026-10-16)    Added `vf_hashmap_reserve` and bulk `vf_hashmap_build`/`_build_keyed`,
+*                               which size the table and key arena once, hash all keys up
+*                               front (optionally on a vf_threadpool) and prefetch slots;
+*       0.38    (2026-10-16)    Added incremental resizing (`incremental_resize` in the config):
+*                               the old table is kept and drained a few slots per write,
+*                               so no single insert pays for rehashing the whole map;
+*       0.37    (2026-10-16)    Added `vf_hashmap_rcu_t`: lock-free readers on an immutable
+*                               snapshot, writers publish a modified copy and free the old
+*                               one once no reader can still see it;
+*                               Added `vf_hashmap_clone`;
+*       0.36    (2026-10-16)    Added `vf_hashmap_sharded_t` behind VF_HASHMAP_ENABLE_CONCURRENT:
+*                               shards picked by the high hash bits, one rwlock per shard;
+*       0.35    (2026-10-16)    Added fixed-size binary keys (`vf_hashmap_create_keyed`,
+*                               `_key` and `_u64` entry points) compared with word loads;
+*       0.34    (2026-10-16)    Default hash is now a wyhash-style word-at-a-time mixer;
+*                               Added `vf_hashmap_config_t` with a user hash callback and seed;
+*                               Added `_n` entry points taking keys with an explicit length;
+*       0.33    (2026-10-16)    Fixed `_remove` breaking probe chains: linear mode uses
+*                               backward-shift deletion, swiss mode only leaves a tombstone
+*                               when the group is full and compacts them away under churn;
+*       0.32    (2026-10-16)    Values live in one slab parallel to the slots and short keys
+*                               are stored inline, longer ones in a shared key arena;
+*                               No more allocations per entry;
+*       0.31    (2026-10-16)    Entries cache their full 64-bit hash: resizes never rehash
+*                               keys and probes compare hashes before strings;
+*       0.3     (2026-10-16)    Added VF_HASHMAP_SWISS_TABLE compile-time mode;
+*                               Lookups go through a single `_hashmap_find`;
 *       0.2     (2024-07-31)    Added _has(key) function to check if a key exists;
                                 Changed _get to return immutable, and added _get_mutable;
                                 Renamed _insert to _set;
@@ -44,36 +105,353 @@
 #ifndef VF_HASHMAP_H
 #define VF_HASHMAP_H
 
+#ifdef VF_HASHMAP_ENABLE_CONCURRENT
+#    include "vf_thread.h"
+#    include "vf_threadpool.h"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
+
+#if defined(VF_HASHMAP_ROBIN_HOOD) && defined(VF_HASHMAP_SWISS_TABLE)
+#    error "VF_HASHMAP_ROBIN_HOOD only applies to the linear probing layout"
+#endif
 
 #define VF_HASH_INITIAL_CAPACITY 16
 #define VF_HASH_LOAD_FACTOR 0.75
 
+// Number of control bytes inspected at once in swiss-table mode.
+// Capacity is always a power of two and at least one group wide.
+#define VF_HASH_GROUP_WIDTH 16
+
+// Keys up to this many bytes are stored inside the entry itself.
+#define VF_HASH_INLINE_KEY_SIZE 16
+
+// Old-table slots moved per write while an incremental resize is in progress.
+// Must be at least 2 so the old table is drained before the new one fills up.
+// NOTE: The drained table is still freed in one go, which for big tables
+// (the OS unmapping its pages) is the longest remaining pause.
+#define VF_HASH_MIGRATE_STEP 16
+
 typedef struct {
-    char* key;
-    void* value;
+    uint64_t hash;          // Full hash of the key, cached so it is computed once per key
+    uint32_t key_length;
+    uint32_t used;          // Non-zero if the slot holds a live entry
+    union {
+        char inline_key[VF_HASH_INLINE_KEY_SIZE];
+        uint64_t offset;    // Offset into the map's key arena for longer keys
+    } key;
 } vf_hashmap_entry_t;
 
+// Hash callback: must return the same hash for the same bytes and seed.
+typedef uint64_t (*vf_hashmap_hash_fn)(const void* key, size_t length, uint64_t seed);
+
+typedef struct {
+    size_t value_size;
+    size_t key_size;            // 0 for variable-length (string) keys, else the size of every key
+    vf_hashmap_hash_fn hash_fn; // NULL selects the built-in hash
+    uint64_t seed;
+    int incremental_resize;     // Non-zero spreads each resize over the writes that follow it
+} vf_hashmap_config_t;
+
 typedef struct {
     vf_hashmap_entry_t* entries;
+    uint8_t* values;        // `value_size` bytes per slot, indexed like `entries`
+    char* keys;             // Arena for keys longer than VF_HASH_INLINE_KEY_SIZE
+    size_t keys_size;
+    size_t keys_capacity;
+    size_t keys_garbage;    // Arena bytes still held by removed keys
+#ifdef VF_HASHMAP_SWISS_TABLE
+    // One control byte per slot: empty, deleted or the low 7 bits of the hash.
+    uint8_t* ctrl;
+    size_t deleted;
+#endif
     size_t capacity;
-    size_t size;
+    size_t size;            // Live entries in both tables during an incremental resize
     size_t value_size;
+    size_t key_size;
+    vf_hashmap_hash_fn hash_fn;
+    uint64_t seed;
+    // Incremental resize: the previous table, still searched by lookups,
+    // is moved into the current one VF_HASH_MIGRATE_STEP slots per write.
+    vf_hashmap_entry_t* old_entries;
+    uint8_t* old_values;
+#ifdef VF_HASHMAP_SWISS_TABLE
+    uint8_t* old_ctrl;
+#endif
+    size_t old_capacity;    // 0 when no resize is in progress
+    size_t migrated;        // Old slots below this index have been moved
+    int incremental;
+    // Set for maps returned by `vf_hashmap_open_mmap`, whose arrays all point
+    // into this read-only mapping of the file.
+    void* mapping;
+    size_t mapping_size;
 } vf_hashmap_t;
 
 extern vf_hashmap_t* vf_hashmap_create(size_t value_size);
+extern vf_hashmap_t* vf_hashmap_create_with_config(const vf_hashmap_config_t* config);
 extern void vf_hashmap_free(vf_hashmap_t* map);
 extern int vf_hashmap_set(vf_hashmap_t* map, const char* key, void* value);
 extern int vf_hashmap_has(vf_hashmap_t* map, const char* key);
 extern const void* vf_hashmap_get(vf_hashmap_t* map, const char* key);
+// NOTE: Values live in a slab owned by the map, so the returned pointer is
+// only valid until the next call that inserts into or removes from the map.
 extern void* vf_hashmap_get_mutable(vf_hashmap_t* map, const char* key);
 extern void vf_hashmap_remove(vf_hashmap_t* map, const char* key);
 extern size_t vf_hashmap_size(vf_hashmap_t* map);
 extern size_t vf_hashmap_capacity(vf_hashmap_t* map);
+// Deep copy with the same capacity and settings. NULL if out of memory.
+extern vf_hashmap_t* vf_hashmap_clone(const vf_hashmap_t* map);
+// Grows the table so that `count` entries in total fit without another resize.
+extern int vf_hashmap_reserve(vf_hashmap_t* map, size_t count);
+
+// Creates a map from `count` keys and their values, packed `value_size` bytes
+// apart in `values`. The table is sized once, all keys are hashed before any
+// is inserted, and inserts skip the resize checks. Later duplicates overwrite
+// earlier ones. Key `i` is `keys[i]`, `lengths[i]` bytes long, or zero
+// terminated when `lengths` is NULL. NULL if out of memory.
+extern vf_hashmap_t* vf_hashmap_build(const vf_hashmap_config_t* config, const char* const* keys,
+                                      const size_t* lengths, const void* values, size_t count);
+// Same for fixed-size keys, packed `key_size` bytes apart in `keys`.
+extern vf_hashmap_t* vf_hashmap_build_keyed(const vf_hashmap_config_t* config, const void* keys,
+                                            const void* values, size_t count);
+
+// Same as above, but the key is `length` bytes and does not need a terminating zero.
+extern int vf_hashmap_set_n(vf_hashmap_t* map, const char* key, size_t length, void* value);
+extern int vf_hashmap_has_n(vf_hashmap_t* map, const char* key, size_t length);
+extern const void* vf_hashmap_get_n(vf_hashmap_t* map, const char* key, size_t length);
+extern void* vf_hashmap_get_mutable_n(vf_hashmap_t* map, const char* key, size_t length);
+extern void vf_hashmap_remove_n(vf_hashmap_t* map, const char* key, size_t length);
+
+// Maps with fixed-size binary keys, e.g. integer ids or GUIDs. Keys of up to
+// VF_HASH_INLINE_KEY_SIZE bytes are never copied out of the entry, and 4, 8
+// and 16 byte keys are compared with word loads instead of `memcmp`.
+// The `_key` functions read `key_size` bytes from `key`.
+extern vf_hashmap_t* vf_hashmap_create_keyed(size_t key_size, size_t value_size);
+extern int vf_hashmap_set_key(vf_hashmap_t* map, const void* key, void* value);
+extern int vf_hashmap_has_key(vf_hashmap_t* map, const void* key);
+extern const void* vf_hashmap_get_key(vf_hashmap_t* map, const void* key);
+extern void* vf_hashmap_get_mutable_key(vf_hashmap_t* map, const void* key);
+extern void vf_hashmap_remove_key(vf_hashmap_t* map, const void* key);
+
+// Shorthands for maps created with a `key_size` of 8.
+extern int vf_hashmap_set_u64(vf_hashmap_t* map, uint64_t key, void* value);
+extern int vf_hashmap_has_u64(vf_hashmap_t* map, uint64_t key);
+extern const void* vf_hashmap_get_u64(vf_hashmap_t* map, uint64_t key);
+extern void* vf_hashmap_get_mutable_u64(vf_hashmap_t* map, uint64_t key);
+extern void vf_hashmap_remove_u64(vf_hashmap_t* map, uint64_t key);
+
+// Iterates over the entries in slot order:
+//
+//     vf_hashmap_iter_t it = vf_hashmap_iter(map);
+//     while (vf_hashmap_next(&it)) { use it.key, it.key_length, it.value }
+//
+// The order only changes when entries are inserted or removed, and doing
+// either during the walk invalidates the iterator. Values may be modified,
+// except in maps from `vf_hashmap_open_mmap`, where `value` is NULL just as
+// `_get_mutable` returns NULL there; read those through `vf_hashmap_get`.
+typedef struct {
+    vf_hashmap_t* map;
+    size_t slot;            // Next slot to look at; the old table follows the current one
+    const void* key;
+    size_t key_length;
+    void* value;            // NULL in mapped maps
+} vf_hashmap_iter_t;
+
+extern vf_hashmap_iter_t vf_hashmap_iter(vf_hashmap_t* map);
+// Moves to the next entry and returns 1, or returns 0 when there are no more.
+extern int vf_hashmap_next(vf_hashmap_iter_t* it);
+
+// Looks up `count` keys at once, storing a pointer to each value, or NULL,
+// in `out`. Keys are hashed in groups and their slots prefetched before any
+// is probed, so cache misses overlap instead of following one another.
+// Key `i` is `keys[i]`, `lengths[i]` bytes long, or zero terminated when
+// `lengths` is NULL. Returns the number of keys found.
+extern size_t vf_hashmap_get_batch(vf_hashmap_t* map, const char* const* keys, const size_t* lengths,
+                                   size_t count, const void** out);
+// Same for fixed-size keys, packed `key_size` bytes apart in `keys`.
+extern size_t vf_hashmap_get_batch_keyed(vf_hashmap_t* map, const void* keys, size_t count, const void** out);
+
+// Writes the map to `path` exactly as its arrays sit in memory: header, slots,
+// (control bytes,) values and key arena, each 64-byte aligned. Keys refer to
+// the arena by offset, so the file needs no fixing up when mapped back.
+// A pending incremental resize is finished and the key arena compacted first.
+// Files only open with the same layout (linear or swiss), hash and byte
+// order they were written with. Returns 0 on success, -1 on failure.
+extern int vf_hashmap_save(vf_hashmap_t* map, const char* path);
+// Maps a file written by `vf_hashmap_save` read-only; only the header is
+// checked, and pages are read in as lookups touch them. `hash_fn` must be
+// the hash the map was saved with, NULL for the built-in one.
+// get/has/batches work as usual, while set and remove fail, `_get_mutable`
+// returns NULL and iteration gives the keys with a NULL `value`.
+// `vf_hashmap_clone` gives a writable copy and `vf_hashmap_free` unmaps the
+// file. NULL if the file is missing or does not match.
+// NOTE: Outside of POSIX systems the file is read into memory instead.
+extern vf_hashmap_t* vf_hashmap_open_mmap(const char* path, vf_hashmap_hash_fn hash_fn);
+
+// Read-only copy of a map where every key has a slot of its own: keys are
+// spread over buckets, and each bucket stores a pilot value that, mixed into
+// the hash of its keys, sends them to slots no other key uses. A lookup reads
+// one pilot and one slot, which holds the entry next to its value, and no
+// probing is done. About 1% of the slots are left empty.
+typedef struct {
+    uint8_t* slots;         // `slot_stride` bytes per slot: the entry, then its value
+    uint32_t* pilots;       // One per bucket
+    size_t slot_count;
+    size_t slot_stride;
+    size_t bucket_count;
+    size_t size;
+    vf_hashmap_t hasher;    // Hash settings and the arena of the long keys
+} vf_hashmap_frozen_t;
+
+// Average keys per bucket in frozen maps. Larger buckets take less memory
+// for pilots but longer to freeze.
+#define VF_HASH_FROZEN_BUCKET_SIZE 4
+// Slots per key in frozen maps is 1 / VF_HASH_FROZEN_LOAD. The last few
+// buckets find their slots much faster with some left free.
+#define VF_HASH_FROZEN_LOAD 0.99
+
+// Builds the frozen copy of `map`, which is left unchanged and can be freed.
+// Lookups hash keys the way `map` does. NULL if out of memory, if the map needs
+// more than UINT32_MAX slots, or if no pilot can place the keys of a bucket:
+// in practice only when keys share their full 64-bit hash, which takes a poor
+// custom hash. Weak but distinct hashes such as FNV-1a are remixed first.
+extern vf_hashmap_frozen_t* vf_hashmap_freeze(const vf_hashmap_t* map);
+extern void vf_hashmap_frozen_free(vf_hashmap_frozen_t* map);
+extern const void* vf_hashmap_frozen_get(const vf_hashmap_frozen_t* map, const char* key);
+extern const void* vf_hashmap_frozen_get_n(const vf_hashmap_frozen_t* map, const char* key, size_t length);
+extern const void* vf_hashmap_frozen_get_key(const vf_hashmap_frozen_t* map, const void* key);
+extern const void* vf_hashmap_frozen_get_u64(const vf_hashmap_frozen_t* map, uint64_t key);
+extern int vf_hashmap_frozen_has(const vf_hashmap_frozen_t* map, const char* key);
+extern int vf_hashmap_frozen_has_n(const vf_hashmap_frozen_t* map, const char* key, size_t length);
+extern int vf_hashmap_frozen_has_key(const vf_hashmap_frozen_t* map, const void* key);
+extern int vf_hashmap_frozen_has_u64(const vf_hashmap_frozen_t* map, uint64_t key);
+extern size_t vf_hashmap_frozen_size(const vf_hashmap_frozen_t* map);
+
+// Buckets in `vf_hashmap_stats_t.histogram`.
+#define VF_HASH_STATS_BUCKETS 32
+
+// How far entries sit from their home slot (linear) or home group (swiss),
+// i.e. how many extra slots or groups a lookup of each key inspects.
+typedef struct {
+    size_t size;
+    size_t capacity;
+    size_t max_displacement;
+    double mean_displacement;
+    // Entries by displacement; the last bucket also counts everything further out
+    size_t histogram[VF_HASH_STATS_BUCKETS];
+    size_t tombstones;      // Deleted markers in swiss mode, 0 otherwise
+} vf_hashmap_stats_t;
+
+// Walks the whole table, so meant for monitoring rather than hot paths.
+extern vf_hashmap_stats_t vf_hashmap_stats(const vf_hashmap_t* map);
+
+// Built-in hash functions, usable as `vf_hashmap_config_t.hash_fn`.
+extern uint64_t vf_hashmap_hash_bytes(const void* key, size_t length, uint64_t seed);
+extern uint64_t vf_hashmap_hash_fnv1a(const void* key, size_t length, uint64_t seed);
+
+#ifdef VF_HASHMAP_ENABLE_CONCURRENT
+// Shard count used when 0 is passed to `vf_hashmap_sharded_create`.
+#define VF_HASH_DEFAULT_SHARDS 64
+
+typedef struct {
+    vf_rwlock_t lock;
+    vf_hashmap_t* map;
+    // Keeps each lock off the cache line of its neighbour's
+    char padding[64];
+} vf_hashmap_shard_t;
+
+typedef struct {
+    vf_hashmap_shard_t* shards;
+    size_t shard_count;     // Always a power of two
+    unsigned shard_bits;    // log2(shard_count); the shard is the top bits of the hash
+    vf_hashmap_t hasher;    // Holds the hash settings only, read without locking
+} vf_hashmap_sharded_t;
+
+// Thread-safe map: every function may be called from any thread at the same
+// time. Readers of one shard run in parallel, writers only block their shard.
+// Values are copied in and out, as pointers into a shard would not survive
+// a concurrent insert. `shard_count` is rounded up to a power of two.
+extern vf_hashmap_sharded_t* vf_hashmap_sharded_create(const vf_hashmap_config_t* config, size_t shard_count);
+extern void vf_hashmap_sharded_free(vf_hashmap_sharded_t* map);
+extern int vf_hashmap_sharded_set(vf_hashmap_sharded_t* map, const char* key, const void* value);
+extern int vf_hashmap_sharded_set_n(vf_hashmap_sharded_t* map, const void* key, size_t length, const void* value);
+// Copies the value into `out` and returns 1 if `key` is present, else returns 0.
+extern int vf_hashmap_sharded_get(vf_hashmap_sharded_t* map, const char* key, void* out);
+extern int vf_hashmap_sharded_get_n(vf_hashmap_sharded_t* map, const void* key, size_t length, void* out);
+extern int vf_hashmap_sharded_has(vf_hashmap_sharded_t* map, const char* key);
+extern int vf_hashmap_sharded_has_n(vf_hashmap_sharded_t* map, const void* key, size_t length);
+extern void vf_hashmap_sharded_remove(vf_hashmap_sharded_t* map, const char* key);
+extern void vf_hashmap_sharded_remove_n(vf_hashmap_sharded_t* map, const void* key, size_t length);
+// NOTE: Shards are counted one after another, so with concurrent writers
+// the result is only a snapshot of each shard, not of the whole map.
+extern size_t vf_hashmap_sharded_size(vf_hashmap_sharded_t* map);
+
+// Same as `vf_hashmap_build`/`_build_keyed`, with the keys hashed in chunks on
+// `pool`. Inserting stays on the calling thread, as slots are claimed in order.
+// NOTE: The chunks are waited for with vf_threadpool_wait, which waits for the
+// whole pool, so other work queued on it is waited for as well, and calling
+// these from a task running on `pool` deadlocks.
+extern vf_hashmap_t* vf_hashmap_build_parallel(const vf_hashmap_config_t* config, const char* const* keys,
+                                               const size_t* lengths, const void* values, size_t count,
+                                               vf_threadpool_t* pool);
+extern vf_hashmap_t* vf_hashmap_build_keyed_parallel(const vf_hashmap_config_t* config, const void* keys,
+                                                     const void* values, size_t count, vf_threadpool_t* pool);
+
+// Reader counters are spread over this many cache lines per epoch, picked
+// by the address of the caller's `vf_hashmap_rcu_reader_t`.
+#define VF_HASH_RCU_READER_SLOTS 16
+
+typedef struct {
+    volatile uint64_t count;
+    char padding[56];
+} vf_hashmap_rcu_slot_t;
+
+typedef struct {
+    volatile uint64_t* count;   // The counter this reader registered in
+} vf_hashmap_rcu_reader_t;
+
+typedef struct {
+    vf_hashmap_t* volatile current;     // Published snapshot, never modified once published
+    volatile uint64_t epoch;
+    vf_hashmap_rcu_slot_t readers[2][VF_HASH_RCU_READER_SLOTS];  // Indexed by epoch parity
+    vf_mutex_t write_lock;              // Serializes writers only
+} vf_hashmap_rcu_t;
+
+// Read-mostly map. Readers take no lock: they register in a counter for the
+// current epoch and get the published snapshot, which stays valid until they
+// are done with it. Each write copies the table, so writes cost O(n); batch
+// them between `_write_begin` and `_write_commit`.
+extern vf_hashmap_rcu_t* vf_hashmap_rcu_create(const vf_hashmap_config_t* config);
+extern void vf_hashmap_rcu_free(vf_hashmap_rcu_t* rcu);
+
+// The returned snapshot may be used with the read-only vf_hashmap functions
+// (`_get`, `_has`, ...) until `_read_end`, and must not be modified.
+// NOTE: Writers wait for readers of older snapshots, so keep reads short.
+extern vf_hashmap_t* vf_hashmap_rcu_read_begin(vf_hashmap_rcu_t* rcu, vf_hashmap_rcu_reader_t* reader);
+extern void vf_hashmap_rcu_read_end(vf_hashmap_rcu_t* rcu, vf_hashmap_rcu_reader_t* reader);
+// Copies the value into `out` and returns 1 if `key` is present, else returns 0.
+extern int vf_hashmap_rcu_get(vf_hashmap_rcu_t* rcu, const char* key, void* out);
+extern int vf_hashmap_rcu_get_n(vf_hashmap_rcu_t* rcu, const void* key, size_t length, void* out);
+extern int vf_hashmap_rcu_has(vf_hashmap_rcu_t* rcu, const char* key);
+extern int vf_hashmap_rcu_has_n(vf_hashmap_rcu_t* rcu, const void* key, size_t length);
+
+// Locks out other writers and returns a private copy of the current table to
+// modify with the regular vf_hashmap functions. Commit publishes it, abort
+// drops it; either one releases the write lock. NULL if out of memory.
+extern vf_hashmap_t* vf_hashmap_rcu_write_begin(vf_hashmap_rcu_t* rcu);
+extern void vf_hashmap_rcu_write_commit(vf_hashmap_rcu_t* rcu, vf_hashmap_t* map);
+extern void vf_hashmap_rcu_write_abort(vf_hashmap_rcu_t* rcu, vf_hashmap_t* map);
+// Single writes, each one a whole begin/commit.
+extern int vf_hashmap_rcu_set(vf_hashmap_rcu_t* rcu, const char* key, const void* value);
+extern int vf_hashmap_rcu_set_n(vf_hashmap_rcu_t* rcu, const void* key, size_t length, const void* value);
+extern void vf_hashmap_rcu_remove(vf_hashmap_rcu_t* rcu, const char* key);
+extern void vf_hashmap_rcu_remove_n(vf_hashmap_rcu_t* rcu, const void* key, size_t length);
+#endif // VF_HASHMAP_ENABLE_CONCURRENT
 
 #ifdef __cplusplus
 }
@@ -85,174 +463,1991 @@ extern size_t vf_hashmap_capacity(vf_hashmap_t* map);
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <fcntl.h>
+#    include <unistd.h>
+#    define VF_HASHMAP_MMAP
+#endif
+
+#ifdef VF_HASHMAP_SWISS_TABLE
+#    if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#        include <emmintrin.h>
+#        define VF_HASHMAP_SSE2
+#    elif defined(__ARM_NEON) && defined(__aarch64__)
+#        include <arm_neon.h>
+#        define VF_HASHMAP_NEON
+#    endif
+#endif
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+// Returned by `_hashmap_find` when the key is not in the map.
+#define _VF_HASH_NPOS ((size_t)-1)
+
+// 64x64 -> 128-bit multiply, low half returned in `a` and high half in `b`.
+static inline void _hashmap_mum(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+static inline uint64_t _hashmap_mix(uint64_t a, uint64_t b) {
+    _hashmap_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t _hashmap_read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t _hashmap_read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// wyhash-style hash: reads 8 bytes at a time (16 or 48 per round) and mixes them
+// with 128-bit multiplies, so every output bit depends on every input bit.
+// Keys of up to 16 bytes take a branchy path with overlapping reads and no loop.
+uint64_t vf_hashmap_hash_bytes(const void* key, size_t length, uint64_t seed) {
+    static const uint64_t s0 = 0xa0761d6478bd642fULL, s1 = 0xe7037ed1a0b428dbULL,
+                          s2 = 0x8ebc6af09c88c6e3ULL, s3 = 0x589965cc75374cc3ULL;
+    const uint8_t* p = (const uint8_t*)key;
+    uint64_t a, b;
+
+    seed ^= _hashmap_mix(seed ^ s0, s1);
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t middle = (length >> 3) << 2;
+            a = (_hashmap_read32(p) << 32) | _hashmap_read32(p + middle);
+            b = (_hashmap_read32(p + length - 4) << 32) | _hashmap_read32(p + length - 4 - middle);
+        } else if (length > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = length;
+        if (i > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = _hashmap_mix(_hashmap_read64(p) ^ s1, _hashmap_read64(p + 8) ^ seed);
+                seed1 = _hashmap_mix(_hashmap_read64(p + 16) ^ s2, _hashmap_read64(p + 24) ^ seed1);
+                seed2 = _hashmap_mix(_hashmap_read64(p + 32) ^ s3, _hashmap_read64(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = _hashmap_mix(_hashmap_read64(p) ^ s1, _hashmap_read64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        // The last 16 bytes, overlapping the previous round if needed
+        a = _hashmap_read64(p + i - 16);
+        b = _hashmap_read64(p + i - 8);
+    }
+
+    a ^= s1;
+    b ^= seed;
+    _hashmap_mum(&a, &b);
+    return _hashmap_mix(a ^ s0 ^ length, b ^ s1);
+}
 
 // FNV-1a 64-bit hash function
-static uint64_t _hash_key(const char* key) {
-    uint64_t hash = 14695981039346656037ULL;    // FNV offset (64-bit)
-    for (const char* p = key; *p; p++) {
-        hash ^= (uint64_t)(unsigned char)(*p);
-        hash *= 1099511628211ULL;               // FNV prime
+uint64_t vf_hashmap_hash_fnv1a(const void* key, size_t length, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*)key;
+    uint64_t hash = 14695981039346656037ULL ^ seed;    // FNV offset (64-bit)
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint64_t)p[i];
+        hash *= 1099511628211ULL;                       // FNV prime
     }
     return hash;
 }
 
-static int _hashmap_set_entry(vf_hashmap_t* map, vf_hashmap_entry_t* entries, size_t capacity, const char* key, void* value, size_t* plength) {
-    uint64_t hash = _hash_key(key);
-    size_t index = (size_t)(hash & (uint64_t)(capacity - 1));
-
-    while (entries[index].key != NULL) {
-        if (strcmp(key, entries[index].key) == 0) {
-            // Update existing entry
-            memcpy(entries[index].value, value, map->value_size);
-            return 0;
-        }
-        index++;
-        if (index >= capacity) index = 0;
+static inline uint64_t _hashmap_hash(const vf_hashmap_t* map, const void* key, size_t length) {
+    // The built-in hash is called directly so it can be inlined
+    if (map->hash_fn) return map->hash_fn(key, length, map->seed);
+#ifndef VF_HASHMAP_HASH_FNV1A
+    // Word-sized keys skip the length dispatch and take a single multiply
+    if (map->key_size == 8) {
+        const uint8_t* p = (const uint8_t*)key;
+        return _hashmap_mix(_hashmap_read64(p) ^ 0xe7037ed1a0b428dbULL, map->seed ^ 0xa0761d6478bd642fULL);
     }
+#endif
+#ifdef VF_HASHMAP_HASH_FNV1A
+    return vf_hashmap_hash_fnv1a(key, length, map->seed);
+#else
+    return vf_hashmap_hash_bytes(key, length, map->seed);
+#endif
+}
+
+static inline const char* _hashmap_entry_key(const vf_hashmap_t* map, const vf_hashmap_entry_t* entry) {
+    return (entry->key_length <= VF_HASH_INLINE_KEY_SIZE) ? entry->key.inline_key : map->keys + entry->key.offset;
+}
+
+// Indexes at or past `capacity` refer to the old table of an incremental resize.
+static inline void* _hashmap_value(const vf_hashmap_t* map, size_t index) {
+    if (index >= map->capacity) return map->old_values + (index - map->capacity) * map->value_size;
+    return map->values + index * map->value_size;
+}
+
+static inline int _hashmap_key_equals(const vf_hashmap_t* map, const vf_hashmap_entry_t* entry, const void* key, size_t length, uint64_t hash) {
+    if (entry->hash != hash) return 0;
 
-    if (plength != NULL) {
-        key = strdup(key);
-        if (key == NULL) return -1;
-        (*plength)++;
+    // Fixed-size keys of these sizes are always inline and compared as words.
+    // Callers checked that `length` is the key size, and a constant one lets
+    // the other cases fold away.
+    const uint8_t* a = (const uint8_t*)entry->key.inline_key;
+    const uint8_t* b = (const uint8_t*)key;
+    switch (map->key_size ? length : 0) {
+        case 4: return _hashmap_read32(a) == _hashmap_read32(b);
+        case 8: return _hashmap_read64(a) == _hashmap_read64(b);
+        case 16: return ((_hashmap_read64(a) ^ _hashmap_read64(b)) | (_hashmap_read64(a + 8) ^ _hashmap_read64(b + 8))) == 0;
+        default: break;
     }
-    entries[index].key = (char*)key;
-    entries[index].value = malloc(map->value_size);
-    if (entries[index].value == NULL) {
-        free((char*)key);
-        return -1;
+
+    return entry->key_length == length &&
+           memcmp(_hashmap_entry_key(map, entry), key, length) == 0;
+}
+
+// Copies the key into the entry, or appends it to the key arena if it is too long.
+static int _hashmap_store_key(vf_hashmap_t* map, vf_hashmap_entry_t* entry, const void* key, size_t length) {
+    if (length > UINT32_MAX) return -1;
+
+    // An offset only covers part of the union, so what a removed key left in
+    // the rest is cleared first and never reaches `vf_hashmap_save`
+    memset(&entry->key, 0, sizeof(entry->key));
+    if (length <= VF_HASH_INLINE_KEY_SIZE) {
+        memcpy(entry->key.inline_key, key, length);
+    } else {
+        // Arena keys keep a terminating zero to stay printable
+        size_t needed = map->keys_size + length + 1;
+        if (needed > map->keys_capacity) {
+            size_t new_capacity = map->keys_capacity ? map->keys_capacity * 2 : 256;
+            while (new_capacity < needed) new_capacity *= 2;
+            char* new_keys = (char*)realloc(map->keys, new_capacity);
+            if (!new_keys) return -1;
+            map->keys = new_keys;
+            map->keys_capacity = new_capacity;
+        }
+        memcpy(map->keys + map->keys_size, key, length);
+        map->keys[map->keys_size + length] = '\0';
+        entry->key.offset = map->keys_size;
+        map->keys_size = needed;
     }
-    memcpy(entries[index].value, value, map->value_size);
-    return 1;
+    entry->key_length = (uint32_t)length;
+
+    return 0;
 }
 
-static int _hashmap_expand(vf_hashmap_t* map) {
-    // Double the capacity
-    // TODO: this could be defined as multiplication number
-    size_t new_capacity = map->capacity * 2;
+static void _hashmap_release_key(vf_hashmap_t* map, const vf_hashmap_entry_t* entry) {
+    if (entry->key_length > VF_HASH_INLINE_KEY_SIZE) {
+        map->keys_garbage += entry->key_length + 1;
+    }
+}
 
-    vf_hashmap_entry_t* new_entries = (vf_hashmap_entry_t*)calloc(new_capacity, sizeof(vf_hashmap_entry_t));
-    if (!new_entries) return -1;
+// Rewrites the key arena without the bytes of removed keys.
+static int _hashmap_compact_keys(vf_hashmap_t* map) {
+    size_t live_size = map->keys_size - map->keys_garbage;
+    char* new_keys = (char*)malloc(live_size ? live_size : 1);
+    if (!new_keys) return -1;
 
+    size_t offset = 0;
     for (size_t i = 0; i < map->capacity; ++i) {
-        vf_hashmap_entry_t entry = map->entries[i];
-        if (entry.key != NULL) {
-            _hashmap_set_entry(map, new_entries, new_capacity, entry.key, entry.value, NULL);
-        }
+        vf_hashmap_entry_t* entry = &map->entries[i];
+        if (!entry->used || entry->key_length <= VF_HASH_INLINE_KEY_SIZE) continue;
+        memcpy(new_keys + offset, map->keys + entry->key.offset, entry->key_length + 1);
+        entry->key.offset = offset;
+        offset += entry->key_length + 1;
     }
 
-    free(map->entries);
-    map->entries = new_entries;
-    map->capacity = new_capacity;
+    free(map->keys);
+    map->keys = new_keys;
+    map->keys_size = offset;
+    map->keys_capacity = live_size ? live_size : 1;
+    map->keys_garbage = 0;
 
     return 0;
 }
 
-vf_hashmap_t* vf_hashmap_create(size_t value_size) {
-    vf_hashmap_t* map = (vf_hashmap_t*)malloc(sizeof(vf_hashmap_t));
-    if (!map) return NULL;
+#ifdef VF_HASHMAP_SWISS_TABLE
 
-    map->entries = (vf_hashmap_entry_t*)calloc(VF_HASH_INITIAL_CAPACITY, sizeof(vf_hashmap_entry_t));
-    if (!map->entries) {
-        free(map);
-        return NULL;
+// Control byte values. A full slot stores the low 7 bits of its hash (h2),
+// so the high bit alone tells "free" (empty or deleted) from "full".
+#define _VF_CTRL_EMPTY   ((uint8_t)0x80)
+#define _VF_CTRL_DELETED ((uint8_t)0xFE)
+
+#define _VF_HASH_H1(hash) ((size_t)((hash) >> 7))
+#define _VF_HASH_H2(hash) ((uint8_t)((hash) & 0x7F))
+
+static inline unsigned _hashmap_ctz(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+#ifdef VF_HASHMAP_NEON
+// NEON has no movemask, so fold each lane into one bit of a 16-bit mask.
+static inline uint32_t _hashmap_neon_mask(uint8x16_t lanes) {
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t masked = vandq_u8(lanes, vld1q_u8(bits));
+    return (uint32_t)vaddv_u8(vget_low_u8(masked)) | ((uint32_t)vaddv_u8(vget_high_u8(masked)) << 8);
+}
+#endif
+
+// Bitmask of the slots in the group whose control byte equals `value`.
+static inline uint32_t _hashmap_group_match(const uint8_t* group, uint8_t value) {
+#if defined(VF_HASHMAP_SSE2)
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)value)));
+#elif defined(VF_HASHMAP_NEON)
+    return _hashmap_neon_mask(vceqq_u8(vld1q_u8(group), vdupq_n_u8(value)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < VF_HASH_GROUP_WIDTH; ++i) {
+        mask |= (uint32_t)(group[i] == value) << i;
     }
+    return mask;
+#endif
+}
 
-    map->capacity = VF_HASH_INITIAL_CAPACITY;
-    map->size = 0;
-    map->value_size = value_size;
+// Bitmask of the slots in the group that are empty or deleted.
+static inline uint32_t _hashmap_group_match_free(const uint8_t* group) {
+#if defined(VF_HASHMAP_SSE2)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#elif defined(VF_HASHMAP_NEON)
+    return _hashmap_neon_mask(vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(group)), vdupq_n_s8(0)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < VF_HASH_GROUP_WIDTH; ++i) {
+        mask |= (uint32_t)(group[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
 
-    return map;
+static size_t _hashmap_probe(const vf_hashmap_t* map, const vf_hashmap_entry_t* entries, const uint8_t* ctrl_bytes,
+                             size_t capacity, const void* key, size_t length, uint64_t hash) {
+    uint8_t h2 = _VF_HASH_H2(hash);
+    size_t group_mask = (capacity / VF_HASH_GROUP_WIDTH) - 1;
+    size_t group = _VF_HASH_H1(hash) & group_mask;
+
+    // Triangular probing over whole groups visits every group once
+    // because the group count is a power of two.
+    for (size_t step = 1;; ++step) {
+        const uint8_t* ctrl = ctrl_bytes + group * VF_HASH_GROUP_WIDTH;
+        uint32_t match = _hashmap_group_match(ctrl, h2);
+        while (match) {
+            size_t index = group * VF_HASH_GROUP_WIDTH + _hashmap_ctz(match);
+            if (_hashmap_key_equals(map, &entries[index], key, length, hash)) {
+                return index;
+            }
+            match &= match - 1;
+        }
+        // An empty slot ends every probe sequence that passes through it.
+        if (_hashmap_group_match(ctrl, _VF_CTRL_EMPTY)) {
+            return _VF_HASH_NPOS;
+        }
+        group = (group + step) & group_mask;
+    }
 }
 
-int vf_hashmap_set(vf_hashmap_t* map, const char* key, void* value) {
-    if (map->size >= map->capacity * VF_HASH_LOAD_FACTOR) {
-        if (_hashmap_expand(map) == -1) return -1;
+// Returns the first empty or deleted slot on the key's probe sequence.
+static size_t _hashmap_find_free(const uint8_t* ctrl, size_t capacity, uint64_t hash) {
+    size_t group_mask = (capacity / VF_HASH_GROUP_WIDTH) - 1;
+    size_t group = _VF_HASH_H1(hash) & group_mask;
+
+    for (size_t step = 1;; ++step) {
+        uint32_t match = _hashmap_group_match_free(ctrl + group * VF_HASH_GROUP_WIDTH);
+        if (match) {
+            return group * VF_HASH_GROUP_WIDTH + _hashmap_ctz(match);
+        }
+        group = (group + step) & group_mask;
     }
+}
 
-    int status = _hashmap_set_entry(map, map->entries, map->capacity, key, value, &map->size);
-    if (status == -1) return -1;
+// Picks the slot for a new key and marks it as taken.
+static size_t _hashmap_claim_slot(vf_hashmap_t* map, uint64_t hash) {
+    size_t index = _hashmap_find_free(map->ctrl, map->capacity, hash);
+    if (map->ctrl[index] == _VF_CTRL_DELETED) map->deleted--;
+    map->ctrl[index] = _VF_HASH_H2(hash);
+    return index;
+}
 
-    return 0;
+static void _hashmap_vacate_slot(vf_hashmap_t* map, size_t index) {
+    // Probes only continue past groups without an empty slot, and a group never
+    // regains one before the next rehash. So if this group still has an empty
+    // slot no probe sequence runs through it and the slot can simply be emptied.
+    // Otherwise leave a tombstone so probe sequences running through it continue.
+    const uint8_t* group = map->ctrl + (index & ~(size_t)(VF_HASH_GROUP_WIDTH - 1));
+    if (_hashmap_group_match(group, _VF_CTRL_EMPTY)) {
+        map->ctrl[index] = _VF_CTRL_EMPTY;
+    } else {
+        map->ctrl[index] = _VF_CTRL_DELETED;
+        map->deleted++;
+    }
+    map->entries[index].used = 0;
 }
 
-int vf_hashmap_has(vf_hashmap_t* map, const char* key) {
-    uint64_t hash = _hash_key(key);
-    size_t index = (size_t)(hash & (uint64_t)(map->capacity - 1));
+// Old-table slots keep probe sequences intact once moved or removed.
+static void _hashmap_retire_old_slot(vf_hashmap_t* map, size_t index) {
+    map->old_ctrl[index] = _VF_CTRL_DELETED;
+    map->old_entries[index].used = 0;
+}
+
+#else
+
+// Old-table slots that were moved or removed are marked with this `used`
+// value, so they still continue probe chains but never match.
+#define _VF_HASH_RETIRED 2
+
+// Slots between an entry's home slot and the one it is stored in.
+static inline size_t _hashmap_displacement(uint64_t hash, size_t index, size_t capacity) {
+    return (index - (size_t)(hash & (uint64_t)(capacity - 1))) & (capacity - 1);
+}
+
+static size_t _hashmap_probe(const vf_hashmap_t* map, const vf_hashmap_entry_t* entries,
+                             size_t capacity, const void* key, size_t length, uint64_t hash) {
+    size_t index = (size_t)(hash & (uint64_t)(capacity - 1));
 
-    while (map->entries[index].key != NULL) {
-        if (strcmp(key, map->entries[index].key) == 0) {
-            return 1;
+#ifdef VF_HASHMAP_ROBIN_HOOD
+    // Chains are ordered by displacement, so reaching an entry closer to its
+    // home than the key would be means the key is not in the table. Retired
+    // old-table slots keep their hash and place, so they still count.
+    for (size_t distance = 0; entries[index].used; ++distance) {
+        if (_hashmap_displacement(entries[index].hash, index, capacity) < distance) break;
+#else
+    while (entries[index].used) {
+#endif
+        if (entries[index].used == 1 && _hashmap_key_equals(map, &entries[index], key, length, hash)) {
+            return index;
         }
         index++;
-        if (index >= map->capacity) index = 0;
+        if (index >= capacity) index = 0;
     }
 
-    return 0;
+    return _VF_HASH_NPOS;
 }
 
-const void* vf_hashmap_get(vf_hashmap_t* map, const char* key) {
-    uint64_t hash = _hash_key(key);
-    size_t index = (size_t)(hash & (uint64_t)(map->capacity - 1));
+#ifdef VF_HASHMAP_ROBIN_HOOD
+// Picks the slot for a new key: just before the first entry of its chain that
+// sits closer to home than the key would there. That entry and the rest of
+// the cluster move one slot on, which is the same as swapping the key down
+// the chain, and leaves the slot free for the caller to fill.
+static size_t _hashmap_claim_slot(vf_hashmap_t* map, uint64_t hash) {
+    size_t mask = map->capacity - 1;
+    size_t index = (size_t)(hash & (uint64_t)mask);
+    for (size_t distance = 0; map->entries[index].used; ++distance) {
+        if (_hashmap_displacement(map->entries[index].hash, index, map->capacity) < distance) break;
+        index = (index + 1) & mask;
+    }
 
-    while (map->entries[index].key != NULL) {
-        if (strcmp(key, map->entries[index].key) == 0) {
-            return map->entries[index].value;
-        }
+    size_t end = index;
+    while (map->entries[end].used) end = (end + 1) & mask;
+    while (end != index) {
+        size_t previous = (end - 1) & mask;
+        map->entries[end] = map->entries[previous];
+        memcpy(map->values + end * map->value_size, map->values + previous * map->value_size, map->value_size);
+        end = previous;
+    }
+    map->entries[index].used = 0;
+
+    return index;
+}
+#else
+// Returns the first free slot at or after the key's home slot.
+static size_t _hashmap_find_free(const vf_hashmap_entry_t* entries, size_t capacity, uint64_t hash) {
+    size_t index = (size_t)(hash & (uint64_t)(capacity - 1));
+    while (entries[index].used) {
         index++;
-        if (index >= map->capacity) index = 0;
+        if (index >= capacity) index = 0;
     }
+    return index;
+}
 
-    return NULL;
+static size_t _hashmap_claim_slot(vf_hashmap_t* map, uint64_t hash) {
+    return _hashmap_find_free(map->entries, map->capacity, hash);
 }
+#endif
 
-void* vf_hashmap_get_mutable(vf_hashmap_t* map, const char* key) {
-    uint64_t hash = _hash_key(key);
-    size_t index = (size_t)(hash & (uint64_t)(map->capacity - 1));
+// Backward-shift deletion: entries after the hole that would be reachable
+// from their home slot through it are moved back, so no tombstones are needed
+// and probe chains stay as short as if the key had never been inserted.
+static void _hashmap_vacate_slot(vf_hashmap_t* map, size_t index) {
+    size_t mask = map->capacity - 1;
+    size_t hole = index;
+    size_t next = (hole + 1) & mask;
 
-    while (map->entries[index].key != NULL) {
-        if (strcmp(key, map->entries[index].key) == 0) {
-            return map->entries[index].value;
+    while (map->entries[next].used) {
+        size_t home = (size_t)(map->entries[next].hash & (uint64_t)mask);
+#ifdef VF_HASHMAP_ROBIN_HOOD
+        // Chains are ordered by displacement, so nothing after an entry that
+        // is already home can move back
+        if (home == next) break;
+#endif
+        // Distance from home is measured cyclically: the entry may only move back
+        // if the hole lies between its home slot and its current slot.
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->entries[hole] = map->entries[next];
+            memcpy(_hashmap_value(map, hole), _hashmap_value(map, next), map->value_size);
+            hole = next;
         }
-        index++;
-        if (index >= map->capacity) index = 0;
+        next = (next + 1) & mask;
     }
 
-    return NULL;
+    map->entries[hole].used = 0;
 }
 
-void vf_hashmap_remove(vf_hashmap_t* map, const char* key) {
-    uint64_t hash = _hash_key(key);
+static void _hashmap_retire_old_slot(vf_hashmap_t* map, size_t index) {
+    map->old_entries[index].used = _VF_HASH_RETIRED;
+}
+
+#endif // VF_HASHMAP_SWISS_TABLE
+
+// Looks in the current table, then in the old one if a resize is in progress.
+static size_t _hashmap_find(vf_hashmap_t* map, const void* key, size_t length, uint64_t hash) {
+#ifdef VF_HASHMAP_SWISS_TABLE
+    size_t index = _hashmap_probe(map, map->entries, map->ctrl, map->capacity, key, length, hash);
+    if (index != _VF_HASH_NPOS || !map->old_capacity) return index;
+    index = _hashmap_probe(map, map->old_entries, map->old_ctrl, map->old_capacity, key, length, hash);
+#else
+    size_t index = _hashmap_probe(map, map->entries, map->capacity, key, length, hash);
+    if (index != _VF_HASH_NPOS || !map->old_capacity) return index;
+    index = _hashmap_probe(map, map->old_entries, map->old_capacity, key, length, hash);
+#endif
+    return (index != _VF_HASH_NPOS) ? map->capacity + index : _VF_HASH_NPOS;
+}
+
+static inline void _hashmap_prefetch_address(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch((const char*)address, _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+// Starts loading the first slots a lookup of `hash` will inspect.
+static inline void _hashmap_prefetch(const vf_hashmap_t* map, uint64_t hash) {
+#ifdef VF_HASHMAP_SWISS_TABLE
+    size_t group = _VF_HASH_H1(hash) & (map->capacity / VF_HASH_GROUP_WIDTH - 1);
+    _hashmap_prefetch_address(map->ctrl + group * VF_HASH_GROUP_WIDTH);
+#else
+    _hashmap_prefetch_address(&map->entries[hash & (uint64_t)(map->capacity - 1)]);
+#endif
+}
+
+// Once the first slots are cached, starts loading what comparing the key and
+// returning the value will touch next: the likely entry, its value and, for
+// long keys, the key in the arena.
+static inline void _hashmap_prefetch_candidate(const vf_hashmap_t* map, uint64_t hash) {
+#ifdef VF_HASHMAP_SWISS_TABLE
+    size_t group = _VF_HASH_H1(hash) & (map->capacity / VF_HASH_GROUP_WIDTH - 1);
+    uint32_t match = _hashmap_group_match(map->ctrl + group * VF_HASH_GROUP_WIDTH, _VF_HASH_H2(hash));
+    if (match) {
+        size_t index = group * VF_HASH_GROUP_WIDTH + _hashmap_ctz(match);
+        _hashmap_prefetch_address(&map->entries[index]);
+        _hashmap_prefetch_address(map->values + index * map->value_size);
+    }
+#else
     size_t index = (size_t)(hash & (uint64_t)(map->capacity - 1));
+    const vf_hashmap_entry_t* entry = &map->entries[index];
+    if (entry->used && entry->hash == hash) {
+        _hashmap_prefetch_address(map->values + index * map->value_size);
+        if (entry->key_length > VF_HASH_INLINE_KEY_SIZE) _hashmap_prefetch_address(map->keys + entry->key.offset);
+    }
+#endif
+}
+
+typedef struct {
+    vf_hashmap_entry_t* entries;
+    uint8_t* values;
+#ifdef VF_HASHMAP_SWISS_TABLE
+    uint8_t* ctrl;
+#endif
+    size_t capacity;
+} _vf_hashmap_table_t;
+
+static void _hashmap_free_table(_vf_hashmap_table_t* table) {
+#ifdef VF_HASHMAP_SWISS_TABLE
+    free(table->ctrl);
+#endif
+    free(table->entries);
+    free(table->values);
+}
+
+// Installs empty arrays of `capacity` slots and hands the previous ones back in `old`.
+static int _hashmap_replace_table(vf_hashmap_t* map, size_t capacity, _vf_hashmap_table_t* old) {
+    vf_hashmap_entry_t* entries = (vf_hashmap_entry_t*)calloc(capacity, sizeof(vf_hashmap_entry_t));
+    uint8_t* values = (uint8_t*)malloc(capacity * map->value_size);
+#ifdef VF_HASHMAP_SWISS_TABLE
+    uint8_t* ctrl = (uint8_t*)malloc(capacity);
+    if (!ctrl) {
+        free(entries);
+        free(values);
+        return -1;
+    }
+    memset(ctrl, _VF_CTRL_EMPTY, capacity);
+#endif
+    if (!entries || !values) {
+        free(entries);
+        free(values);
+#ifdef VF_HASHMAP_SWISS_TABLE
+        free(ctrl);
+#endif
+        return -1;
+    }
+
+    old->entries = map->entries;
+    old->values = map->values;
+    old->capacity = map->capacity;
+    map->entries = entries;
+    map->values = values;
+    map->capacity = capacity;
+#ifdef VF_HASHMAP_SWISS_TABLE
+    old->ctrl = map->ctrl;
+    map->ctrl = ctrl;
+    map->deleted = 0;
+#endif
+
+    return 0;
+}
+
+// Places an entry into the current table as-is using its cached hash, so keys
+// are never rehashed. The key is known not to be in the current table.
+static void _hashmap_move_entry(vf_hashmap_t* map, const vf_hashmap_entry_t* entry, const void* value) {
+    size_t index = _hashmap_claim_slot(map, entry->hash);
+    map->entries[index] = *entry;
+    memcpy(map->values + index * map->value_size, value, map->value_size);
+}
+
+// Moves up to `slots` old-table slots into the current table, and drops the
+// old table once it is empty.
+static void _hashmap_migrate(vf_hashmap_t* map, size_t slots) {
+    size_t end = map->migrated + slots;
+    if (end > map->old_capacity) end = map->old_capacity;
+
+    for (size_t i = map->migrated; i < end; ++i) {
+        if (map->old_entries[i].used != 1) continue;
+        _hashmap_move_entry(map, &map->old_entries[i], map->old_values + i * map->value_size);
+        _hashmap_retire_old_slot(map, i);
+    }
+    map->migrated = end;
+
+    if (end == map->old_capacity) {
+#ifdef VF_HASHMAP_SWISS_TABLE
+        free(map->old_ctrl);
+        map->old_ctrl = NULL;
+#endif
+        free(map->old_entries);
+        free(map->old_values);
+        map->old_entries = NULL;
+        map->old_values = NULL;
+        map->old_capacity = 0;
+        map->migrated = 0;
 
-    while (map->entries[index].key != NULL) {
-        if (strcmp(key, map->entries[index].key) == 0) {
-            free(map->entries[index].key);
-            map->entries[index].key = NULL;
-            map->entries[index].value = NULL;
-            map->size--;
-            return;
+        // Arena offsets are only rewritten once no old entry can refer to them
+        if (map->keys_garbage > map->keys_size / 2) {
+            _hashmap_compact_keys(map);
         }
-        index++;
-        if (index >= map->capacity) index = 0;
     }
 }
 
-void vf_hashmap_free(vf_hashmap_t* map) {
-    for (size_t i = 0; i < map->capacity; ++i) {
-        free(map->entries[i].key);
-        free(map->entries[i].value);
+// Moves every entry into freshly allocated arrays of `new_capacity` slots.
+static int _hashmap_rehash(vf_hashmap_t* map, size_t new_capacity) {
+    if (map->old_capacity) _hashmap_migrate(map, map->old_capacity);
+
+    _vf_hashmap_table_t old;
+    if (_hashmap_replace_table(map, new_capacity, &old) == -1) return -1;
+    for (size_t i = 0; i < old.capacity; ++i) {
+        if (!old.entries[i].used) continue;
+        _hashmap_move_entry(map, &old.entries[i], old.values + i * map->value_size);
     }
-    free(map->entries);
-    free(map);
+    _hashmap_free_table(&old);
+
+    // Piggyback on the rebuild to drop removed keys from the arena
+    if (map->keys_garbage > map->keys_size / 2) {
+        _hashmap_compact_keys(map);
+    }
+
+    return 0;
 }
 
-size_t vf_hashmap_size(vf_hashmap_t* map) {
-    return map->size;
+// Swaps in the new arrays right away but leaves the entries in the old ones,
+// to be moved by the writes that follow.
+static int _hashmap_begin_resize(vf_hashmap_t* map, size_t new_capacity) {
+    if (map->old_capacity) _hashmap_migrate(map, map->old_capacity);
+
+    _vf_hashmap_table_t old;
+    if (_hashmap_replace_table(map, new_capacity, &old) == -1) return -1;
+    map->old_entries = old.entries;
+    map->old_values = old.values;
+#ifdef VF_HASHMAP_SWISS_TABLE
+    map->old_ctrl = old.ctrl;
+#endif
+    map->old_capacity = old.capacity;
+    map->migrated = 0;
+
+    return 0;
 }
 
-size_t vf_hashmap_capacity(vf_hashmap_t* map) {
-    return map->capacity;
+static int _hashmap_resize(vf_hashmap_t* map, size_t new_capacity) {
+    return map->incremental ? _hashmap_begin_resize(map, new_capacity) : _hashmap_rehash(map, new_capacity);
+}
+
+static int _hashmap_expand(vf_hashmap_t* map) {
+#ifdef VF_HASHMAP_SWISS_TABLE
+    // Under insert/remove churn the load can be mostly tombstones; rebuilding at
+    // the same capacity clears them without growing the table forever.
+    if (map->size < map->capacity * VF_HASH_LOAD_FACTOR / 2) {
+        return _hashmap_resize(map, map->capacity);
+    }
+#endif
+    // Double the capacity
+    // TODO: this could be defined as multiplication number
+    return _hashmap_resize(map, map->capacity * 2);
+}
+
+vf_hashmap_t* vf_hashmap_create(size_t value_size) {
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = value_size;
+    return vf_hashmap_create_with_config(&config);
 }
 
+vf_hashmap_t* vf_hashmap_create_with_config(const vf_hashmap_config_t* config) {
+    size_t value_size = config->value_size;
+    vf_hashmap_t* map = (vf_hashmap_t*)calloc(1, sizeof(vf_hashmap_t));
+    if (!map) return NULL;
+
+    map->entries = (vf_hashmap_entry_t*)calloc(VF_HASH_INITIAL_CAPACITY, sizeof(vf_hashmap_entry_t));
+    map->values = (uint8_t*)malloc(VF_HASH_INITIAL_CAPACITY * value_size);
+    if (!map->entries || !map->values) {
+        free(map->entries);
+        free(map->values);
+        free(map);
+        return NULL;
+    }
+
+#ifdef VF_HASHMAP_SWISS_TABLE
+    map->ctrl = (uint8_t*)malloc(VF_HASH_INITIAL_CAPACITY);
+    if (!map->ctrl) {
+        free(map->entries);
+        free(map->values);
+        free(map);
+        return NULL;
+    }
+    memset(map->ctrl, _VF_CTRL_EMPTY, VF_HASH_INITIAL_CAPACITY);
+    map->deleted = 0;
+#endif
+
+    map->capacity = VF_HASH_INITIAL_CAPACITY;
+    map->size = 0;
+    map->value_size = value_size;
+    map->key_size = config->key_size;
+    map->hash_fn = config->hash_fn;
+    map->seed = config->seed;
+    map->incremental = config->incremental_resize;
+
+    return map;
+}
+
+// Claims a slot for a key known not to be in the map. The caller checked the load.
+static int _hashmap_insert_new(vf_hashmap_t* map, const void* key, size_t length, uint64_t hash, const void* value) {
+    size_t index = _hashmap_claim_slot(map, hash);
+    vf_hashmap_entry_t* entry = &map->entries[index];
+    if (_hashmap_store_key(map, entry, key, length) == -1) {
+        _hashmap_vacate_slot(map, index);
+        return -1;
+    }
+    entry->hash = hash;
+    entry->used = 1;
+    memcpy(_hashmap_value(map, index), value, map->value_size);
+    map->size++;
+
+    return 0;
+}
+
+// Inserts or updates `key`, whose hash the caller already computed.
+static int _hashmap_set_hashed(vf_hashmap_t* map, const void* key, size_t length, uint64_t hash, const void* value) {
+    if (map->mapping) return -1;
+    if (map->old_capacity) _hashmap_migrate(map, VF_HASH_MIGRATE_STEP);
+
+    size_t index = _hashmap_find(map, key, length, hash);
+    if (index != _VF_HASH_NPOS) {
+        // Update existing entry
+        memcpy(_hashmap_value(map, index), value, map->value_size);
+        return 0;
+    }
+
+#ifdef VF_HASHMAP_SWISS_TABLE
+    // Tombstones count against the load factor, as they lengthen probes too.
+    size_t load = map->size + map->deleted;
+#else
+    size_t load = map->size;
+#endif
+    if (load >= map->capacity * VF_HASH_LOAD_FACTOR) {
+        if (_hashmap_expand(map) == -1) return -1;
+    }
+
+    return _hashmap_insert_new(map, key, length, hash, value);
+}
+
+static void _hashmap_remove_at(vf_hashmap_t* map, size_t index) {
+    if (index >= map->capacity) {
+        _hashmap_release_key(map, &map->old_entries[index - map->capacity]);
+        _hashmap_retire_old_slot(map, index - map->capacity);
+    } else {
+        _hashmap_release_key(map, &map->entries[index]);
+        _hashmap_vacate_slot(map, index);
+    }
+    map->size--;
+}
+
+static void _hashmap_remove_hashed(vf_hashmap_t* map, const void* key, size_t length, uint64_t hash) {
+    if (map->mapping) return;
+    if (map->old_capacity) _hashmap_migrate(map, VF_HASH_MIGRATE_STEP);
+
+    size_t index = _hashmap_find(map, key, length, hash);
+    if (index != _VF_HASH_NPOS) _hashmap_remove_at(map, index);
+}
+
+// Keys of the wrong size can never be in a fixed-size key map.
+static inline int _hashmap_valid_length(const vf_hashmap_t* map, size_t length) {
+    return map->key_size == 0 || map->key_size == length;
+}
+
+static int _hashmap_set(vf_hashmap_t* map, const void* key, size_t length, const void* value) {
+    if (!_hashmap_valid_length(map, length)) return -1;
+    return _hashmap_set_hashed(map, key, length, _hashmap_hash(map, key, length), value);
+}
+
+static void* _hashmap_lookup(vf_hashmap_t* map, const void* key, size_t length) {
+    if (!_hashmap_valid_length(map, length)) return NULL;
+    size_t index = _hashmap_find(map, key, length, _hashmap_hash(map, key, length));
+    return (index != _VF_HASH_NPOS) ? _hashmap_value(map, index) : NULL;
+}
+
+// Values of a mapped map sit in read-only pages.
+static void* _hashmap_lookup_mutable(vf_hashmap_t* map, const void* key, size_t length) {
+    return map->mapping ? NULL : _hashmap_lookup(map, key, length);
+}
+
+static int _hashmap_contains(vf_hashmap_t* map, const void* key, size_t length) {
+    if (!_hashmap_valid_length(map, length)) return 0;
+    return _hashmap_find(map, key, length, _hashmap_hash(map, key, length)) != _VF_HASH_NPOS;
+}
+
+static void _hashmap_remove(vf_hashmap_t* map, const void* key, size_t length) {
+    if (!_hashmap_valid_length(map, length)) return;
+    _hashmap_remove_hashed(map, key, length, _hashmap_hash(map, key, length));
+}
+
+int vf_hashmap_set(vf_hashmap_t* map, const char* key, void* value) {
+    return _hashmap_set(map, key, strlen(key), value);
+}
+
+int vf_hashmap_set_n(vf_hashmap_t* map, const char* key, size_t length, void* value) {
+    return _hashmap_set(map, key, length, value);
+}
+
+int vf_hashmap_has(vf_hashmap_t* map, const char* key) {
+    return _hashmap_contains(map, key, strlen(key));
+}
+
+int vf_hashmap_has_n(vf_hashmap_t* map, const char* key, size_t length) {
+    return _hashmap_contains(map, key, length);
+}
+
+const void* vf_hashmap_get(vf_hashmap_t* map, const char* key) {
+    return _hashmap_lookup(map, key, strlen(key));
+}
+
+const void* vf_hashmap_get_n(vf_hashmap_t* map, const char* key, size_t length) {
+    return _hashmap_lookup(map, key, length);
+}
+
+void* vf_hashmap_get_mutable(vf_hashmap_t* map, const char* key) {
+    return _hashmap_lookup_mutable(map, key, strlen(key));
+}
+
+void* vf_hashmap_get_mutable_n(vf_hashmap_t* map, const char* key, size_t length) {
+    return _hashmap_lookup_mutable(map, key, length);
+}
+
+void vf_hashmap_remove(vf_hashmap_t* map, const char* key) {
+    _hashmap_remove(map, key, strlen(key));
+}
+
+void vf_hashmap_remove_n(vf_hashmap_t* map, const char* key, size_t length) {
+    _hashmap_remove(map, key, length);
+}
+
+vf_hashmap_t* vf_hashmap_create_keyed(size_t key_size, size_t value_size) {
+    vf_hashmap_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.value_size = value_size;
+    config.key_size = key_size;
+    return vf_hashmap_create_with_config(&config);
+}
+
+int vf_hashmap_set_key(vf_hashmap_t* map, const void* key, void* value) {
+    return _hashmap_set(map, key, map->key_size, value);
+}
+
+int vf_hashmap_has_key(vf_hashmap_t* map, const void* key) {
+    return _hashmap_contains(map, key, map->key_size);
+}
+
+const void* vf_hashmap_get_key(vf_hashmap_t* map, const void* key) {
+    return _hashmap_lookup(map, key, map->key_size);
+}
+
+void* vf_hashmap_get_mutable_key(vf_hashmap_t* map, const void* key) {
+    return _hashmap_lookup_mutable(map, key, map->key_size);
+}
+
+void vf_hashmap_remove_key(vf_hashmap_t* map, const void* key) {
+    _hashmap_remove(map, key, map->key_size);
+}
+
+int vf_hashmap_set_u64(vf_hashmap_t* map, uint64_t key, void* value) {
+    return _hashmap_set(map, &key, sizeof(key), value);
+}
+
+int vf_hashmap_has_u64(vf_hashmap_t* map, uint64_t key) {
+    return _hashmap_contains(map, &key, sizeof(key));
+}
+
+const void* vf_hashmap_get_u64(vf_hashmap_t* map, uint64_t key) {
+    return _hashmap_lookup(map, &key, sizeof(key));
+}
+
+void* vf_hashmap_get_mutable_u64(vf_hashmap_t* map, uint64_t key) {
+    return _hashmap_lookup_mutable(map, &key, sizeof(key));
+}
+
+void vf_hashmap_remove_u64(vf_hashmap_t* map, uint64_t key) {
+    _hashmap_remove(map, &key, sizeof(key));
+}
+
+#ifdef VF_HASHMAP_MMAP
+static void* _hashmap_map_file(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+
+    void* data = NULL;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        *size = (size_t)info.st_size;
+        data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) data = NULL;
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+
+    return data;
+}
+
+static void _hashmap_unmap_file(void* data, size_t size) {
+    munmap(data, size);
+}
+#else
+// Without mmap the whole file is read into one block, still without parsing it.
+static void* _hashmap_map_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    void* data = NULL;
+    long length = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+    if (length > 0 && fseek(file, 0, SEEK_SET) == 0) {
+        *size = (size_t)length;
+        data = malloc(*size);
+        if (data && fread(data, 1, *size, file) != *size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+
+    return data;
+}
+
+static void _hashmap_unmap_file(void* data, size_t size) {
+    (void)size;
+    free(data);
+}
+#endif
+
+void vf_hashmap_free(vf_hashmap_t* map) {
+    if (map->mapping) {
+        _hashmap_unmap_file(map->mapping, map->mapping_size);
+        free(map);
+        return;
+    }
+#ifdef VF_HASHMAP_SWISS_TABLE
+    free(map->ctrl);
+    free(map->old_ctrl);
+#endif
+    free(map->old_entries);
+    free(map->old_values);
+    free(map->keys);
+    free(map->values);
+    free(map->entries);
+    free(map);
+}
+
+// malloc + memcpy of `size` bytes, of which the first `used` are copied.
+static void* _hashmap_duplicate(const void* source, size_t used, size_t size) {
+    void* copy = malloc(size ? size : 1);
+    if (copy && used) memcpy(copy, source, used);
+    return copy;
+}
+
+vf_hashmap_t* vf_hashmap_clone(const vf_hashmap_t* map) {
+    vf_hashmap_t* copy = (vf_hashmap_t*)malloc(sizeof(vf_hashmap_t));
+    if (!copy) return NULL;
+    *copy = *map;
+    // A copy of a mapped map lives on the heap and is writable
+    copy->mapping = NULL;
+    copy->mapping_size = 0;
+
+    size_t entries_size = map->capacity * sizeof(vf_hashmap_entry_t);
+    size_t values_size = map->capacity * map->value_size;
+    copy->entries = (vf_hashmap_entry_t*)_hashmap_duplicate(map->entries, entries_size, entries_size);
+    copy->values = (uint8_t*)_hashmap_duplicate(map->values, values_size, values_size);
+    copy->keys = map->keys ? (char*)_hashmap_duplicate(map->keys, map->keys_size, map->keys_capacity) : NULL;
+    int failed = !copy->entries || !copy->values || (map->keys && !copy->keys);
+#ifdef VF_HASHMAP_SWISS_TABLE
+    copy->ctrl = (uint8_t*)_hashmap_duplicate(map->ctrl, map->capacity, map->capacity);
+    copy->old_ctrl = NULL;
+    failed |= !copy->ctrl;
+#endif
+
+    copy->old_entries = NULL;
+    copy->old_values = NULL;
+    if (map->old_capacity) {
+        size_t old_entries_size = map->old_capacity * sizeof(vf_hashmap_entry_t);
+        size_t old_values_size = map->old_capacity * map->value_size;
+        copy->old_entries = (vf_hashmap_entry_t*)_hashmap_duplicate(map->old_entries, old_entries_size, old_entries_size);
+        copy->old_values = (uint8_t*)_hashmap_duplicate(map->old_values, old_values_size, old_values_size);
+        failed |= !copy->old_entries || !copy->old_values;
+#ifdef VF_HASHMAP_SWISS_TABLE
+        copy->old_ctrl = (uint8_t*)_hashmap_duplicate(map->old_ctrl, map->old_capacity, map->old_capacity);
+        failed |= !copy->old_ctrl;
+#endif
+    }
+
+    if (failed) {
+        vf_hashmap_free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+int vf_hashmap_reserve(vf_hashmap_t* map, size_t count) {
+    if (map->mapping) return -1;
+    size_t capacity = map->capacity;
+    while (count > capacity * VF_HASH_LOAD_FACTOR) capacity *= 2;
+    // Reserving is asked for up front, so it rehashes in one go even in incremental mode
+    return (capacity > map->capacity) ? _hashmap_rehash(map, capacity) : 0;
+}
+
+// Makes room in the key arena for `bytes` more bytes of long keys.
+static int _hashmap_reserve_keys(vf_hashmap_t* map, size_t bytes) {
+    size_t needed = map->keys_size + bytes;
+    if (needed <= map->keys_capacity) return 0;
+    char* new_keys = (char*)realloc(map->keys, needed);
+    if (!new_keys) return -1;
+    map->keys = new_keys;
+    map->keys_capacity = needed;
+    return 0;
+}
+
+// A range of keys to hash for a bulk build; one per thread pool task.
+typedef struct {
+    const vf_hashmap_t* map;
+    const char* const* keys;    // Either one pointer per key...
+    const uint8_t* packed;      // ...or keys packed `key_size` bytes apart
+    const size_t* lengths;
+    uint64_t* hashes;
+    size_t* key_lengths;
+    size_t begin;
+    size_t end;
+    size_t arena_bytes;         // Arena space the long keys of the range need
+    int invalid;                // Set if a key has the wrong size for the map
+} _vf_hashmap_build_job_t;
+
+static inline const void* _hashmap_build_key(const _vf_hashmap_build_job_t* job, size_t i) {
+    return job->packed ? (const void*)(job->packed + i * job->map->key_size) : (const void*)job->keys[i];
+}
+
+static void _hashmap_build_hash(void* arg) {
+    _vf_hashmap_build_job_t* job = (_vf_hashmap_build_job_t*)arg;
+    for (size_t i = job->begin; i < job->end; ++i) {
+        const void* key = _hashmap_build_key(job, i);
+        size_t length = job->packed ? job->map->key_size
+                      : job->lengths ? job->lengths[i]
+                      : strlen((const char*)key);
+        // Fails the whole build; hashing a short key would read past it
+        if (!_hashmap_valid_length(job->map, length)) {
+            job->invalid = 1;
+            continue;
+        }
+        if (length > VF_HASH_INLINE_KEY_SIZE) job->arena_bytes += length + 1;
+        job->key_lengths[i] = length;
+        job->hashes[i] = _hashmap_hash(job->map, key, length);
+    }
+}
+
+// Splits the keys into `job_count` ranges, hashes them through `run` and
+// inserts everything in order. `run` hashes every job before returning.
+static vf_hashmap_t* _hashmap_build(const vf_hashmap_config_t* config, const char* const* keys, const void* packed,
+                                   const size_t* lengths, const void* values, size_t count,
+                                   size_t job_count, void (*run)(_vf_hashmap_build_job_t* jobs, size_t job_count, void* user),
+                                   void* user) {
+    vf_hashmap_t* map = vf_hashmap_create_with_config(config);
+    uint64_t* hashes = (uint64_t*)malloc((count ? count : 1) * sizeof(uint64_t));
+    size_t* key_lengths = (size_t*)malloc((count ? count : 1) * sizeof(size_t));
+    _vf_hashmap_build_job_t* jobs = (_vf_hashmap_build_job_t*)calloc(job_count, sizeof(_vf_hashmap_build_job_t));
+    if (!map || !hashes || !key_lengths || !jobs || vf_hashmap_reserve(map, count) == -1) goto fail;
+
+    for (size_t j = 0; j < job_count; ++j) {
+        jobs[j].map = map;
+        jobs[j].keys = keys;
+        jobs[j].packed = (const uint8_t*)packed;
+        jobs[j].lengths = lengths;
+        jobs[j].hashes = hashes;
+        jobs[j].key_lengths = key_lengths;
+        jobs[j].begin = count * j / job_count;
+        jobs[j].end = count * (j + 1) / job_count;
+    }
+    run(jobs, job_count, user);
+
+    {
+        size_t arena_bytes = 0;
+        for (size_t j = 0; j < job_count; ++j) {
+            if (jobs[j].invalid) goto fail;
+            arena_bytes += jobs[j].arena_bytes;
+        }
+        if (_hashmap_reserve_keys(map, arena_bytes) == -1) goto fail;
+
+        // Hashes are known ahead, so slots are fetched a few keys in advance
+        const size_t distance = 8;
+        const uint8_t* value = (const uint8_t*)values;
+        for (size_t i = 0; i < count; ++i, value += map->value_size) {
+            if (i + distance < count) _hashmap_prefetch(map, hashes[i + distance]);
+            const void* key = _hashmap_build_key(&jobs[0], i);
+            size_t index = _hashmap_find(map, key, key_lengths[i], hashes[i]);
+            if (index != _VF_HASH_NPOS) {
+                memcpy(_hashmap_value(map, index), value, map->value_size);
+            } else if (_hashmap_insert_new(map, key, key_lengths[i], hashes[i], value) == -1) {
+                goto fail;
+            }
+        }
+    }
+
+    free(jobs);
+    free(key_lengths);
+    free(hashes);
+    return map;
+
+fail:
+    free(jobs);
+    free(key_lengths);
+    free(hashes);
+    if (map) vf_hashmap_free(map);
+    return NULL;
+}
+
+static void _hashmap_build_run_serial(_vf_hashmap_build_job_t* jobs, size_t job_count, void* user) {
+    (void)user;
+    for (size_t j = 0; j < job_count; ++j) {
+        _hashmap_build_hash(&jobs[j]);
+    }
+}
+
+vf_hashmap_t* vf_hashmap_build(const vf_hashmap_config_t* config, const char* const* keys,
+                               const size_t* lengths, const void* values, size_t count) {
+    return _hashmap_build(config, keys, NULL, lengths, values, count, 1, _hashmap_build_run_serial, NULL);
+}
+
+vf_hashmap_t* vf_hashmap_build_keyed(const vf_hashmap_config_t* config, const void* keys,
+                                     const void* values, size_t count) {
+    if (config->key_size == 0) return NULL;
+    return _hashmap_build(config, NULL, keys, NULL, values, count, 1, _hashmap_build_run_serial, NULL);
+}
+
+vf_hashmap_iter_t vf_hashmap_iter(vf_hashmap_t* map) {
+    vf_hashmap_iter_t it;
+    memset(&it, 0, sizeof(it));
+    it.map = map;
+    return it;
+}
+
+int vf_hashmap_next(vf_hashmap_iter_t* it) {
+    vf_hashmap_t* map = it->map;
+    size_t total = map->capacity + map->old_capacity;
+
+    while (it->slot < total) {
+        size_t index = it->slot++;
+        const vf_hashmap_entry_t* entry = (index < map->capacity) ? &map->entries[index]
+                                                                  : &map->old_entries[index - map->capacity];
+        // Old-table slots may also be retired, which `used` tells apart from live
+        if (entry->used != 1) continue;
+        it->key = _hashmap_entry_key(map, entry);
+        it->key_length = entry->key_length;
+        // Values of a mapped map sit in read-only pages
+        it->value = map->mapping ? NULL : _hashmap_value(map, index);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Keys per group in batched lookups: enough misses in flight to cover memory
+// latency, few enough that the prefetched lines are still cached when probed.
+#define _VF_HASH_BATCH 32
+
+static size_t _hashmap_get_batch(vf_hashmap_t* map, const char* const* keys, const uint8_t* packed,
+                                 const size_t* lengths, size_t count, const void** out) {
+    uint64_t hashes[_VF_HASH_BATCH];
+    size_t key_lengths[_VF_HASH_BATCH];
+    size_t found = 0;
+
+    for (size_t base = 0; base < count; base += _VF_HASH_BATCH) {
+        size_t n = (count - base < _VF_HASH_BATCH) ? count - base : _VF_HASH_BATCH;
+
+        for (size_t i = 0; i < n; ++i) {
+            const void* key = packed ? (const void*)(packed + (base + i) * map->key_size) : (const void*)keys[base + i];
+            key_lengths[i] = packed ? map->key_size : lengths ? lengths[base + i] : strlen((const char*)key);
+            // A miss below; hashing a short key would read past it
+            if (!_hashmap_valid_length(map, key_lengths[i])) continue;
+            hashes[i] = _hashmap_hash(map, key, key_lengths[i]);
+            _hashmap_prefetch(map, hashes[i]);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (_hashmap_valid_length(map, key_lengths[i])) _hashmap_prefetch_candidate(map, hashes[i]);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const void* key = packed ? (const void*)(packed + (base + i) * map->key_size) : (const void*)keys[base + i];
+            size_t index = _hashmap_valid_length(map, key_lengths[i])
+                         ? _hashmap_find(map, key, key_lengths[i], hashes[i]) : _VF_HASH_NPOS;
+            out[base + i] = (index != _VF_HASH_NPOS) ? _hashmap_value(map, index) : NULL;
+            found += (index != _VF_HASH_NPOS);
+        }
+    }
+
+    return found;
+}
+
+size_t vf_hashmap_get_batch(vf_hashmap_t* map, const char* const* keys, const size_t* lengths,
+                            size_t count, const void** out) {
+    return _hashmap_get_batch(map, keys, NULL, lengths, count, out);
+}
+
+size_t vf_hashmap_get_batch_keyed(vf_hashmap_t* map, const void* keys, size_t count, const void** out) {
+    if (map->key_size == 0) {
+        memset((void*)out, 0, count * sizeof(*out));
+        return 0;
+    }
+    return _hashmap_get_batch(map, NULL, (const uint8_t*)keys, NULL, count, out);
+}
+
+#define _VF_HASH_FILE_MAGIC "VFHASHMP"
+#define _VF_HASH_FILE_VERSION 1
+#define _VF_HASH_FILE_ALIGN 64
+// Reads back differently on a machine of the other endianness.
+#define _VF_HASH_FILE_BYTE_ORDER 0x0102030405060708ULL
+#if defined(VF_HASHMAP_SWISS_TABLE)
+#    define _VF_HASH_FILE_LAYOUT 1
+#elif defined(VF_HASHMAP_ROBIN_HOOD)
+// Robin Hood lookups rely on the insertion order, so other tables can't be read as one
+#    define _VF_HASH_FILE_LAYOUT 2
+#else
+#    define _VF_HASH_FILE_LAYOUT 0
+#endif
+
+// Start of a saved map. Offsets are from the start of the file.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;        // _VF_HASH_FILE_LAYOUT of the writer
+    uint64_t byte_order;
+    uint64_t entry_size;
+    uint64_t fingerprint;   // Hash of a fixed key, to catch a different hash function
+    uint64_t seed;
+    uint64_t capacity;
+    uint64_t size;
+    uint64_t deleted;
+    uint64_t value_size;
+    uint64_t key_size;
+    uint64_t keys_size;
+    uint64_t entries_offset;
+    uint64_t ctrl_offset;   // 0 in linear mode
+    uint64_t values_offset;
+    uint64_t keys_offset;
+    uint64_t file_size;     // Catches truncated files
+} _vf_hashmap_file_header_t;
+
+static uint64_t _hashmap_fingerprint(const vf_hashmap_t* map) {
+    static const char probe[] = "vf_hashmap/probe";
+    // Word-sized keys take their own hash path, which reads exactly 8 bytes
+    return _hashmap_hash(map, probe, (map->key_size == 8) ? 8 : 16);
+}
+
+static inline uint64_t _hashmap_file_align(uint64_t offset) {
+    return (offset + _VF_HASH_FILE_ALIGN - 1) & ~(uint64_t)(_VF_HASH_FILE_ALIGN - 1);
+}
+
+// Zero-fills from `*position` up to `offset`, then writes `size` bytes there.
+static int _hashmap_write_at(FILE* file, uint64_t* position, uint64_t offset, const void* data, size_t size) {
+    static const char zeros[_VF_HASH_FILE_ALIGN] = {0};
+    size_t padding = (size_t)(offset - *position);
+    if (padding && fwrite(zeros, 1, padding, file) != padding) return -1;
+    if (size && fwrite(data, 1, size, file) != size) return -1;
+    *position = offset + size;
+    return 0;
+}
+
+// Writes one `stride`-byte item per slot of the current table at `offset`,
+// taken from `data` for used slots and zeros for empty ones, so neither
+// removed keys, stale values nor never-written heap bytes end up in the file.
+static int _hashmap_write_slots(FILE* file, uint64_t* position, uint64_t offset, const vf_hashmap_t* map,
+                                const void* data, size_t stride) {
+    static const char zeros[1024] = {0};
+    if (_hashmap_write_at(file, position, offset, NULL, 0) == -1) return -1;
+
+    // One write per run of full or empty slots
+    for (size_t i = 0; i < map->capacity;) {
+        int used = map->entries[i].used != 0;
+        size_t end = i + 1;
+        while (end < map->capacity && (map->entries[end].used != 0) == used) end++;
+        size_t size = (end - i) * stride;
+        if (used) {
+            if (fwrite((const uint8_t*)data + i * stride, 1, size, file) != size) return -1;
+        } else {
+            while (size) {
+                size_t chunk = (size < sizeof(zeros)) ? size : sizeof(zeros);
+                if (fwrite(zeros, 1, chunk, file) != chunk) return -1;
+                size -= chunk;
+            }
+        }
+        i = end;
+    }
+    *position = offset + map->capacity * stride;
+    return 0;
+}
+
+int vf_hashmap_save(vf_hashmap_t* map, const char* path) {
+    // Only the current table and live keys are written
+    if (map->old_capacity) _hashmap_migrate(map, map->old_capacity);
+    if (map->keys_garbage && _hashmap_compact_keys(map) == -1) return -1;
+
+    _vf_hashmap_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, _VF_HASH_FILE_MAGIC, sizeof(header.magic));
+    header.version = _VF_HASH_FILE_VERSION;
+    header.layout = _VF_HASH_FILE_LAYOUT;
+    header.byte_order = _VF_HASH_FILE_BYTE_ORDER;
+    header.entry_size = sizeof(vf_hashmap_entry_t);
+    header.fingerprint = _hashmap_fingerprint(map);
+    header.seed = map->seed;
+    header.capacity = map->capacity;
+    header.size = map->size;
+    header.value_size = map->value_size;
+    header.key_size = map->key_size;
+    header.keys_size = map->keys_size;
+
+    uint64_t offset = _hashmap_file_align(sizeof(header));
+    header.entries_offset = offset;
+    offset = _hashmap_file_align(offset + map->capacity * sizeof(vf_hashmap_entry_t));
+#ifdef VF_HASHMAP_SWISS_TABLE
+    header.deleted = map->deleted;
+    header.ctrl_offset = offset;
+    offset = _hashmap_file_align(offset + map->capacity);
+#endif
+    header.values_offset = offset;
+    offset = _hashmap_file_align(offset + map->capacity * map->value_size);
+    header.keys_offset = offset;
+    header.file_size = offset + map->keys_size;
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return -1;
+
+    uint64_t position = 0;
+    int result = _hashmap_write_at(file, &position, 0, &header, sizeof(header));
+    result |= _hashmap_write_slots(file, &position, header.entries_offset, map, map->entries, sizeof(vf_hashmap_entry_t));
+#ifdef VF_HASHMAP_SWISS_TABLE
+    result |= _hashmap_write_at(file, &position, header.ctrl_offset, map->ctrl, map->capacity);
+#endif
+    result |= _hashmap_write_slots(file, &position, header.values_offset, map, map->values, map->value_size);
+    result |= _hashmap_write_at(file, &position, header.keys_offset, map->keys, map->keys_size);
+    result |= fclose(file);
+
+    return result ? -1 : 0;
+}
+
+// Whether `count` items of `item_size` bytes at `offset` fit in the file.
+static int _hashmap_file_section_fits(uint64_t offset, uint64_t count, uint64_t item_size, uint64_t file_size) {
+    if (offset % 8 != 0 || offset > file_size) return 0;
+    return item_size == 0 || count <= (file_size - offset) / item_size;
+}
+
+// Points a map at the sections of a mapped file, or returns NULL if the
+// header does not describe a map this build can read.
+static vf_hashmap_t* _hashmap_open_image(void* data, size_t size, vf_hashmap_hash_fn hash_fn) {
+    const _vf_hashmap_file_header_t* header = (const _vf_hashmap_file_header_t*)data;
+    if (size < sizeof(*header) || memcmp(header->magic, _VF_HASH_FILE_MAGIC, sizeof(header->magic)) != 0) return NULL;
+    if (header->version != _VF_HASH_FILE_VERSION || header->layout != _VF_HASH_FILE_LAYOUT ||
+        header->byte_order != _VF_HASH_FILE_BYTE_ORDER || header->entry_size != sizeof(vf_hashmap_entry_t) ||
+        header->file_size != size) {
+        return NULL;
+    }
+    // Capacity is a power of two that probes mask with
+    if (header->capacity < VF_HASH_INITIAL_CAPACITY || (header->capacity & (header->capacity - 1)) != 0 ||
+        header->size > header->capacity) {
+        return NULL;
+    }
+    if (!_hashmap_file_section_fits(header->entries_offset, header->capacity, sizeof(vf_hashmap_entry_t), size) ||
+        !_hashmap_file_section_fits(header->values_offset, header->capacity, header->value_size, size) ||
+        !_hashmap_file_section_fits(header->keys_offset, header->keys_size, 1, size)) {
+        return NULL;
+    }
+#ifdef VF_HASHMAP_SWISS_TABLE
+    if (!_hashmap_file_section_fits(header->ctrl_offset, header->capacity, 1, size)) return NULL;
+#endif
+
+    vf_hashmap_t* map = (vf_hashmap_t*)calloc(1, sizeof(vf_hashmap_t));
+    if (!map) return NULL;
+
+    uint8_t* base = (uint8_t*)data;
+    map->entries = (vf_hashmap_entry_t*)(base + header->entries_offset);
+    map->values = base + header->values_offset;
+    map->keys = header->keys_size ? (char*)(base + header->keys_offset) : NULL;
+    map->keys_size = (size_t)header->keys_size;
+    map->keys_capacity = (size_t)header->keys_size;
+#ifdef VF_HASHMAP_SWISS_TABLE
+    map->ctrl = base + header->ctrl_offset;
+    map->deleted = (size_t)header->deleted;
+#endif
+    map->capacity = (size_t)header->capacity;
+    map->size = (size_t)header->size;
+    map->value_size = (size_t)header->value_size;
+    map->key_size = (size_t)header->key_size;
+    map->hash_fn = hash_fn;
+    map->seed = header->seed;
+
+    if (_hashmap_fingerprint(map) != header->fingerprint) {
+        free(map);
+        return NULL;
+    }
+    map->mapping = data;
+    map->mapping_size = size;
+
+    return map;
+}
+
+vf_hashmap_t* vf_hashmap_open_mmap(const char* path, vf_hashmap_hash_fn hash_fn) {
+    size_t size = 0;
+    void* data = _hashmap_map_file(path, &size);
+    if (!data) return NULL;
+
+    vf_hashmap_t* map = _hashmap_open_image(data, size, hash_fn);
+    if (!map) _hashmap_unmap_file(data, size);
+    return map;
+}
+
+// Frozen maps pick buckets and slots from a remix of the key hash, so hashes
+// with weak high bits (FNV-1a) still spread over the buckets.
+static inline uint64_t _hashmap_frozen_hash(uint64_t hash) {
+    return _hashmap_mix(hash, 0x2d358dccaa6c78a5ULL);
+}
+
+// Bucket of a frozen key, from the high half of its remixed hash.
+static inline size_t _hashmap_frozen_bucket(const vf_hashmap_frozen_t* map, uint64_t hash) {
+    return (size_t)(((hash >> 32) * (uint64_t)map->bucket_count) >> 32);
+}
+
+// Slot of a frozen key, given the mixed pilot of its bucket. The pilot is
+// mixed once for the whole bucket, and the multiply carries every bit of the
+// hash into the high half the slot is taken from.
+static inline size_t _hashmap_frozen_position(const vf_hashmap_frozen_t* map, uint64_t hash, uint64_t pilot_hash) {
+    uint64_t mixed = (hash ^ pilot_hash) * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(((mixed >> 32) * (uint64_t)map->slot_count) >> 32);
+}
+
+static inline uint64_t _hashmap_frozen_pilot_hash(uint32_t pilot) {
+    return _hashmap_mix(pilot ^ 0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL);
+}
+
+static inline vf_hashmap_entry_t* _hashmap_frozen_entry(const vf_hashmap_frozen_t* map, size_t slot) {
+    return (vf_hashmap_entry_t*)(map->slots + slot * map->slot_stride);
+}
+
+// Gives up on a bucket after this many pilots. Only hit when keys can't be
+// told apart by their hashes: with any free slots left a pilot turns up long before.
+#define _VF_HASH_FROZEN_MAX_PILOT (1u << 24)
+
+// Finds the pilot that sends all `count` keys of a bucket to free, distinct
+// slots and takes those slots in the `taken` bit set. -1 if there is none.
+static int _hashmap_frozen_place(vf_hashmap_frozen_t* map, const uint64_t* hashes, size_t count,
+                                 uint8_t* taken, size_t* positions, uint32_t* pilot) {
+    for (uint32_t candidate = 0; candidate < _VF_HASH_FROZEN_MAX_PILOT; ++candidate) {
+        uint64_t pilot_hash = _hashmap_frozen_pilot_hash(candidate);
+        size_t placed = 0;
+        while (placed < count) {
+            size_t position = _hashmap_frozen_position(map, hashes[placed], pilot_hash);
+            uint8_t bit = (uint8_t)(1u << (position & 7));
+            if (taken[position >> 3] & bit) break;
+            // Marked right away, so two keys of the bucket can't share it either
+            taken[position >> 3] |= bit;
+            positions[placed++] = position;
+        }
+        if (placed == count) {
+            *pilot = candidate;
+            return 0;
+        }
+        while (placed > 0) {
+            size_t position = positions[--placed];
+            taken[position >> 3] &= (uint8_t)~(1u << (position & 7));
+        }
+    }
+    return -1;
+}
+
+vf_hashmap_frozen_t* vf_hashmap_freeze(const vf_hashmap_t* map) {
+    size_t count = map->size;
+    size_t slot_count = (size_t)(count / VF_HASH_FROZEN_LOAD) + 1;
+    size_t bucket_count = count / VF_HASH_FROZEN_BUCKET_SIZE + 1;
+    // Positions are 32-bit multiply-shift reductions
+    if (slot_count > UINT32_MAX) return NULL;
+
+    vf_hashmap_frozen_t* frozen = (vf_hashmap_frozen_t*)calloc(1, sizeof(vf_hashmap_frozen_t));
+    if (!frozen) return NULL;
+    frozen->slot_count = slot_count;
+    frozen->slot_stride = sizeof(vf_hashmap_entry_t) + ((map->value_size + 7) & ~(size_t)7);
+    frozen->bucket_count = bucket_count;
+    frozen->size = count;
+    frozen->hasher.value_size = map->value_size;
+    frozen->hasher.key_size = map->key_size;
+    frozen->hasher.hash_fn = map->hash_fn;
+    frozen->hasher.seed = map->seed;
+
+    // Live entries of both tables, grouped by bucket with a counting sort
+    size_t total = map->capacity + map->old_capacity;
+    size_t* items = (size_t*)malloc((count ? count : 1) * sizeof(size_t));
+    size_t* bucket_start = (size_t*)calloc(bucket_count + 1, sizeof(size_t));
+    uint64_t* hashes = (uint64_t*)malloc((count ? count : 1) * sizeof(uint64_t));
+    size_t* order = (size_t*)malloc(bucket_count * sizeof(size_t));
+    size_t* by_size = NULL;
+    size_t* positions = NULL;
+    // A bit per slot stays in cache much longer than a byte per slot
+    uint8_t* taken = (uint8_t*)calloc(slot_count / 8 + 1, 1);
+    frozen->slots = (uint8_t*)calloc(slot_count, frozen->slot_stride);
+    frozen->pilots = (uint32_t*)malloc(bucket_count * sizeof(uint32_t));
+    int failed = !items || !bucket_start || !hashes || !order || !taken || !frozen->slots || !frozen->pilots;
+
+    size_t keys_size = 0;
+    size_t largest = 0;
+    if (!failed) {
+        for (size_t i = 0; i < total; ++i) {
+            const vf_hashmap_entry_t* entry = (i < map->capacity) ? &map->entries[i] : &map->old_entries[i - map->capacity];
+            if (entry->used != 1) continue;
+            bucket_start[_hashmap_frozen_bucket(frozen, _hashmap_frozen_hash(entry->hash)) + 1]++;
+            if (entry->key_length > VF_HASH_INLINE_KEY_SIZE) keys_size += entry->key_length + 1;
+        }
+        for (size_t b = 0; b < bucket_count; ++b) {
+            if (bucket_start[b + 1] > largest) largest = bucket_start[b + 1];
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        size_t* fill = order;   // Borrowed as write cursors until the buckets are ordered
+        memcpy(fill, bucket_start, bucket_count * sizeof(size_t));
+        for (size_t i = 0; i < total; ++i) {
+            const vf_hashmap_entry_t* entry = (i < map->capacity) ? &map->entries[i] : &map->old_entries[i - map->capacity];
+            if (entry->used != 1) continue;
+            uint64_t hash = _hashmap_frozen_hash(entry->hash);
+            size_t at = fill[_hashmap_frozen_bucket(frozen, hash)]++;
+            items[at] = i;
+            hashes[at] = hash;
+        }
+
+        by_size = (size_t*)calloc(largest + 2, sizeof(size_t));
+        positions = (size_t*)malloc((largest ? largest : 1) * sizeof(size_t));
+        frozen->hasher.keys = keys_size ? (char*)malloc(keys_size) : NULL;
+        failed = !by_size || !positions || (keys_size && !frozen->hasher.keys);
+    }
+
+    if (!failed) {
+        // Biggest buckets first, while most slots are still free
+        for (size_t b = 0; b < bucket_count; ++b) {
+            by_size[largest - (bucket_start[b + 1] - bucket_start[b]) + 1]++;
+        }
+        for (size_t k = 0; k <= largest; ++k) by_size[k + 1] += by_size[k];
+        for (size_t b = 0; b < bucket_count; ++b) {
+            order[by_size[largest - (bucket_start[b + 1] - bucket_start[b])]++] = b;
+        }
+
+        for (size_t i = 0; i < bucket_count && !failed; ++i) {
+            size_t b = order[i];
+            size_t first = bucket_start[b];
+            size_t size = bucket_start[b + 1] - first;
+            frozen->pilots[b] = 0;
+            if (size == 0) continue;
+            if (_hashmap_frozen_place(frozen, hashes + first, size, taken, positions, &frozen->pilots[b]) == -1) {
+                failed = 1;
+                break;
+            }
+            for (size_t k = 0; k < size; ++k) {
+                size_t index = items[first + k];
+                const vf_hashmap_entry_t* entry = (index < map->capacity) ? &map->entries[index]
+                                                                          : &map->old_entries[index - map->capacity];
+                vf_hashmap_entry_t* slot = _hashmap_frozen_entry(frozen, positions[k]);
+                *slot = *entry;
+                if (entry->key_length > VF_HASH_INLINE_KEY_SIZE) {
+                    memcpy(frozen->hasher.keys + frozen->hasher.keys_size, map->keys + entry->key.offset, entry->key_length + 1);
+                    slot->key.offset = frozen->hasher.keys_size;
+                    frozen->hasher.keys_size += entry->key_length + 1;
+                }
+                memcpy(slot + 1, _hashmap_value(map, index), map->value_size);
+            }
+        }
+        frozen->hasher.keys_capacity = frozen->hasher.keys_size;
+    }
+
+    free(positions);
+    free(by_size);
+    free(taken);
+    free(order);
+    free(hashes);
+    free(bucket_start);
+    free(items);
+    if (failed) {
+        vf_hashmap_frozen_free(frozen);
+        return NULL;
+    }
+    return frozen;
+}
+
+void vf_hashmap_frozen_free(vf_hashmap_frozen_t* map) {
+    free(map->hasher.keys);
+    free(map->pilots);
+    free(map->slots);
+    free(map);
+}
+
+static const void* _hashmap_frozen_lookup(const vf_hashmap_frozen_t* map, const void* key, size_t length) {
+    if (!_hashmap_valid_length(&map->hasher, length)) return NULL;
+    uint64_t hash = _hashmap_hash(&map->hasher, key, length);
+    uint64_t mixed = _hashmap_frozen_hash(hash);
+    uint64_t pilot_hash = _hashmap_frozen_pilot_hash(map->pilots[_hashmap_frozen_bucket(map, mixed)]);
+    const vf_hashmap_entry_t* entry = _hashmap_frozen_entry(map, _hashmap_frozen_position(map, mixed, pilot_hash));
+    // Keys that aren't in the map land on some slot too, so it is still compared
+    if (!entry->used || !_hashmap_key_equals(&map->hasher, entry, key, length, hash)) return NULL;
+    return entry + 1;
+}
+
+const void* vf_hashmap_frozen_get(const vf_hashmap_frozen_t* map, const char* key) {
+    return _hashmap_frozen_lookup(map, key, strlen(key));
+}
+
+const void* vf_hashmap_frozen_get_n(const vf_hashmap_frozen_t* map, const char* key, size_t length) {
+    return _hashmap_frozen_lookup(map, key, length);
+}
+
+const void* vf_hashmap_frozen_get_key(const vf_hashmap_frozen_t* map, const void* key) {
+    return _hashmap_frozen_lookup(map, key, map->hasher.key_size);
+}
+
+const void* vf_hashmap_frozen_get_u64(const vf_hashmap_frozen_t* map, uint64_t key) {
+    return _hashmap_frozen_lookup(map, &key, sizeof(key));
+}
+
+int vf_hashmap_frozen_has(const vf_hashmap_frozen_t* map, const char* key) {
+    return _hashmap_frozen_lookup(map, key, strlen(key)) != NULL;
+}
+
+int vf_hashmap_frozen_has_n(const vf_hashmap_frozen_t* map, const char* key, size_t length) {
+    return _hashmap_frozen_lookup(map, key, length) != NULL;
+}
+
+int vf_hashmap_frozen_has_key(const vf_hashmap_frozen_t* map, const void* key) {
+    return _hashmap_frozen_lookup(map, key, map->hasher.key_size) != NULL;
+}
+
+int vf_hashmap_frozen_has_u64(const vf_hashmap_frozen_t* map, uint64_t key) {
+    return _hashmap_frozen_lookup(map, &key, sizeof(key)) != NULL;
+}
+
+size_t vf_hashmap_frozen_size(const vf_hashmap_frozen_t* map) {
+    return map->size;
+}
+
+size_t vf_hashmap_size(vf_hashmap_t* map) {
+    return map->size;
+}
+
+size_t vf_hashmap_capacity(vf_hashmap_t* map) {
+    return map->capacity;
+}
+
+// Adds the live entries of one table to `stats`.
+static void _hashmap_table_stats(const vf_hashmap_entry_t* entries, size_t capacity, vf_hashmap_stats_t* stats,
+                                 double* total) {
+#ifdef VF_HASHMAP_SWISS_TABLE
+    size_t group_mask = capacity / VF_HASH_GROUP_WIDTH - 1;
+#endif
+    for (size_t i = 0; i < capacity; ++i) {
+        if (entries[i].used != 1) continue;
+#ifdef VF_HASHMAP_SWISS_TABLE
+        // Groups stepped over on the triangular probe sequence
+        size_t group = _VF_HASH_H1(entries[i].hash) & group_mask;
+        size_t displacement = 0;
+        while (group != i / VF_HASH_GROUP_WIDTH) {
+            group = (group + ++displacement) & group_mask;
+        }
+#else
+        size_t displacement = _hashmap_displacement(entries[i].hash, i, capacity);
+#endif
+        if (displacement > stats->max_displacement) stats->max_displacement = displacement;
+        stats->histogram[(displacement < VF_HASH_STATS_BUCKETS) ? displacement : VF_HASH_STATS_BUCKETS - 1]++;
+        *total += (double)displacement;
+    }
+}
+
+vf_hashmap_stats_t vf_hashmap_stats(const vf_hashmap_t* map) {
+    vf_hashmap_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.size = map->size;
+    stats.capacity = map->capacity;
+
+    double total = 0.0;
+    _hashmap_table_stats(map->entries, map->capacity, &stats, &total);
+    if (map->old_capacity) _hashmap_table_stats(map->old_entries, map->old_capacity, &stats, &total);
+    stats.mean_displacement = map->size ? total / (double)map->size : 0.0;
+#ifdef VF_HASHMAP_SWISS_TABLE
+    stats.tombstones = map->deleted;
+#endif
+
+    return stats;
+}
+
+#ifdef VF_HASHMAP_ENABLE_CONCURRENT
+
+vf_hashmap_sharded_t* vf_hashmap_sharded_create(const vf_hashmap_config_t* config, size_t shard_count) {
+    if (shard_count == 0) shard_count = VF_HASH_DEFAULT_SHARDS;
+    unsigned bits = 0;
+    while (((size_t)1 << bits) < shard_count) bits++;
+    shard_count = (size_t)1 << bits;
+
+    vf_hashmap_sharded_t* map = (vf_hashmap_sharded_t*)calloc(1, sizeof(vf_hashmap_sharded_t));
+    if (!map) return NULL;
+    map->shards = (vf_hashmap_shard_t*)calloc(shard_count, sizeof(vf_hashmap_shard_t));
+    if (!map->shards) {
+        free(map);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < shard_count; i++) {
+        map->shards[i].map = vf_hashmap_create_with_config(config);
+        if (!map->shards[i].map) {
+            while (i--) {
+                vf_rwlock_destroy(&map->shards[i].lock);
+                vf_hashmap_free(map->shards[i].map);
+            }
+            free(map->shards);
+            free(map);
+            return NULL;
+        }
+        vf_rwlock_init(&map->shards[i].lock);
+    }
+
+    map->shard_count = shard_count;
+    map->shard_bits = bits;
+    map->hasher.value_size = config->value_size;
+    map->hasher.key_size = config->key_size;
+    map->hasher.hash_fn = config->hash_fn;
+    map->hasher.seed = config->seed;
+
+    return map;
+}
+
+void vf_hashmap_sharded_free(vf_hashmap_sharded_t* map) {
+    for (size_t i = 0; i < map->shard_count; i++) {
+        vf_rwlock_destroy(&map->shards[i].lock);
+        vf_hashmap_free(map->shards[i].map);
+    }
+    free(map->shards);
+    free(map);
+}
+
+// The shard comes from the top bits of a remixed hash, so it stays independent of
+// the low bits that index slots even when a weak hash (FNV-1a) only mixes those well.
+static inline vf_hashmap_shard_t* _hashmap_shard(vf_hashmap_sharded_t* map, uint64_t hash) {
+    if (!map->shard_bits) return &map->shards[0];
+    return &map->shards[(size_t)(_hashmap_mix(hash, 0x1d8e4e27c47d124fULL) >> (64 - map->shard_bits))];
+}
+
+int vf_hashmap_sharded_set(vf_hashmap_sharded_t* map, const char* key, const void* value) {
+    return vf_hashmap_sharded_set_n(map, key, strlen(key), value);
+}
+
+int vf_hashmap_sharded_set_n(vf_hashmap_sharded_t* map, const void* key, size_t length, const void* value) {
+    if (!_hashmap_valid_length(&map->hasher, length)) return -1;
+    // Hashing happens before taking the lock to keep the critical section short
+    uint64_t hash = _hashmap_hash(&map->hasher, key, length);
+    vf_hashmap_shard_t* shard = _hashmap_shard(map, hash);
+
+    vf_rwlock_wrlock(&shard->lock);
+    int result = _hashmap_set_hashed(shard->map, key, length, hash, value);
+    vf_rwlock_unlock(&shard->lock);
+
+    return result;
+}
+
+int vf_hashmap_sharded_get(vf_hashmap_sharded_t* map, const char* key, void* out) {
+    return vf_hashmap_sharded_get_n(map, key, strlen(key), out);
+}
+
+int vf_hashmap_sharded_get_n(vf_hashmap_sharded_t* map, const void* key, size_t length, void* out) {
+    if (!_hashmap_valid_length(&map->hasher, length)) return 0;
+    uint64_t hash = _hashmap_hash(&map->hasher, key, length);
+    vf_hashmap_shard_t* shard = _hashmap_shard(map, hash);
+
+    vf_rwlock_rdlock(&shard->lock);
+    size_t index = _hashmap_find(shard->map, key, length, hash);
+    if (index != _VF_HASH_NPOS) memcpy(out, _hashmap_value(shard->map, index), map->hasher.value_size);
+    vf_rwlock_unlock(&shard->lock);
+
+    return index != _VF_HASH_NPOS;
+}
+
+int vf_hashmap_sharded_has(vf_hashmap_sharded_t* map, const char* key) {
+    return vf_hashmap_sharded_has_n(map, key, strlen(key));
+}
+
+int vf_hashmap_sharded_has_n(vf_hashmap_sharded_t* map, const void* key, size_t length) {
+    if (!_hashmap_valid_length(&map->hasher, length)) return 0;
+    uint64_t hash = _hashmap_hash(&map->hasher, key, length);
+    vf_hashmap_shard_t* shard = _hashmap_shard(map, hash);
+
+    vf_rwlock_rdlock(&shard->lock);
+    size_t index = _hashmap_find(shard->map, key, length, hash);
+    vf_rwlock_unlock(&shard->lock);
+
+    return index != _VF_HASH_NPOS;
+}
+
+void vf_hashmap_sharded_remove(vf_hashmap_sharded_t* map, const char* key) {
+    vf_hashmap_sharded_remove_n(map, key, strlen(key));
+}
+
+void vf_hashmap_sharded_remove_n(vf_hashmap_sharded_t* map, const void* key, size_t length) {
+    if (!_hashmap_valid_length(&map->hasher, length)) return;
+    uint64_t hash = _hashmap_hash(&map->hasher, key, length);
+    vf_hashmap_shard_t* shard = _hashmap_shard(map, hash);
+
+    vf_rwlock_wrlock(&shard->lock);
+    _hashmap_remove_hashed(shard->map, key, length, hash);
+    vf_rwlock_unlock(&shard->lock);
+}
+
+size_t vf_hashmap_sharded_size(vf_hashmap_sharded_t* map) {
+    size_t size = 0;
+    for (size_t i = 0; i < map->shard_count; i++) {
+        vf_rwlock_rdlock(&map->shards[i].lock);
+        size += map->shards[i].map->size;
+        vf_rwlock_unlock(&map->shards[i].lock);
+    }
+    return size;
+}
+
+static void _hashmap_build_run_pool(_vf_hashmap_build_job_t* jobs, size_t job_count, void* user) {
+    vf_threadpool_t* pool = (vf_threadpool_t*)user;
+    for (size_t j = 0; j < job_count; ++j) {
+        if (vf_threadpool_add_task(pool, _hashmap_build_hash, &jobs[j]) != VF_THREAD_SUCCESS) {
+            _hashmap_build_hash(&jobs[j]);
+        }
+    }
+    vf_threadpool_wait(pool);
+}
+
+// A few jobs per worker even out ranges that happen to hash slower.
+static size_t _hashmap_build_job_count(const vf_threadpool_t* pool, size_t count) {
+    size_t jobs = (size_t)pool->thread_count * 4;
+    return (count / 1024 < jobs) ? (count / 1024 + 1) : jobs;
+}
+
+vf_hashmap_t* vf_hashmap_build_parallel(const vf_hashmap_config_t* config, const char* const* keys,
+                                        const size_t* lengths, const void* values, size_t count,
+                                        vf_threadpool_t* pool) {
+    return _hashmap_build(config, keys, NULL, lengths, values, count,
+                          _hashmap_build_job_count(pool, count), _hashmap_build_run_pool, pool);
+}
+
+vf_hashmap_t* vf_hashmap_build_keyed_parallel(const vf_hashmap_config_t* config, const void* keys,
+                                              const void* values, size_t count, vf_threadpool_t* pool) {
+    if (config->key_size == 0) return NULL;
+    return _hashmap_build(config, NULL, keys, NULL, values, count,
+                          _hashmap_build_job_count(pool, count), _hashmap_build_run_pool, pool);
+}
+
+vf_hashmap_rcu_t* vf_hashmap_rcu_create(const vf_hashmap_config_t* config) {
+    vf_hashmap_rcu_t* rcu = (vf_hashmap_rcu_t*)calloc(1, sizeof(vf_hashmap_rcu_t));
+    if (!rcu) return NULL;
+    rcu->current = vf_hashmap_create_with_config(config);
+    if (!rcu->current) {
+        free(rcu);
+        return NULL;
+    }
+    vf_mutex_init(&rcu->write_lock);
+    return rcu;
+}
+
+void vf_hashmap_rcu_free(vf_hashmap_rcu_t* rcu) {
+    vf_mutex_destroy(&rcu->write_lock);
+    vf_hashmap_free(rcu->current);
+    free(rcu);
+}
+
+vf_hashmap_t* vf_hashmap_rcu_read_begin(vf_hashmap_rcu_t* rcu, vf_hashmap_rcu_reader_t* reader) {
+    // Threads read through readers on their own stacks, which sit pages apart
+    size_t slot = (size_t)((((uint64_t)(uintptr_t)reader >> 12) * 0x9E3779B97F4A7C15ULL) >> 32) % VF_HASH_RCU_READER_SLOTS;
+
+    // Registering and then seeing the epoch unchanged means a writer that
+    // flips it afterwards will wait for this reader before freeing anything.
+    for (;;) {
+        uint64_t epoch = vf_atomic_load_u64(&rcu->epoch);
+        volatile uint64_t* count = &rcu->readers[epoch & 1][slot].count;
+        vf_atomic_add_u64(count, 1);
+        if (vf_atomic_load_u64(&rcu->epoch) == epoch) {
+            reader->count = count;
+            break;
+        }
+        vf_atomic_add_u64(count, (uint64_t)-1);
+    }
+
+    return (vf_hashmap_t*)vf_atomic_load_ptr((void* volatile*)&rcu->current);
+}
+
+void vf_hashmap_rcu_read_end(vf_hashmap_rcu_t* rcu, vf_hashmap_rcu_reader_t* reader) {
+    (void)rcu;
+    vf_atomic_add_u64(reader->count, (uint64_t)-1);
+}
+
+int vf_hashmap_rcu_get(vf_hashmap_rcu_t* rcu, const char* key, void* out) {
+    return vf_hashmap_rcu_get_n(rcu, key, strlen(key), out);
+}
+
+int vf_hashmap_rcu_get_n(vf_hashmap_rcu_t* rcu, const void* key, size_t length, void* out) {
+    vf_hashmap_rcu_reader_t reader;
+    vf_hashmap_t* map = vf_hashmap_rcu_read_begin(rcu, &reader);
+    const void* value = _hashmap_lookup(map, key, length);
+    if (value) memcpy(out, value, map->value_size);
+    vf_hashmap_rcu_read_end(rcu, &reader);
+    return value != NULL;
+}
+
+int vf_hashmap_rcu_has(vf_hashmap_rcu_t* rcu, const char* key) {
+    return vf_hashmap_rcu_has_n(rcu, key, strlen(key));
+}
+
+int vf_hashmap_rcu_has_n(vf_hashmap_rcu_t* rcu, const void* key, size_t length) {
+    vf_hashmap_rcu_reader_t reader;
+    vf_hashmap_t* map = vf_hashmap_rcu_read_begin(rcu, &reader);
+    int found = _hashmap_contains(map, key, length);
+    vf_hashmap_rcu_read_end(rcu, &reader);
+    return found;
+}
+
+vf_hashmap_t* vf_hashmap_rcu_write_begin(vf_hashmap_rcu_t* rcu) {
+    vf_mutex_lock(&rcu->write_lock);
+    // Only writers replace `current`, so it can be read plainly under the lock
+    vf_hashmap_t* copy = vf_hashmap_clone(rcu->current);
+    if (!copy) vf_mutex_unlock(&rcu->write_lock);
+    return copy;
+}
+
+void vf_hashmap_rcu_write_commit(vf_hashmap_rcu_t* rcu, vf_hashmap_t* map) {
+    vf_hashmap_t* old = rcu->current;
+    vf_atomic_store_ptr((void* volatile*)&rcu->current, map);
+
+    // Readers registered under the old epoch may hold `old`; new ones register
+    // under the next epoch and can only see `map`. Wait for the old ones.
+    uint64_t epoch = rcu->epoch;
+    vf_atomic_store_u64(&rcu->epoch, epoch + 1);
+    for (size_t i = 0; i < VF_HASH_RCU_READER_SLOTS; i++) {
+        while (vf_atomic_load_u64(&rcu->readers[epoch & 1][i].count) != 0) {
+            vf_thread_yield();
+        }
+    }
+
+    vf_hashmap_free(old);
+    vf_mutex_unlock(&rcu->write_lock);
+}
+
+void vf_hashmap_rcu_write_abort(vf_hashmap_rcu_t* rcu, vf_hashmap_t* map) {
+    vf_hashmap_free(map);
+    vf_mutex_unlock(&rcu->write_lock);
+}
+
+int vf_hashmap_rcu_set(vf_hashmap_rcu_t* rcu, const char* key, const void* value) {
+    return vf_hashmap_rcu_set_n(rcu, key, strlen(key), value);
+}
+
+int vf_hashmap_rcu_set_n(vf_hashmap_rcu_t* rcu, const void* key, size_t length, const void* value) {
+    vf_hashmap_t* map = vf_hashmap_rcu_write_begin(rcu);
+    if (!map) return -1;
+    if (_hashmap_set(map, key, length, value) == -1) {
+        vf_hashmap_rcu_write_abort(rcu, map);
+        return -1;
+    }
+    vf_hashmap_rcu_write_commit(rcu, map);
+    return 0;
+}
+
+void vf_hashmap_rcu_remove(vf_hashmap_rcu_t* rcu, const char* key) {
+    vf_hashmap_rcu_remove_n(rcu, key, strlen(key));
+}
+
+void vf_hashmap_rcu_remove_n(vf_hashmap_rcu_t* rcu, const void* key, size_t length) {
+    // Nothing to publish, and no copy to make, if the key is not there
+    if (!vf_hashmap_rcu_has_n(rcu, key, length)) return;
+    vf_hashmap_t* map = vf_hashmap_rcu_write_begin(rcu);
+    if (!map) return;
+    _hashmap_remove(map, key, length);
+    vf_hashmap_rcu_write_commit(rcu, map);
+}
+
+#endif // VF_HASHMAP_ENABLE_CONCURRENT
+
 #endif // VF_HASHMAP_IMPLEMENTATION
 #endif // VF_HASHMAP_H
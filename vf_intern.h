@@ -0,0 +1,493 @@
+/*
+*   vf_intern - v0.12
+*   Header-only string interning library on top of vf_hashmap.h. Maps each
+*   distinct string to a dense 32-bit id (0, 1, 2, ...), so that hot paths can
+*   hash and compare ids instead of strings, and other maps can be keyed by id.
+*
+*   Strings are copied once into an arena that never moves, so the pointer
+*   returned for an id stays valid until the table is freed. The index is an
+*   open addressing table in the style of vf_hashmap, hashed with
+*   `vf_hashmap_hash_bytes`; the implementation of vf_hashmap.h must be
+*   compiled as well (VF_HASHMAP_IMPLEMENTATION).
+*
+*   Define VF_INTERN_ENABLE_CONCURRENT before including (in every translation
+*   unit) to make `vf_intern` safe to call from many threads at once. The index
+*   is then split into shards, each behind its own read-write lock, and ids are
+*   handed out from a counter behind a small lock. It pulls in vf_thread.h,
+*   whose implementation must be compiled somewhere (VF_THREAD_IMPLEMENTATION),
+*   and needs -lpthread outside of Windows.
+*
+*   RECENT CHANGES:
+*       0.12    (2026-10-16)    Fixed an id being used up when allocating its page failed;
+*       0.11    (2026-10-16)    Fixed id -> string entries being written and read without
+*                               atomics in concurrent mode;
+*                               Removed the unused `seed` field;
+*       0.1     (2026-10-16)    Finalized the implementation;
+*
+*   LICENSE: MIT License
+*       Copyright (c) 2024 Viktor Fejes
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+*   TODOs:
+*       - [ ] Save/load of a whole table, like `vf_hashmap_save`
+*
+ */
+
+#ifndef VF_INTERN_H
+#define VF_INTERN_H
+
+#include "vf_hashmap.h"
+
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+#    include "vf_thread.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Returned instead of an id for strings that are not (and could not be) interned.
+#define VF_INTERN_INVALID UINT32_MAX
+
+// Id limit used when 0 is passed to `vf_intern_create`.
+#define VF_INTERN_DEFAULT_MAX (1u << 24)
+
+// Ids per page of the id -> string table. Pages are allocated as ids reach
+// them and never move, so lookups by id need no lock.
+#define VF_INTERN_PAGE_BITS 12
+
+// Bytes per arena block. Strings longer than a quarter of it get a block of their own.
+#define VF_INTERN_BLOCK_SIZE (64 * 1024)
+
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+#    define VF_INTERN_SHARDS 64
+#else
+#    define VF_INTERN_SHARDS 1
+#endif
+
+typedef struct {
+    uint32_t id;            // Id + 1, 0 for an empty slot
+    uint32_t tag;           // High half of the string's hash; also picks the slot
+} vf_intern_slot_t;
+
+typedef struct {
+    vf_intern_slot_t* slots;
+    size_t capacity;
+    size_t size;
+    char* blocks;           // Arena blocks, chained through their first bytes
+    char* block;            // Block new strings are appended to
+    size_t block_used;
+    size_t arena_bytes;
+    size_t string_bytes;
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    vf_rwlock_t lock;
+    char padding[64];       // Keeps neighbouring shards off each other's cache line
+#endif
+} vf_intern_shard_t;
+
+typedef struct {
+    vf_intern_shard_t shards[VF_INTERN_SHARDS];
+    const char*** pages;    // Id -> string, VF_INTERN_PAGE_BITS ids per page
+    size_t page_count;
+    size_t max_strings;
+    volatile uint64_t count;    // Ids handed out so far
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    vf_mutex_t pages_lock;
+#endif
+} vf_intern_t;
+
+typedef struct {
+    size_t count;           // Strings interned
+    size_t string_bytes;    // Their length summed up, without terminators
+    size_t arena_bytes;     // Arena blocks holding them
+    size_t index_bytes;     // Hash index slots
+    size_t id_table_bytes;  // Id -> string pages and their directory
+    size_t total_bytes;     // All of the above and the table itself
+} vf_intern_memory_t;
+
+// Creates a table that hands out up to `max_strings` ids (0 for
+// VF_INTERN_DEFAULT_MAX, at most UINT32_MAX). NULL if out of memory.
+extern vf_intern_t* vf_intern_create(size_t max_strings);
+extern void vf_intern_free(vf_intern_t* table);
+// Returns the id of `string`, interning it first if it is new, or
+// VF_INTERN_INVALID if the table is full or out of memory.
+extern uint32_t vf_intern(vf_intern_t* table, const char* string);
+// Same as above, but the string is `length` bytes and does not need a terminating zero.
+extern uint32_t vf_intern_n(vf_intern_t* table, const char* string, size_t length);
+// Returns the id of `string` if it was interned, without adding it otherwise.
+extern uint32_t vf_intern_find(vf_intern_t* table, const char* string);
+extern uint32_t vf_intern_find_n(vf_intern_t* table, const char* string, size_t length);
+// The zero terminated string behind an id returned by `vf_intern`, valid
+// until the table is freed. NULL for ids that were never handed out.
+// NOTE: With VF_INTERN_ENABLE_CONCURRENT an id is counted just before its
+// string is published, so ids below `vf_intern_count` that another thread
+// is still interning may briefly give NULL (and a length of 0).
+extern const char* vf_intern_string(const vf_intern_t* table, uint32_t id);
+extern size_t vf_intern_length(const vf_intern_t* table, uint32_t id);
+extern size_t vf_intern_count(const vf_intern_t* table);
+extern vf_intern_memory_t vf_intern_memory(vf_intern_t* table);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END OF HEADER. -----------------------------------------
+
+#ifdef VF_INTERN_IMPLEMENTATION
+
+#include <string.h>
+#include <stdlib.h>
+
+#define _VF_INTERN_PAGE_SIZE ((size_t)1 << VF_INTERN_PAGE_BITS)
+#define _VF_INTERN_INITIAL_SLOTS 16
+// Arena blocks start with the pointer that chains them.
+#define _VF_INTERN_BLOCK_HEADER sizeof(char*)
+
+static inline const char** _intern_load_page(const vf_intern_t* table, size_t index) {
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    return (const char**)vf_atomic_load_ptr((void* volatile*)&table->pages[index]);
+#else
+    return table->pages[index];
+#endif
+}
+
+// Hands out the next id and returns the page it goes in, allocating the
+// page first so that an id is only counted once its entry exists. Returns
+// NULL if the table is full or out of memory, without using up an id.
+static const char** _intern_claim_id(vf_intern_t* table, uint64_t* id) {
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    // Shards draw ids under one lock; it is held for a few instructions, and
+    // only while interning strings that are new
+    vf_mutex_lock(&table->pages_lock);
+#endif
+    uint64_t next = table->count;
+    size_t index = (size_t)(next >> VF_INTERN_PAGE_BITS);
+    const char** page = NULL;
+
+    if (next < table->max_strings) {
+        page = table->pages[index];
+        if (!page) {
+            page = (const char**)calloc(_VF_INTERN_PAGE_SIZE, sizeof(const char*));
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+            if (page) vf_atomic_store_ptr((void* volatile*)&table->pages[index], (void*)page);
+#else
+            table->pages[index] = page;
+#endif
+        }
+    }
+    if (page) {
+        *id = next;
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+        vf_atomic_store_u64(&table->count, next + 1);
+#else
+        table->count = next + 1;
+#endif
+    }
+
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    vf_mutex_unlock(&table->pages_lock);
+#endif
+    return page;
+}
+
+// Stored strings are preceded by their length.
+static inline uint32_t _intern_stored_length(const char* stored) {
+    uint32_t length;
+    memcpy(&length, stored - sizeof(uint32_t), sizeof(length));
+    return length;
+}
+
+// Copies the string into the shard's arena, with its length in front and a
+// terminating zero after it.
+static const char* _intern_store(vf_intern_shard_t* shard, const char* string, size_t length) {
+    // Rounded up so the next length prefix stays aligned
+    size_t needed = (sizeof(uint32_t) + length + 1 + 3) & ~(size_t)3;
+    char* target;
+
+    if (needed > VF_INTERN_BLOCK_SIZE / 4) {
+        // Long strings get a block of their own, so the current one is not wasted
+        char* block = (char*)malloc(_VF_INTERN_BLOCK_HEADER + needed);
+        if (!block) return NULL;
+        *(char**)block = shard->blocks;
+        shard->blocks = block;
+        shard->arena_bytes += _VF_INTERN_BLOCK_HEADER + needed;
+        target = block + _VF_INTERN_BLOCK_HEADER;
+    } else {
+        if (!shard->block || shard->block_used + needed > VF_INTERN_BLOCK_SIZE) {
+            char* block = (char*)malloc(VF_INTERN_BLOCK_SIZE);
+            if (!block) return NULL;
+            *(char**)block = shard->blocks;
+            shard->blocks = block;
+            shard->block = block;
+            shard->block_used = _VF_INTERN_BLOCK_HEADER;
+            shard->arena_bytes += VF_INTERN_BLOCK_SIZE;
+        }
+        target = shard->block + shard->block_used;
+        shard->block_used += needed;
+    }
+
+    uint32_t stored_length = (uint32_t)length;
+    memcpy(target, &stored_length, sizeof(stored_length));
+    memcpy(target + sizeof(uint32_t), string, length);
+    target[sizeof(uint32_t) + length] = '\0';
+    shard->string_bytes += length;
+
+    return target + sizeof(uint32_t);
+}
+
+// Id -> string entries are read without a lock by `vf_intern_string`.
+static inline const char* _intern_load_entry(const char** page, size_t index) {
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    return (const char*)vf_atomic_load_ptr((void* volatile*)&page[index]);
+#else
+    return page[index];
+#endif
+}
+
+static inline const char* _intern_lookup_id(const vf_intern_t* table, uint32_t id) {
+    return _intern_load_entry(_intern_load_page(table, id >> VF_INTERN_PAGE_BITS), id & (_VF_INTERN_PAGE_SIZE - 1));
+}
+
+static uint32_t _intern_find(const vf_intern_t* table, const vf_intern_shard_t* shard,
+                             const char* string, size_t length, uint32_t tag) {
+    size_t mask = shard->capacity - 1;
+    for (size_t i = tag & mask;; i = (i + 1) & mask) {
+        const vf_intern_slot_t* slot = &shard->slots[i];
+        if (slot->id == 0) return VF_INTERN_INVALID;
+        if (slot->tag != tag) continue;
+
+        const char* stored = _intern_lookup_id(table, slot->id - 1);
+        if (_intern_stored_length(stored) == length && memcmp(stored, string, length) == 0) {
+            return slot->id - 1;
+        }
+    }
+}
+
+static void _intern_place(vf_intern_slot_t* slots, size_t capacity, vf_intern_slot_t slot) {
+    size_t mask = capacity - 1;
+    size_t i = slot.tag & mask;
+    while (slots[i].id != 0) i = (i + 1) & mask;
+    slots[i] = slot;
+}
+
+// Doubles the index. Slots carry their tag, so no string is read or rehashed.
+static int _intern_grow(vf_intern_shard_t* shard) {
+    size_t capacity = shard->capacity * 2;
+    vf_intern_slot_t* slots = (vf_intern_slot_t*)calloc(capacity, sizeof(vf_intern_slot_t));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < shard->capacity; ++i) {
+        if (shard->slots[i].id != 0) _intern_place(slots, capacity, shard->slots[i]);
+    }
+    free(shard->slots);
+    shard->slots = slots;
+    shard->capacity = capacity;
+
+    return 0;
+}
+
+static uint32_t _intern_insert(vf_intern_t* table, vf_intern_shard_t* shard,
+                               const char* string, size_t length, uint32_t tag) {
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    if (vf_atomic_load_u64(&table->count) >= table->max_strings) return VF_INTERN_INVALID;
+#else
+    if (table->count >= table->max_strings) return VF_INTERN_INVALID;
+#endif
+    // Tags are 32 bits, and so is the widest index they can address
+    if (shard->capacity > UINT32_MAX / 2 && shard->size + 1 > shard->capacity * VF_HASH_LOAD_FACTOR) {
+        return VF_INTERN_INVALID;
+    }
+    if (shard->size + 1 > shard->capacity * VF_HASH_LOAD_FACTOR && _intern_grow(shard) == -1) {
+        return VF_INTERN_INVALID;
+    }
+
+    const char* stored = _intern_store(shard, string, length);
+    if (!stored) return VF_INTERN_INVALID;
+
+    // If the last ids went to other shards meanwhile, the stored bytes stay unused
+    uint64_t id;
+    const char** page = _intern_claim_id(table, &id);
+    if (!page) return VF_INTERN_INVALID;
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    vf_atomic_store_ptr((void* volatile*)&page[id & (_VF_INTERN_PAGE_SIZE - 1)], (void*)stored);
+#else
+    page[id & (_VF_INTERN_PAGE_SIZE - 1)] = stored;
+#endif
+
+    vf_intern_slot_t slot;
+    slot.id = (uint32_t)id + 1;
+    slot.tag = tag;
+    _intern_place(shard->slots, shard->capacity, slot);
+    shard->size++;
+
+    return (uint32_t)id;
+}
+
+static uint32_t _intern(vf_intern_t* table, const char* string, size_t length, int insert) {
+    if (length > UINT32_MAX - 8) return VF_INTERN_INVALID;
+
+    uint64_t hash = vf_hashmap_hash_bytes(string, length, 0);
+    uint32_t tag = (uint32_t)(hash >> 32);
+    // The low bits pick the shard, the high ones the slot
+    vf_intern_shard_t* shard = &table->shards[hash & (VF_INTERN_SHARDS - 1)];
+
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    vf_rwlock_rdlock(&shard->lock);
+    uint32_t id = _intern_find(table, shard, string, length, tag);
+    vf_rwlock_unlock(&shard->lock);
+    if (id != VF_INTERN_INVALID || !insert) return id;
+
+    vf_rwlock_wrlock(&shard->lock);
+    // Another thread may have added it since the read lock was dropped
+    id = _intern_find(table, shard, string, length, tag);
+    if (id == VF_INTERN_INVALID) id = _intern_insert(table, shard, string, length, tag);
+    vf_rwlock_unlock(&shard->lock);
+    return id;
+#else
+    uint32_t id = _intern_find(table, shard, string, length, tag);
+    if (id != VF_INTERN_INVALID || !insert) return id;
+    return _intern_insert(table, shard, string, length, tag);
+#endif
+}
+
+vf_intern_t* vf_intern_create(size_t max_strings) {
+    if (max_strings == 0) max_strings = VF_INTERN_DEFAULT_MAX;
+    if (max_strings > UINT32_MAX) max_strings = UINT32_MAX;
+
+    vf_intern_t* table = (vf_intern_t*)calloc(1, sizeof(vf_intern_t));
+    if (!table) return NULL;
+
+    table->max_strings = max_strings;
+    table->page_count = (max_strings + _VF_INTERN_PAGE_SIZE - 1) >> VF_INTERN_PAGE_BITS;
+    table->pages = (const char***)calloc(table->page_count, sizeof(const char**));
+    int failed = !table->pages;
+    for (size_t i = 0; i < VF_INTERN_SHARDS; ++i) {
+        vf_intern_shard_t* shard = &table->shards[i];
+        shard->slots = (vf_intern_slot_t*)calloc(_VF_INTERN_INITIAL_SLOTS, sizeof(vf_intern_slot_t));
+        shard->capacity = _VF_INTERN_INITIAL_SLOTS;
+        failed |= !shard->slots;
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+        vf_rwlock_init(&shard->lock);
+#endif
+    }
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    vf_mutex_init(&table->pages_lock);
+#endif
+
+    if (failed) {
+        vf_intern_free(table);
+        return NULL;
+    }
+    return table;
+}
+
+void vf_intern_free(vf_intern_t* table) {
+    for (size_t i = 0; i < VF_INTERN_SHARDS; ++i) {
+        vf_intern_shard_t* shard = &table->shards[i];
+        while (shard->blocks) {
+            char* next = *(char**)shard->blocks;
+            free(shard->blocks);
+            shard->blocks = next;
+        }
+        free(shard->slots);
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+        vf_rwlock_destroy(&shard->lock);
+#endif
+    }
+    if (table->pages) {
+        for (size_t i = 0; i < table->page_count; ++i) {
+            free((void*)table->pages[i]);
+        }
+        free(table->pages);
+    }
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    vf_mutex_destroy(&table->pages_lock);
+#endif
+    free(table);
+}
+
+uint32_t vf_intern(vf_intern_t* table, const char* string) {
+    return _intern(table, string, strlen(string), 1);
+}
+
+uint32_t vf_intern_n(vf_intern_t* table, const char* string, size_t length) {
+    return _intern(table, string, length, 1);
+}
+
+uint32_t vf_intern_find(vf_intern_t* table, const char* string) {
+    return _intern(table, string, strlen(string), 0);
+}
+
+uint32_t vf_intern_find_n(vf_intern_t* table, const char* string, size_t length) {
+    return _intern(table, string, length, 0);
+}
+
+const char* vf_intern_string(const vf_intern_t* table, uint32_t id) {
+    if (id >= table->max_strings) return NULL;
+    const char** page = _intern_load_page(table, id >> VF_INTERN_PAGE_BITS);
+    return page ? _intern_load_entry(page, id & (_VF_INTERN_PAGE_SIZE - 1)) : NULL;
+}
+
+size_t vf_intern_length(const vf_intern_t* table, uint32_t id) {
+    const char* stored = vf_intern_string(table, id);
+    return stored ? _intern_stored_length(stored) : 0;
+}
+
+size_t vf_intern_count(const vf_intern_t* table) {
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+    uint64_t count = vf_atomic_load_u64((volatile uint64_t*)&table->count);
+#else
+    uint64_t count = table->count;
+#endif
+    return (size_t)count;
+}
+
+vf_intern_memory_t vf_intern_memory(vf_intern_t* table) {
+    vf_intern_memory_t memory;
+    memset(&memory, 0, sizeof(memory));
+
+    for (size_t i = 0; i < VF_INTERN_SHARDS; ++i) {
+        vf_intern_shard_t* shard = &table->shards[i];
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+        vf_rwlock_rdlock(&shard->lock);
+#endif
+        memory.count += shard->size;
+        memory.string_bytes += shard->string_bytes;
+        memory.arena_bytes += shard->arena_bytes;
+        memory.index_bytes += shard->capacity * sizeof(vf_intern_slot_t);
+#ifdef VF_INTERN_ENABLE_CONCURRENT
+        vf_rwlock_unlock(&shard->lock);
+#endif
+    }
+
+    memory.id_table_bytes = table->page_count * sizeof(const char**);
+    for (size_t i = 0; i < table->page_count; ++i) {
+        if (_intern_load_page(table, i)) memory.id_table_bytes += _VF_INTERN_PAGE_SIZE * sizeof(const char*);
+    }
+    memory.total_bytes = sizeof(vf_intern_t) + memory.arena_bytes + memory.index_bytes + memory.id_table_bytes;
+
+    return memory;
+}
+
+#endif // VF_INTERN_IMPLEMENTATION
+#endif // VF_INTERN_H
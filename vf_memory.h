@@ -1,8 +1,23 @@
 /*
-*   vf_memory - v0.21
+*   vf_memory - v0.3
 *   Header-only tiny memory library.
 *
+*   `vf_memcpy`, `vf_memset` and `vf_memswap` move 8 bytes at a time on any
+*   CPU, and 16 (SSE2) or 32 (AVX2) bytes at a time on x86. The widest
+*   kernel the CPU supports is picked on the first call; `vf_mem_set_kernel`
+*   can force a narrower one. The unaligned head and tail of a block are
+*   handled with overlapping or narrower moves, so the main loop always
+*   stores to aligned addresses. Copies and fills of VF_MEM_STREAM_THRESHOLD
+*   bytes or more use non-temporal stores, which skip the cache.
+*
+*   The AVX2 kernels are compiled with a target attribute (GCC, clang) or
+*   as is (MSVC), so no -mavx2 is needed, and the program still runs on
+*   CPUs without AVX2.
+*
 *   RECENT CHANGES:
+*       0.3     (2026-10-16)    Word, SSE2 and AVX2 kernels with runtime dispatch;
+*                               Added `vf_mem_get_kernel`, `vf_mem_set_kernel` and
+*                               `vf_mem_kernel_supported`;
 *       0.21    (2024-06-18)    Changed filename to `vf_memory.h`;
 *       0.2     (2024-06-17)    Added `vf_` prefix to function names;
 *                               Improved header-only implementation;
@@ -28,21 +43,38 @@
 *       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 *       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 *       SOFTWARE.
+*
+*   TODOs:
+*       - [ ] NEON kernels
 *
  */
 
 #ifndef VF_MEMORY_H
 #define VF_MEMORY_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Copies and fills of at least this many bytes bypass the cache, so one huge
+// block doesn't evict everything else. Can be defined before including.
+#ifndef VF_MEM_STREAM_THRESHOLD
+#    define VF_MEM_STREAM_THRESHOLD (8 * 1024 * 1024)
+#endif
+
+typedef enum {
+    VF_MEM_KERNEL_WORD,     // 8 bytes at a time, any CPU
+    VF_MEM_KERNEL_SSE2,     // 16 bytes at a time, x86
+    VF_MEM_KERNEL_AVX2,     // 32 bytes at a time, x86 with AVX2
+} vf_mem_kernel_t;
+
 /**
  * @brief Reimplementation of `memcpy`, so the <string.h> header doesn't
- * need to be included.
+ * need to be included. The blocks must not overlap.
  *
  * @param dst Pointer to the destination (copy-to).
  * @param src Pointer to the source (copy-from).
@@ -64,7 +96,7 @@ extern void* vf_memcpy(void* dst, const void* src, size_t size);
 extern void* vf_memset(void* dst, int value, size_t size);
 
 /**
- * @brief Swap two equal size chunks in memory.
+ * @brief Swap two equal size chunks in memory. The chunks must not overlap.
  *
  * @param ptr_a Pointer to one block of memory.
  * @param ptr_b Pointer to another block of memory.
@@ -72,6 +104,21 @@ extern void* vf_memset(void* dst, int value, size_t size);
  */
 extern void vf_memswap(void* ptr_a, void* ptr_b, size_t size);
 
+/**
+ * @brief Returns the kernel the functions above run on, picking the widest
+ * one the CPU supports if none was picked yet.
+ */
+extern vf_mem_kernel_t vf_mem_get_kernel(void);
+
+/**
+ * @brief Makes the functions above run on `kernel`, e.g. to compare them.
+ *
+ * @return false if the CPU (or the build) doesn't support it; nothing changes then.
+ */
+extern bool vf_mem_set_kernel(vf_mem_kernel_t kernel);
+
+extern bool vf_mem_kernel_supported(vf_mem_kernel_t kernel);
+
 #ifdef __cplusplus
 }
 #endif
@@ -80,34 +127,555 @@ extern void vf_memswap(void* ptr_a, void* ptr_b, size_t size);
 
 #ifdef VF_MEM_IMPLEMENTATION
 
-void* vf_memcpy(void* dst, const void* src, size_t size) {
-    unsigned char* d = (unsigned char*)dst;
-    const unsigned char* s = (const unsigned char*)src;
-    while (size--) {
-        *d++ = *s++;
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__)) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <immintrin.h>
+#    define VF_MEM_X86
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#    include <intrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#    define _VF_MEM_AVX2 __attribute__((target("avx2")))
+// Words that may sit at any address and alias any type.
+typedef uint64_t __attribute__((may_alias, aligned(1))) _vf_mem_u64;
+typedef uint32_t __attribute__((may_alias, aligned(1))) _vf_mem_u32;
+#else
+#    define _VF_MEM_AVX2
+typedef uint64_t _vf_mem_u64;
+typedef uint32_t _vf_mem_u32;
+#endif
+
+// Blocks up to 16 bytes: two possibly overlapping moves, whatever the size.
+static inline void _vf_mem_copy_small(uint8_t* d, const uint8_t* s, size_t size) {
+    if (size >= 8) {
+        uint64_t head = *(const _vf_mem_u64*)s;
+        uint64_t tail = *(const _vf_mem_u64*)(s + size - 8);
+        *(_vf_mem_u64*)d = head;
+        *(_vf_mem_u64*)(d + size - 8) = tail;
+    } else if (size >= 4) {
+        uint32_t head = *(const _vf_mem_u32*)s;
+        uint32_t tail = *(const _vf_mem_u32*)(s + size - 4);
+        *(_vf_mem_u32*)d = head;
+        *(_vf_mem_u32*)(d + size - 4) = tail;
+    } else if (size > 0) {
+        // 1 to 3 bytes: first, middle and last, which overlap as needed
+        uint8_t first = s[0], middle = s[size / 2], final = s[size - 1];
+        d[0] = first;
+        d[size / 2] = middle;
+        d[size - 1] = final;
     }
-    return dst;
 }
 
-void* vf_memset(void* dst, int value, size_t size) {
-    unsigned char* d = (unsigned char*)dst;
-    while (size--) {
-        *d++ = (unsigned char)value;
+static inline void _vf_mem_set_small(uint8_t* d, uint64_t pattern, size_t size) {
+    if (size >= 8) {
+        *(_vf_mem_u64*)d = pattern;
+        *(_vf_mem_u64*)(d + size - 8) = pattern;
+    } else if (size >= 4) {
+        *(_vf_mem_u32*)d = (uint32_t)pattern;
+        *(_vf_mem_u32*)(d + size - 4) = (uint32_t)pattern;
+    } else if (size > 0) {
+        d[0] = (uint8_t)pattern;
+        d[size / 2] = (uint8_t)pattern;
+        d[size - 1] = (uint8_t)pattern;
     }
-    return dst;
 }
 
-void vf_memswap(void* ptr_a, void* ptr_b, size_t size) {
-    unsigned char* a = (unsigned char*)ptr_a;
-    unsigned char* b = (unsigned char*)ptr_b;
-    unsigned char temp;
+// Swapped halves can't overlap the way copies can, so the tail steps down
+// through narrower moves instead.
+static void _vf_memswap_word(void* ptr_a, void* ptr_b, size_t size) {
+    uint8_t* a = (uint8_t*)ptr_a;
+    uint8_t* b = (uint8_t*)ptr_b;
 
+    while (size >= 32) {
+        uint64_t a0 = ((_vf_mem_u64*)a)[0], a1 = ((_vf_mem_u64*)a)[1], a2 = ((_vf_mem_u64*)a)[2], a3 = ((_vf_mem_u64*)a)[3];
+        uint64_t b0 = ((_vf_mem_u64*)b)[0], b1 = ((_vf_mem_u64*)b)[1], b2 = ((_vf_mem_u64*)b)[2], b3 = ((_vf_mem_u64*)b)[3];
+        ((_vf_mem_u64*)a)[0] = b0; ((_vf_mem_u64*)a)[1] = b1; ((_vf_mem_u64*)a)[2] = b2; ((_vf_mem_u64*)a)[3] = b3;
+        ((_vf_mem_u64*)b)[0] = a0; ((_vf_mem_u64*)b)[1] = a1; ((_vf_mem_u64*)b)[2] = a2; ((_vf_mem_u64*)b)[3] = a3;
+        a += 32;
+        b += 32;
+        size -= 32;
+    }
+    while (size >= 8) {
+        uint64_t temp = *(_vf_mem_u64*)a;
+        *(_vf_mem_u64*)a = *(_vf_mem_u64*)b;
+        *(_vf_mem_u64*)b = temp;
+        a += 8;
+        b += 8;
+        size -= 8;
+    }
+    if (size >= 4) {
+        uint32_t temp = *(_vf_mem_u32*)a;
+        *(_vf_mem_u32*)a = *(_vf_mem_u32*)b;
+        *(_vf_mem_u32*)b = temp;
+        a += 4;
+        b += 4;
+        size -= 4;
+    }
     while (size--) {
-        temp = *a;
+        uint8_t temp = *a;
         *a++ = *b;
         *b++ = temp;
     }
 }
 
+static void* _vf_memcpy_word(void* dst, const void* src, size_t size) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    if (size <= 16) {
+        _vf_mem_copy_small(d, s, size);
+        return dst;
+    }
+
+    // The first and last words are copied unaligned, the rest with aligned stores
+    uint64_t head = *(const _vf_mem_u64*)s;
+    uint64_t tail = *(const _vf_mem_u64*)(s + size - 8);
+    uint8_t* last = d + size - 8;
+    size_t skip = 8 - ((uintptr_t)d & 7);
+    d += skip;
+    s += skip;
+    size -= skip;
+
+    while (size >= 32) {
+        uint64_t w0 = ((const _vf_mem_u64*)s)[0], w1 = ((const _vf_mem_u64*)s)[1];
+        uint64_t w2 = ((const _vf_mem_u64*)s)[2], w3 = ((const _vf_mem_u64*)s)[3];
+        ((_vf_mem_u64*)d)[0] = w0; ((_vf_mem_u64*)d)[1] = w1; ((_vf_mem_u64*)d)[2] = w2; ((_vf_mem_u64*)d)[3] = w3;
+        d += 32;
+        s += 32;
+        size -= 32;
+    }
+    while (size >= 8) {
+        *(_vf_mem_u64*)d = *(const _vf_mem_u64*)s;
+        d += 8;
+        s += 8;
+        size -= 8;
+    }
+    *(_vf_mem_u64*)dst = head;
+    *(_vf_mem_u64*)last = tail;
+
+    return dst;
+}
+
+static void* _vf_memset_word(void* dst, int value, size_t size) {
+    uint8_t* d = (uint8_t*)dst;
+    uint64_t pattern = (uint64_t)(uint8_t)value * 0x0101010101010101ULL;
+    if (size <= 16) {
+        _vf_mem_set_small(d, pattern, size);
+        return dst;
+    }
+
+    *(_vf_mem_u64*)d = pattern;
+    *(_vf_mem_u64*)(d + size - 8) = pattern;
+    size_t skip = 8 - ((uintptr_t)d & 7);
+    d += skip;
+    size -= skip;
+    while (size >= 32) {
+        ((_vf_mem_u64*)d)[0] = pattern; ((_vf_mem_u64*)d)[1] = pattern;
+        ((_vf_mem_u64*)d)[2] = pattern; ((_vf_mem_u64*)d)[3] = pattern;
+        d += 32;
+        size -= 32;
+    }
+    while (size >= 8) {
+        *(_vf_mem_u64*)d = pattern;
+        d += 8;
+        size -= 8;
+    }
+
+    return dst;
+}
+
+#ifdef VF_MEM_X86
+
+static void* _vf_memcpy_sse2(void* dst, const void* src, size_t size) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    if (size <= 16) {
+        _vf_mem_copy_small(d, s, size);
+        return dst;
+    }
+    __m128i head = _mm_loadu_si128((const __m128i*)s);
+    __m128i tail = _mm_loadu_si128((const __m128i*)(s + size - 16));
+    uint8_t* last = d + size - 16;
+    if (size <= 32) {
+        _mm_storeu_si128((__m128i*)d, head);
+        _mm_storeu_si128((__m128i*)last, tail);
+        return dst;
+    }
+
+    size_t skip = 16 - ((uintptr_t)d & 15);
+    d += skip;
+    s += skip;
+    size -= skip;
+    if (size >= VF_MEM_STREAM_THRESHOLD) {
+        while (size >= 64) {
+            __m128i v0 = _mm_loadu_si128((const __m128i*)s + 0), v1 = _mm_loadu_si128((const __m128i*)s + 1);
+            __m128i v2 = _mm_loadu_si128((const __m128i*)s + 2), v3 = _mm_loadu_si128((const __m128i*)s + 3);
+            _mm_stream_si128((__m128i*)d + 0, v0);
+            _mm_stream_si128((__m128i*)d + 1, v1);
+            _mm_stream_si128((__m128i*)d + 2, v2);
+            _mm_stream_si128((__m128i*)d + 3, v3);
+            d += 64;
+            s += 64;
+            size -= 64;
+        }
+        _mm_sfence();
+    }
+    while (size >= 64) {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)s + 0), v1 = _mm_loadu_si128((const __m128i*)s + 1);
+        __m128i v2 = _mm_loadu_si128((const __m128i*)s + 2), v3 = _mm_loadu_si128((const __m128i*)s + 3);
+        _mm_store_si128((__m128i*)d + 0, v0);
+        _mm_store_si128((__m128i*)d + 1, v1);
+        _mm_store_si128((__m128i*)d + 2, v2);
+        _mm_store_si128((__m128i*)d + 3, v3);
+        d += 64;
+        s += 64;
+        size -= 64;
+    }
+    while (size >= 16) {
+        _mm_store_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+        d += 16;
+        s += 16;
+        size -= 16;
+    }
+    _mm_storeu_si128((__m128i*)dst, head);
+    _mm_storeu_si128((__m128i*)last, tail);
+
+    return dst;
+}
+
+static void* _vf_memset_sse2(void* dst, int value, size_t size) {
+    uint8_t* d = (uint8_t*)dst;
+    if (size <= 16) {
+        _vf_mem_set_small(d, (uint64_t)(uint8_t)value * 0x0101010101010101ULL, size);
+        return dst;
+    }
+    __m128i pattern = _mm_set1_epi8((char)value);
+    _mm_storeu_si128((__m128i*)d, pattern);
+    _mm_storeu_si128((__m128i*)(d + size - 16), pattern);
+
+    size_t skip = 16 - ((uintptr_t)d & 15);
+    d += skip;
+    size -= skip;
+    if (size >= VF_MEM_STREAM_THRESHOLD) {
+        while (size >= 64) {
+            _mm_stream_si128((__m128i*)d + 0, pattern);
+            _mm_stream_si128((__m128i*)d + 1, pattern);
+            _mm_stream_si128((__m128i*)d + 2, pattern);
+            _mm_stream_si128((__m128i*)d + 3, pattern);
+            d += 64;
+            size -= 64;
+        }
+        _mm_sfence();
+    }
+    while (size >= 64) {
+        _mm_store_si128((__m128i*)d + 0, pattern);
+        _mm_store_si128((__m128i*)d + 1, pattern);
+        _mm_store_si128((__m128i*)d + 2, pattern);
+        _mm_store_si128((__m128i*)d + 3, pattern);
+        d += 64;
+        size -= 64;
+    }
+    while (size >= 16) {
+        _mm_store_si128((__m128i*)d, pattern);
+        d += 16;
+        size -= 16;
+    }
+
+    return dst;
+}
+
+static void _vf_memswap_sse2(void* ptr_a, void* ptr_b, size_t size) {
+    uint8_t* a = (uint8_t*)ptr_a;
+    uint8_t* b = (uint8_t*)ptr_b;
+    if (size >= 64) {
+        // Align `a`; `b` is as aligned as it happens to be
+        size_t skip = (16 - ((uintptr_t)a & 15)) & 15;
+        _vf_memswap_word(a, b, skip);
+        a += skip;
+        b += skip;
+        size -= skip;
+    }
+    while (size >= 64) {
+        __m128i a0 = _mm_load_si128((__m128i*)a + 0), a1 = _mm_load_si128((__m128i*)a + 1);
+        __m128i a2 = _mm_load_si128((__m128i*)a + 2), a3 = _mm_load_si128((__m128i*)a + 3);
+        __m128i b0 = _mm_loadu_si128((__m128i*)b + 0), b1 = _mm_loadu_si128((__m128i*)b + 1);
+        __m128i b2 = _mm_loadu_si128((__m128i*)b + 2), b3 = _mm_loadu_si128((__m128i*)b + 3);
+        _mm_store_si128((__m128i*)a + 0, b0);
+        _mm_store_si128((__m128i*)a + 1, b1);
+        _mm_store_si128((__m128i*)a + 2, b2);
+        _mm_store_si128((__m128i*)a + 3, b3);
+        _mm_storeu_si128((__m128i*)b + 0, a0);
+        _mm_storeu_si128((__m128i*)b + 1, a1);
+        _mm_storeu_si128((__m128i*)b + 2, a2);
+        _mm_storeu_si128((__m128i*)b + 3, a3);
+        a += 64;
+        b += 64;
+        size -= 64;
+    }
+    while (size >= 16) {
+        __m128i va = _mm_loadu_si128((__m128i*)a);
+        __m128i vb = _mm_loadu_si128((__m128i*)b);
+        _mm_storeu_si128((__m128i*)a, vb);
+        _mm_storeu_si128((__m128i*)b, va);
+        a += 16;
+        b += 16;
+        size -= 16;
+    }
+    _vf_memswap_word(a, b, size);
+}
+
+_VF_MEM_AVX2 static void* _vf_memcpy_avx2(void* dst, const void* src, size_t size) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    if (size <= 32) {
+        return _vf_memcpy_sse2(dst, src, size);
+    }
+    __m256i head = _mm256_loadu_si256((const __m256i*)s);
+    __m256i tail = _mm256_loadu_si256((const __m256i*)(s + size - 32));
+    uint8_t* last = d + size - 32;
+    if (size <= 64) {
+        _mm256_storeu_si256((__m256i*)d, head);
+        _mm256_storeu_si256((__m256i*)last, tail);
+        return dst;
+    }
+
+    size_t skip = 32 - ((uintptr_t)d & 31);
+    d += skip;
+    s += skip;
+    size -= skip;
+    if (size >= VF_MEM_STREAM_THRESHOLD) {
+        while (size >= 128) {
+            __m256i v0 = _mm256_loadu_si256((const __m256i*)s + 0), v1 = _mm256_loadu_si256((const __m256i*)s + 1);
+            __m256i v2 = _mm256_loadu_si256((const __m256i*)s + 2), v3 = _mm256_loadu_si256((const __m256i*)s + 3);
+            _mm256_stream_si256((__m256i*)d + 0, v0);
+            _mm256_stream_si256((__m256i*)d + 1, v1);
+            _mm256_stream_si256((__m256i*)d + 2, v2);
+            _mm256_stream_si256((__m256i*)d + 3, v3);
+            d += 128;
+            s += 128;
+            size -= 128;
+        }
+        _mm_sfence();
+    }
+    while (size >= 128) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)s + 0), v1 = _mm256_loadu_si256((const __m256i*)s + 1);
+        __m256i v2 = _mm256_loadu_si256((const __m256i*)s + 2), v3 = _mm256_loadu_si256((const __m256i*)s + 3);
+        _mm256_store_si256((__m256i*)d + 0, v0);
+        _mm256_store_si256((__m256i*)d + 1, v1);
+        _mm256_store_si256((__m256i*)d + 2, v2);
+        _mm256_store_si256((__m256i*)d + 3, v3);
+        d += 128;
+        s += 128;
+        size -= 128;
+    }
+    while (size >= 32) {
+        _mm256_store_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+        d += 32;
+        s += 32;
+        size -= 32;
+    }
+    _mm256_storeu_si256((__m256i*)dst, head);
+    _mm256_storeu_si256((__m256i*)last, tail);
+
+    return dst;
+}
+
+_VF_MEM_AVX2 static void* _vf_memset_avx2(void* dst, int value, size_t size) {
+    uint8_t* d = (uint8_t*)dst;
+    if (size <= 32) {
+        return _vf_memset_sse2(dst, value, size);
+    }
+    __m256i pattern = _mm256_set1_epi8((char)value);
+    _mm256_storeu_si256((__m256i*)d, pattern);
+    _mm256_storeu_si256((__m256i*)(d + size - 32), pattern);
+
+    size_t skip = 32 - ((uintptr_t)d & 31);
+    d += skip;
+    size -= skip;
+    if (size >= VF_MEM_STREAM_THRESHOLD) {
+        while (size >= 128) {
+            _mm256_stream_si256((__m256i*)d + 0, pattern);
+            _mm256_stream_si256((__m256i*)d + 1, pattern);
+            _mm256_stream_si256((__m256i*)d + 2, pattern);
+            _mm256_stream_si256((__m256i*)d + 3, pattern);
+            d += 128;
+            size -= 128;
+        }
+        _mm_sfence();
+    }
+    while (size >= 128) {
+        _mm256_store_si256((__m256i*)d + 0, pattern);
+        _mm256_store_si256((__m256i*)d + 1, pattern);
+        _mm256_store_si256((__m256i*)d + 2, pattern);
+        _mm256_store_si256((__m256i*)d + 3, pattern);
+        d += 128;
+        size -= 128;
+    }
+    while (size >= 32) {
+        _mm256_store_si256((__m256i*)d, pattern);
+        d += 32;
+        size -= 32;
+    }
+
+    return dst;
+}
+
+_VF_MEM_AVX2 static void _vf_memswap_avx2(void* ptr_a, void* ptr_b, size_t size) {
+    uint8_t* a = (uint8_t*)ptr_a;
+    uint8_t* b = (uint8_t*)ptr_b;
+    if (size >= 128) {
+        size_t skip = (32 - ((uintptr_t)a & 31)) & 31;
+        _vf_memswap_word(a, b, skip);
+        a += skip;
+        b += skip;
+        size -= skip;
+    }
+    while (size >= 128) {
+        __m256i a0 = _mm256_load_si256((__m256i*)a + 0), a1 = _mm256_load_si256((__m256i*)a + 1);
+        __m256i a2 = _mm256_load_si256((__m256i*)a + 2), a3 = _mm256_load_si256((__m256i*)a + 3);
+        __m256i b0 = _mm256_loadu_si256((__m256i*)b + 0), b1 = _mm256_loadu_si256((__m256i*)b + 1);
+        __m256i b2 = _mm256_loadu_si256((__m256i*)b + 2), b3 = _mm256_loadu_si256((__m256i*)b + 3);
+        _mm256_store_si256((__m256i*)a + 0, b0);
+        _mm256_store_si256((__m256i*)a + 1, b1);
+        _mm256_store_si256((__m256i*)a + 2, b2);
+        _mm256_store_si256((__m256i*)a + 3, b3);
+        _mm256_storeu_si256((__m256i*)b + 0, a0);
+        _mm256_storeu_si256((__m256i*)b + 1, a1);
+        _mm256_storeu_si256((__m256i*)b + 2, a2);
+        _mm256_storeu_si256((__m256i*)b + 3, a3);
+        a += 128;
+        b += 128;
+        size -= 128;
+    }
+    while (size >= 32) {
+        __m256i va = _mm256_loadu_si256((__m256i*)a);
+        __m256i vb = _mm256_loadu_si256((__m256i*)b);
+        _mm256_storeu_si256((__m256i*)a, vb);
+        _mm256_storeu_si256((__m256i*)b, va);
+        a += 32;
+        b += 32;
+        size -= 32;
+    }
+    // The tail runs legacy SSE code, which stalls while the upper halves of
+    // the YMM registers are dirty; compilers don't clear them before a tail call
+    _mm256_zeroupper();
+    _vf_memswap_sse2(a, b, size);
+}
+
+static bool _vf_mem_cpu_has_avx2(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    // The OS must save the YMM registers too (OSXSAVE, then XCR0 bits 1-2)
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return false;
+#endif
+}
+
+#endif // VF_MEM_X86
+
+// -1 until the first call picks a kernel. Every thread picks the same one,
+// so racing on it is harmless, but it is still read and written atomically.
+static int _vf_mem_kernel_id = -1;
+
+#if defined(__GNUC__) || defined(__clang__)
+#    define _VF_MEM_LOAD_KERNEL() __atomic_load_n(&_vf_mem_kernel_id, __ATOMIC_RELAXED)
+#    define _VF_MEM_STORE_KERNEL(kernel) __atomic_store_n(&_vf_mem_kernel_id, (kernel), __ATOMIC_RELAXED)
+#else
+#    define _VF_MEM_LOAD_KERNEL() (*(volatile int*)&_vf_mem_kernel_id)
+#    define _VF_MEM_STORE_KERNEL(kernel) (*(volatile int*)&_vf_mem_kernel_id = (kernel))
+#endif
+
+bool vf_mem_kernel_supported(vf_mem_kernel_t kernel) {
+    switch (kernel) {
+    case VF_MEM_KERNEL_WORD:
+        return true;
+#ifdef VF_MEM_X86
+    case VF_MEM_KERNEL_SSE2:
+        return true;
+    case VF_MEM_KERNEL_AVX2:
+        return _vf_mem_cpu_has_avx2();
+#endif
+    default:
+        return false;
+    }
+}
+
+vf_mem_kernel_t vf_mem_get_kernel(void) {
+    int kernel = _VF_MEM_LOAD_KERNEL();
+    if (kernel < 0) {
+        kernel = VF_MEM_KERNEL_AVX2;
+        while (!vf_mem_kernel_supported((vf_mem_kernel_t)kernel)) {
+            kernel--;
+        }
+        _VF_MEM_STORE_KERNEL(kernel);
+    }
+    return (vf_mem_kernel_t)kernel;
+}
+
+bool vf_mem_set_kernel(vf_mem_kernel_t kernel) {
+    if (!vf_mem_kernel_supported(kernel)) {
+        return false;
+    }
+    _VF_MEM_STORE_KERNEL((int)kernel);
+    return true;
+}
+
+void* vf_memcpy(void* dst, const void* src, size_t size) {
+    switch (vf_mem_get_kernel()) {
+#ifdef VF_MEM_X86
+    case VF_MEM_KERNEL_AVX2:
+        return _vf_memcpy_avx2(dst, src, size);
+    case VF_MEM_KERNEL_SSE2:
+        return _vf_memcpy_sse2(dst, src, size);
+#endif
+    default:
+        return _vf_memcpy_word(dst, src, size);
+    }
+}
+
+void* vf_memset(void* dst, int value, size_t size) {
+    switch (vf_mem_get_kernel()) {
+#ifdef VF_MEM_X86
+    case VF_MEM_KERNEL_AVX2:
+        return _vf_memset_avx2(dst, value, size);
+    case VF_MEM_KERNEL_SSE2:
+        return _vf_memset_sse2(dst, value, size);
+#endif
+    default:
+        return _vf_memset_word(dst, value, size);
+    }
+}
+
+void vf_memswap(void* ptr_a, void* ptr_b, size_t size) {
+    switch (vf_mem_get_kernel()) {
+#ifdef VF_MEM_X86
+    case VF_MEM_KERNEL_AVX2:
+        _vf_memswap_avx2(ptr_a, ptr_b, size);
+        break;
+    case VF_MEM_KERNEL_SSE2:
+        _vf_memswap_sse2(ptr_a, ptr_b, size);
+        break;
+#endif
+    default:
+        _vf_memswap_word(ptr_a, ptr_b, size);
+        break;
+    }
+}
+
 #endif // VF_MEM_IMPLEMENTATION
-#endif // VF_MEMORY_H
\ No newline at end of file
+#endif // VF_MEMORY_H
@@ -0,0 +1,352 @@
+/*
+*   vf_soa - v0.1
+*   Header-only structure-of-arrays container. Where a vf_darray of structs
+*   keeps every record's fields together, a vf_soa_t keeps one column per
+*   field, so a loop over one field only streams that field through the
+*   cache, and can be vectorized over plain arrays.
+*
+*   Every column starts on a VF_SOA_ALIGNMENT boundary and is padded to a
+*   multiple of it, so vector loops may run over the last partial vector of
+*   a column without reading past its memory. All columns share one
+*   allocation, one count and one capacity; rows are pushed, removed and
+*   resized in lockstep. Count, capacity and per-column stride mean the same
+*   as in vf_darray.h, and growing follows its DA_RESIZE_FACTOR.
+*
+*   Columns can be described by a struct with `VF_SOA_FIELD`, and records
+*   pushed and read back as that struct:
+*
+*       typedef struct { float x, y, z; uint32_t id; } particle_t;
+*       vf_soa_field_t fields[] = {
+*           VF_SOA_FIELD(particle_t, x), VF_SOA_FIELD(particle_t, y),
+*           VF_SOA_FIELD(particle_t, z), VF_SOA_FIELD(particle_t, id),
+*       };
+*       vf_soa_t* soa = vf_soa_create(fields, 4, 0);
+*       vf_soa_push_struct(soa, &particle);
+*       float* x = (float*)vf_soa_column(soa, 0);
+*
+*   RECENT CHANGES:
+*       0.1     (2026-10-16)    Finalized the implementation;
+*
+*   LICENSE: MIT License
+*       Copyright (c) 2024 Viktor Fejes
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+*   TODOs:
+*       - [ ] Ordered remove and insert
+*
+ */
+
+#ifndef VF_SOA_H
+#define VF_SOA_H
+
+#include "vf_darray.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Alignment (and padding) of every column, enough for AVX-512 and a cache line.
+#define VF_SOA_ALIGNMENT 64
+
+// One column: `size` bytes per row, found at `offset` in the records
+// `vf_soa_push_struct`/`vf_soa_get_struct` take.
+typedef struct {
+    size_t offset;
+    size_t size;
+} vf_soa_field_t;
+
+#define VF_SOA_FIELD(type, member) { offsetof(type, member), sizeof(((type*)0)->member) }
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    size_t column_count;
+    vf_soa_field_t* fields;
+    uint8_t** columns;
+    void* block;            // Every column, in one allocation
+} vf_soa_t;
+
+/**
+ * @brief Creates a container with one column per field.
+ *
+ * @param fields Offset and size of each column; copied.
+ * @param column_count Number of fields.
+ * @param capacity Rows to make room for up front (0 for none).
+ * @return The container, or NULL if an allocation failed.
+ */
+extern vf_soa_t* vf_soa_create(const vf_soa_field_t* fields, size_t column_count, size_t capacity);
+
+extern void vf_soa_free(vf_soa_t* soa);
+
+extern size_t vf_soa_count(const vf_soa_t* soa);
+extern size_t vf_soa_capacity(const vf_soa_t* soa);
+// Bytes per row of a column.
+extern size_t vf_soa_stride(const vf_soa_t* soa, size_t column);
+
+/**
+ * @brief Returns the first row of a column. Aligned to VF_SOA_ALIGNMENT; the
+ * pointer changes when the container grows.
+ */
+extern void* vf_soa_column(const vf_soa_t* soa, size_t column);
+
+/**
+ * @brief Makes room for `capacity` rows. Never shrinks.
+ *
+ * @return false if the allocation failed; the container is left as it was.
+ */
+extern bool vf_soa_reserve(vf_soa_t* soa, size_t capacity);
+
+/**
+ * @brief Sets the row count, growing if needed. New rows are zeroed.
+ *
+ * @return false if the allocation failed; the container is left as it was.
+ */
+extern bool vf_soa_resize(vf_soa_t* soa, size_t count);
+
+/**
+ * @brief Adds a row from one pointer per column (NULL zeroes that field).
+ *
+ * @return false if growing failed.
+ */
+extern bool vf_soa_push(vf_soa_t* soa, const void* const* values);
+
+/**
+ * @brief Adds a row from a record, taking each column from its field's offset.
+ *
+ * @return false if growing failed.
+ */
+extern bool vf_soa_push_struct(vf_soa_t* soa, const void* record);
+
+// Copies a row's fields into a record at their offsets.
+extern void vf_soa_get_struct(const vf_soa_t* soa, size_t row, void* record);
+
+/**
+ * @brief Removes a row by moving the last row into its place, in every
+ * column. Constant time, but doesn't keep the order.
+ */
+extern void vf_soa_remove_swap(vf_soa_t* soa, size_t row);
+
+extern void vf_soa_clear(vf_soa_t* soa);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END OF HEADER. -----------------------------------------
+
+#ifdef VF_SOA_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+
+// Bytes a column of `capacity` rows takes, padded to the alignment.
+static size_t _soa_column_bytes(size_t size, size_t capacity) {
+    return (size * capacity + VF_SOA_ALIGNMENT - 1) & ~(size_t)(VF_SOA_ALIGNMENT - 1);
+}
+
+// Moves the columns into a new block of `capacity` rows. The padding past
+// the count is zeroed, so vector loops over it read zeroes, not garbage.
+static bool _soa_reallocate(vf_soa_t* soa, size_t capacity) {
+    size_t total = 0;
+    for (size_t c = 0; c < soa->column_count; ++c) {
+        total += _soa_column_bytes(soa->fields[c].size, capacity);
+    }
+
+    // Room to align the block, with the raw pointer stored right in front of it
+    uint8_t* raw = (uint8_t*)malloc(total + VF_SOA_ALIGNMENT + sizeof(void*));
+    if (raw == NULL) {
+        return false;
+    }
+    uint8_t* base = (uint8_t*)(((uintptr_t)raw + sizeof(void*) + VF_SOA_ALIGNMENT - 1) & ~(uintptr_t)(VF_SOA_ALIGNMENT - 1));
+    ((void**)base)[-1] = raw;
+
+    uint8_t* column = base;
+    for (size_t c = 0; c < soa->column_count; ++c) {
+        size_t size = soa->fields[c].size;
+        size_t used = size * soa->count;
+        size_t bytes = _soa_column_bytes(size, capacity);
+        if (used > 0) {
+            memcpy(column, soa->columns[c], used);
+        }
+        memset(column + used, 0, bytes - used);
+        soa->columns[c] = column;
+        column += bytes;
+    }
+
+    if (soa->block != NULL) {
+        free(((void**)soa->block)[-1]);
+    }
+    soa->block = base;
+    soa->capacity = capacity;
+
+    return true;
+}
+
+static bool _soa_grow(vf_soa_t* soa, size_t min_capacity) {
+    if (soa->capacity >= min_capacity) {
+        return true;
+    }
+    size_t capacity = (size_t)((double)soa->capacity * DA_RESIZE_FACTOR);
+    if (capacity <= soa->capacity) {
+        capacity = soa->capacity + 1;
+    }
+    if (capacity < DA_DEFAULT_CAPACITY) {
+        capacity = DA_DEFAULT_CAPACITY;
+    }
+    if (capacity < min_capacity) {
+        capacity = min_capacity;
+    }
+    return _soa_reallocate(soa, capacity);
+}
+
+vf_soa_t* vf_soa_create(const vf_soa_field_t* fields, size_t column_count, size_t capacity) {
+    vf_soa_t* soa = (vf_soa_t*)calloc(1, sizeof(vf_soa_t));
+    if (soa == NULL) {
+        return NULL;
+    }
+    soa->column_count = column_count;
+    // One extra element each, so a container without columns still gets real pointers
+    soa->fields = (vf_soa_field_t*)malloc((column_count + 1) * sizeof(vf_soa_field_t));
+    soa->columns = (uint8_t**)calloc(column_count + 1, sizeof(uint8_t*));
+    if (soa->fields != NULL) {
+        memcpy(soa->fields, fields, column_count * sizeof(vf_soa_field_t));
+    }
+    if (soa->fields == NULL || soa->columns == NULL || !_soa_reallocate(soa, capacity)) {
+        free(soa->fields);
+        free(soa->columns);
+        free(soa);
+        return NULL;
+    }
+
+    return soa;
+}
+
+void vf_soa_free(vf_soa_t* soa) {
+    if (soa == NULL) {
+        return;
+    }
+    if (soa->block != NULL) {
+        free(((void**)soa->block)[-1]);
+    }
+    free(soa->fields);
+    free(soa->columns);
+    free(soa);
+}
+
+size_t vf_soa_count(const vf_soa_t* soa) {
+    return soa->count;
+}
+
+size_t vf_soa_capacity(const vf_soa_t* soa) {
+    return soa->capacity;
+}
+
+size_t vf_soa_stride(const vf_soa_t* soa, size_t column) {
+    return soa->fields[column].size;
+}
+
+void* vf_soa_column(const vf_soa_t* soa, size_t column) {
+    return soa->columns[column];
+}
+
+bool vf_soa_reserve(vf_soa_t* soa, size_t capacity) {
+    if (soa->capacity >= capacity) {
+        return true;
+    }
+    return _soa_reallocate(soa, capacity);
+}
+
+bool vf_soa_resize(vf_soa_t* soa, size_t count) {
+    if (!_soa_grow(soa, count)) {
+        return false;
+    }
+    // Rows dropped now are zeroed, so rows added later start out zeroed too
+    if (count < soa->count) {
+        for (size_t c = 0; c < soa->column_count; ++c) {
+            size_t size = soa->fields[c].size;
+            memset(soa->columns[c] + count * size, 0, (soa->count - count) * size);
+        }
+    }
+    soa->count = count;
+    return true;
+}
+
+bool vf_soa_push(vf_soa_t* soa, const void* const* values) {
+    if (!_soa_grow(soa, soa->count + 1)) {
+        return false;
+    }
+    for (size_t c = 0; c < soa->column_count; ++c) {
+        size_t size = soa->fields[c].size;
+        uint8_t* field = soa->columns[c] + soa->count * size;
+        if (values[c] != NULL) {
+            memcpy(field, values[c], size);
+        } else {
+            memset(field, 0, size);
+        }
+    }
+    soa->count++;
+    return true;
+}
+
+bool vf_soa_push_struct(vf_soa_t* soa, const void* record) {
+    if (!_soa_grow(soa, soa->count + 1)) {
+        return false;
+    }
+    for (size_t c = 0; c < soa->column_count; ++c) {
+        size_t size = soa->fields[c].size;
+        memcpy(soa->columns[c] + soa->count * size, (const uint8_t*)record + soa->fields[c].offset, size);
+    }
+    soa->count++;
+    return true;
+}
+
+void vf_soa_get_struct(const vf_soa_t* soa, size_t row, void* record) {
+    for (size_t c = 0; c < soa->column_count; ++c) {
+        size_t size = soa->fields[c].size;
+        memcpy((uint8_t*)record + soa->fields[c].offset, soa->columns[c] + row * size, size);
+    }
+}
+
+void vf_soa_remove_swap(vf_soa_t* soa, size_t row) {
+    if (row >= soa->count) {
+        return;
+    }
+    size_t last = soa->count - 1;
+    for (size_t c = 0; c < soa->column_count; ++c) {
+        size_t size = soa->fields[c].size;
+        if (row != last) {
+            memcpy(soa->columns[c] + row * size, soa->columns[c] + last * size, size);
+        }
+        // Keeps the padding past the count zeroed
+        memset(soa->columns[c] + last * size, 0, size);
+    }
+    soa->count = last;
+}
+
+void vf_soa_clear(vf_soa_t* soa) {
+    vf_soa_resize(soa, 0);
+}
+
+#endif // VF_SOA_IMPLEMENTATION
+#endif // VF_SOA_H
@@ -1,8 +1,15 @@
 /*
-*   vf_thread - v0.1
+*   vf_thread - v0.13
 *   Header-only tiny library to help with cross-platform multi-threading.
 *
 *   RECENT CHANGES:
+*       0.13    (2026-10-16)    Added VF_THREAD_ERROR_THREADPOOL_STOPPED for vf_threadpool.h;
+*       0.12    (2026-10-16)    Added `vf_thread_yield` and sequentially consistent
+*                               `vf_atomic_*` loads, stores and adds on pointers and u64s;
+*       0.11    (2026-10-16)    Fixed `vf_thread_create`/`_detach` not compiling with pthreads,
+*                               and `vf_tls_set` in C++;
+*                               Windows read locks are now held until unlock instead of
+*                               being released straight away, so they exclude writers;
 *       0.1     (2024-08-07)    Finalized the implementation;
 *
 *   LICENSE: MIT License
@@ -66,6 +73,7 @@ extern "C" {
     #endif
 #else
     #include <pthread.h>
+    #include <sched.h>
     #include <unistd.h>
 #endif
 
@@ -126,7 +134,8 @@ typedef enum {
     VF_THREAD_ERROR_MUTEX_UNLOCK,
     VF_ERROR_TLS_CREATE,
     VF_ERROR_TLS_SET,
-    VF_ERROR_TLS_DELETE
+    VF_ERROR_TLS_DELETE,
+    VF_THREAD_ERROR_THREADPOOL_STOPPED
 } vf_thread_error_t;
 
 /**
@@ -162,6 +171,11 @@ extern vf_thread_error_t vf_thread_detach(vf_thread_t* thread);
  */
 extern void vf_thread_sleep(uint32_t ms);
 
+/**
+ * @brief Gives up the rest of the current thread's time slice.
+ */
+extern void vf_thread_yield(void);
+
 /**
  * @brief Initializes the selected mutex.
  * 
@@ -295,6 +309,54 @@ extern void* vf_tls_get(vf_tls_key_t* key);
  */
 extern vf_thread_error_t vf_tls_delete(vf_tls_key_t* key);
 
+// Atomics. All of them are sequentially consistent, and inline so that they
+// compile to a single instruction. GCC/Clang builtins, MSVC intrinsics.
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+static inline void* vf_atomic_load_ptr(void* volatile* ptr) {
+    return _InterlockedCompareExchangePointer(ptr, NULL, NULL);
+}
+
+static inline void vf_atomic_store_ptr(void* volatile* ptr, void* value) {
+    _InterlockedExchangePointer(ptr, value);
+}
+
+static inline uint64_t vf_atomic_load_u64(volatile uint64_t* ptr) {
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64*)ptr, 0, 0);
+}
+
+static inline void vf_atomic_store_u64(volatile uint64_t* ptr, uint64_t value) {
+    _InterlockedExchange64((volatile __int64*)ptr, (__int64)value);
+}
+
+// Returns the value before the addition.
+static inline uint64_t vf_atomic_add_u64(volatile uint64_t* ptr, uint64_t value) {
+    return (uint64_t)_InterlockedExchangeAdd64((volatile __int64*)ptr, (__int64)value);
+}
+#else
+static inline void* vf_atomic_load_ptr(void* volatile* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline void vf_atomic_store_ptr(void* volatile* ptr, void* value) {
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+static inline uint64_t vf_atomic_load_u64(volatile uint64_t* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline void vf_atomic_store_u64(volatile uint64_t* ptr, uint64_t value) {
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+// Returns the value before the addition.
+static inline uint64_t vf_atomic_add_u64(volatile uint64_t* ptr, uint64_t value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+#endif
+
 // Remove win lean and mean in case it interferes with user's win header include
 #undef WIN32_LEAN_AND_MEAN
 
@@ -313,7 +375,7 @@ vf_thread_error_t vf_thread_create(vf_thread_t* thread, void* (*func)(void*), vo
     thread->handle = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)func, arg, 0, &thread->id);
     return (thread->handle != NULL) ? VF_THREAD_SUCCESS : VF_THREAD_ERROR_CREATE;
 #else
-    int result = pthread_create(&th->id, NULL, func, arg);
+    int result = pthread_create(&thread->id, NULL, func, arg);
     return (result == 0) ? VF_THREAD_SUCCESS : VF_THREAD_ERROR_CREATE;
 #endif
 }
@@ -338,7 +400,7 @@ vf_thread_error_t vf_thread_detach(vf_thread_t* thread) {
         return VF_THREAD_ERROR_DETACH;
     }
 #else
-    int result = pthread_detach(th->id);
+    int result = pthread_detach(thread->id);
     return (result == 0) ? VF_THREAD_SUCCESS : VF_THREAD_ERROR_DETACH;
 #endif
 }
@@ -351,6 +413,14 @@ void vf_thread_sleep(uint32_t ms) {
 #endif
 }
 
+void vf_thread_yield(void) {
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
 void vf_mutex_init(vf_mutex_t* mtx) {
 #ifdef _WIN32
     InitializeCriticalSection(&mtx->cs);
@@ -436,16 +506,8 @@ void vf_rwlock_init(vf_rwlock_t* rwlock) {
 
 void vf_rwlock_rdlock(vf_rwlock_t* rwlock) {
 #ifdef _WIN32
-    while (1) {
-        AcquireSRWLockShared(&rwlock->lock);
-        if (rwlock->writer_waiting == 0) {
-            InterlockedIncrement(&rwlock->readers);
-            ReleaseSRWLockShared(&rwlock->lock);
-            break;
-        }
-        ReleaseSRWLockShared(&rwlock->lock);
-        Sleep(1);  // Small delay before retrying
-    }
+    AcquireSRWLockShared(&rwlock->lock);
+    InterlockedIncrement(&rwlock->readers);
 #else
     pthread_rwlock_rdlock(&rwlock->lock);
 #endif
@@ -454,14 +516,9 @@ void vf_rwlock_rdlock(vf_rwlock_t* rwlock) {
 void vf_rwlock_wrlock(vf_rwlock_t* rwlock) {
 #ifdef _WIN32
     InterlockedIncrement(&rwlock->writer_waiting);
-    while (1) {
-        if (InterlockedCompareExchange(&rwlock->writer_active, 1, 0) == 0) {
-            AcquireSRWLockExclusive(&rwlock->lock);
-            InterlockedDecrement(&rwlock->writer_waiting);
-            break;
-        }
-        Sleep(1);  // Small delay before retrying
-    }
+    AcquireSRWLockExclusive(&rwlock->lock);
+    InterlockedDecrement(&rwlock->writer_waiting);
+    rwlock->writer_active = 1;
 #else
     pthread_rwlock_wrlock(&rwlock->lock);
 #endif
@@ -469,12 +526,14 @@ void vf_rwlock_wrlock(vf_rwlock_t* rwlock) {
 
 void vf_rwlock_unlock(vf_rwlock_t* rwlock) {
 #ifdef _WIN32
+    // Only the exclusive owner can observe `writer_active` set: readers
+    // holding the lock shared exclude any writer for as long as they do.
     if (rwlock->writer_active) {
-        InterlockedExchange(&rwlock->writer_active, 0);  // Use InterlockedExchange
+        rwlock->writer_active = 0;
         ReleaseSRWLockExclusive(&rwlock->lock);
     } else {
         InterlockedDecrement(&rwlock->readers);
-        // No need to release shared lock, it's already released in rdlock
+        ReleaseSRWLockShared(&rwlock->lock);
     }
 #else
     pthread_rwlock_unlock(&rwlock->lock);
@@ -506,7 +565,7 @@ vf_thread_error_t vf_tls_set(vf_tls_key_t* key, const void* value) {
 #ifdef _WIN32
     return TlsSetValue(key->key, (LPVOID)value) ? VF_THREAD_SUCCESS : VF_ERROR_TLS_SET;
 #else
-    return pthread_setspecific(key->key, value);
+    return (pthread_setspecific(key->key, value) == 0) ? VF_THREAD_SUCCESS : VF_ERROR_TLS_SET;
 #endif
 }
 
@@ -1,29 +1,92 @@
-#pragma once
-
-#include <stdlib.h>
-
-#define MAX_THREADS 32
-#define MAX_QUEUE 256
+/*
+*   vf_threadpool - v0.1
+*   Header-only tiny fixed size thread pool library on top of vf_thread.h.
+*   The implementation of vf_thread.h must be compiled as well
+*   (VF_THREAD_IMPLEMENTATION), and needs -lpthread outside of Windows.
+*
+*   RECENT CHANGES:
+*       0.1     (2026-10-16)    Finalized the implementation;
+*                               Added `vf_threadpool_wait`;
+*                               Pending tasks are finished before the workers stop;
+*
+*   LICENSE: MIT License
+*       Copyright (c) 2024 Viktor Fejes
+*
+*       Permission is hereby granted, free of charge, to any person obtaining a copy
+*       of this software and associated documentation files (the "Software"), to deal
+*       in the Software without restriction, including without limitation the rights
+*       to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*       copies of the Software, and to permit persons to whom the Software is
+*       furnished to do so, subject to the following conditions:
+*
+*       The above copyright notice and this permission notice shall be included in all
+*       copies or substantial portions of the Software.
+*
+*       THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*       IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*       FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*       AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*       LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*       OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*       SOFTWARE.
+*
+*   TODOs:
+*       - [ ] Growable task queue instead of blocking when it is full
+*
+ */
+
+#ifndef VF_THREADPOOL_H
+#define VF_THREADPOOL_H
+
+#include "vf_thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VF_THREADPOOL_MAX_THREADS 32
+#define VF_THREADPOOL_MAX_QUEUE 256
 
 typedef struct {
-    void (*function)(void *);
-    void *argument;
+    void (*function)(void*);
+    void* argument;
 } vf_task_t;
 
 typedef struct {
-    vf_thread_t threads[MAX_THREADS];
-    vf_task_t queue[MAX_QUEUE];
+    vf_thread_t threads[VF_THREADPOOL_MAX_THREADS];
+    vf_task_t queue[VF_THREADPOOL_MAX_QUEUE];
     int thread_count;
     int queue_size;
     int front;
     int rear;
+    int active;             // Tasks taken off the queue that are still running
     vf_mutex_t queue_mutex;
     vf_cond_t queue_not_empty;
     vf_cond_t queue_not_full;
+    vf_cond_t all_done;     // Signalled when the queue is empty and nothing is running
     int stop;
 } vf_threadpool_t;
 
-void* threadpool_worker(void* arg) {
+extern vf_threadpool_t* vf_threadpool_create(int num_threads);
+// Blocks while the queue is full. Returns VF_THREAD_ERROR_THREADPOOL_STOPPED
+// once the pool is being destroyed.
+extern vf_thread_error_t vf_threadpool_add_task(vf_threadpool_t* pool, void (*function)(void*), void* argument);
+// Blocks until every task added so far has finished.
+extern void vf_threadpool_wait(vf_threadpool_t* pool);
+// Finishes the queued tasks, then stops and joins the workers.
+extern void vf_threadpool_destroy(vf_threadpool_t* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END OF HEADER. -----------------------------------------
+
+#ifdef VF_THREADPOOL_IMPLEMENTATION
+
+#include <stdlib.h>
+
+static void* _vf_threadpool_worker(void* arg) {
     vf_threadpool_t* pool = (vf_threadpool_t*)arg;
     vf_task_t task;
 
@@ -34,26 +97,35 @@ void* threadpool_worker(void* arg) {
             vf_cond_wait(&pool->queue_not_empty, &pool->queue_mutex);
         }
 
-        if (pool->stop) {
+        if (pool->queue_size == 0) {
+            // Stopping, and nothing left to run
             vf_mutex_unlock(&pool->queue_mutex);
             return NULL;
         }
 
         task = pool->queue[pool->front];
-        pool->front = (pool->front + 1) % MAX_QUEUE;
+        pool->front = (pool->front + 1) % VF_THREADPOOL_MAX_QUEUE;
         pool->queue_size--;
+        pool->active++;
 
         vf_cond_signal(&pool->queue_not_full);
         vf_mutex_unlock(&pool->queue_mutex);
 
         (*(task.function))(task.argument);
+
+        vf_mutex_lock(&pool->queue_mutex);
+        pool->active--;
+        if (pool->active == 0 && pool->queue_size == 0) {
+            vf_cond_broadcast(&pool->all_done);
+        }
+        vf_mutex_unlock(&pool->queue_mutex);
     }
 
     return NULL;
 }
 
 vf_threadpool_t* vf_threadpool_create(int num_threads) {
-    if (num_threads <= 0 || num_threads > MAX_THREADS) {
+    if (num_threads <= 0 || num_threads > VF_THREADPOOL_MAX_THREADS) {
         return NULL;
     }
 
@@ -62,21 +134,25 @@ vf_threadpool_t* vf_threadpool_create(int num_threads) {
         return NULL;
     }
 
-    pool->thread_count = num_threads;
+    pool->thread_count = 0;
     pool->queue_size = 0;
     pool->front = 0;
     pool->rear = 0;
+    pool->active = 0;
     pool->stop = 0;
 
     vf_mutex_init(&pool->queue_mutex);
     vf_cond_init(&pool->queue_not_empty);
     vf_cond_init(&pool->queue_not_full);
+    vf_cond_init(&pool->all_done);
 
     for (int i = 0; i < num_threads; i++) {
-        if (vf_thread_create(&pool->threads[i], threadpool_worker, pool) != VF_THREAD_SUCCESS) {
+        if (vf_thread_create(&pool->threads[i], _vf_threadpool_worker, pool) != VF_THREAD_SUCCESS) {
+            // Only the workers started so far get joined
             vf_threadpool_destroy(pool);
             return NULL;
         }
+        pool->thread_count++;
     }
 
     return pool;
@@ -85,7 +161,7 @@ vf_threadpool_t* vf_threadpool_create(int num_threads) {
 vf_thread_error_t vf_threadpool_add_task(vf_threadpool_t* pool, void (*function)(void*), void* argument) {
     vf_mutex_lock(&pool->queue_mutex);
 
-    while (pool->queue_size == MAX_QUEUE && !pool->stop) {
+    while (pool->queue_size == VF_THREADPOOL_MAX_QUEUE && !pool->stop) {
         vf_cond_wait(&pool->queue_not_full, &pool->queue_mutex);
     }
 
@@ -96,7 +172,7 @@ vf_thread_error_t vf_threadpool_add_task(vf_threadpool_t* pool, void (*function)
 
     pool->queue[pool->rear].function = function;
     pool->queue[pool->rear].argument = argument;
-    pool->rear = (pool->rear + 1) % MAX_QUEUE;
+    pool->rear = (pool->rear + 1) % VF_THREADPOOL_MAX_QUEUE;
     pool->queue_size++;
 
     vf_cond_signal(&pool->queue_not_empty);
@@ -105,6 +181,14 @@ vf_thread_error_t vf_threadpool_add_task(vf_threadpool_t* pool, void (*function)
     return VF_THREAD_SUCCESS;
 }
 
+void vf_threadpool_wait(vf_threadpool_t* pool) {
+    vf_mutex_lock(&pool->queue_mutex);
+    while (pool->queue_size > 0 || pool->active > 0) {
+        vf_cond_wait(&pool->all_done, &pool->queue_mutex);
+    }
+    vf_mutex_unlock(&pool->queue_mutex);
+}
+
 void vf_threadpool_destroy(vf_threadpool_t* pool) {
     if (pool == NULL) {
         return;
@@ -123,6 +207,10 @@ void vf_threadpool_destroy(vf_threadpool_t* pool) {
     vf_mutex_destroy(&pool->queue_mutex);
     vf_cond_destroy(&pool->queue_not_empty);
     vf_cond_destroy(&pool->queue_not_full);
+    vf_cond_destroy(&pool->all_done);
 
     free(pool);
-}
\ No newline at end of file
+}
+
+#endif // VF_THREADPOOL_IMPLEMENTATION
+#endif // VF_THREADPOOL_H